@@ -31,11 +31,10 @@ bool func_to_mgraph(
     if (append_node_id)
       nc->text.sprnt("ID(%d)\n", nid);
 
-    // Generate disassembly text
-    get_disasm_text(
-        block.startEA, 
-        block.endEA, 
-        &nc->text);
+    // The disassembly text is generated when the node is first displayed
+    nc->blocks.push_back(block.startEA);
+    nc->blocks.push_back(block.endEA);
+    nc->text_pending = true;
 
     // Build edges
     for (int nid_succ=0, succ_sz=fc->nsucc(nid); nid_succ < succ_sz; nid_succ++)
@@ -47,6 +46,464 @@ bool func_to_mgraph(
   return true;
 }
 
+//--------------------------------------------------------------------------
+void init_combined_gnode(
+    gnode_t *gn,
+    nodeloc_t *loc,
+    qflow_chart_t *fc,
+    bool show_nids_only)
+{
+  size_t t = loc->ng->size();
+  for (nodegroup_t::iterator it=loc->ng->begin();
+       it != loc->ng->end();
+       ++it)
+  {
+    if (show_nids_only)
+    {
+      gn->text.cat_sprnt("%d", (*it)->nid);
+      if (--t > 0)
+        gn->text.append(", ");
+    }
+
+    // The disassembly is generated when it is first displayed
+    qbasic_block_t &block = fc->blocks[(*it)->nid];
+    gn->blocks.push_back(block.startEA);
+    gn->blocks.push_back(block.endEA);
+  }
+
+  // Are there any groupped nodes?
+  if (show_nids_only || loc->ng->size() > 1)
+  {
+    // The hint shows the disassembly of all the nodes
+    gn->hint_pending = true;
+  }
+  else
+  {
+    // The text shows the disassembly, there is no other hint
+    gn->text_pending = true;
+  }
+
+  if (!show_nids_only && loc->ng->size() > 1)
+  {
+    //TODO: OPTION: enlarge groupped label
+    gn->text.append("\n\n\n");
+
+    // Display the group name or the group id
+    gn->text.append(loc->sg->get_display_name());
+
+    gn->text.append("\n\n\n");
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Delete the graph edges from or to the given combined nodes
+*/
+static void del_combined_edges(
+    gedgemap_t &edge_map,
+    mutable_graph_t *mg,
+    const std::vector<bool> &dead)
+{
+  for (gedgemap_t::iterator it=edge_map.begin(); it != edge_map.end(); /* incr in loop */)
+  {
+    int src = it->first.first, dst = it->first.second;
+    if (!dead[src] && !dead[dst])
+    {
+      ++it;
+      continue;
+    }
+    mg->del_edge(src, dst);
+    edge_map.fc_edge_count -= it->second;
+    edge_map.erase(it++);
+  }
+}
+
+//--------------------------------------------------------------------------
+bool update_combined_mg(
+    groupman_t *gm,
+    const std::vector<int> &changed,
+    gnodemap_t &node_map,
+    ng2nid_t &group2id,
+    gedgemap_t &edge_map,
+    std::vector<int> &nid2gid,
+    mutable_graph_t *mg,
+    qflow_chart_t *fc)
+{
+  int nodes_count = fc->size();
+  int gcount = mg->size();
+  if (nid2gid.size() != size_t(nodes_count))
+    return false;
+
+  // Members of each combined node, before the edits
+  std::vector<int> members_first(gcount + 1, 0), members;
+  for (int nid=0; nid < nodes_count; nid++)
+  {
+    int gid = nid2gid[nid];
+    if (gid < 0 || gid >= gcount)
+      return false;
+    ++members_first[gid + 1];
+  }
+  for (int gid=0; gid < gcount; gid++)
+    members_first[gid + 1] += members_first[gid];
+
+  members.resize(nodes_count);
+  {
+    std::vector<int> pos(members_first.begin(), members_first.end() - 1);
+    for (int nid=0; nid < nodes_count; nid++)
+      members[pos[nid2gid[nid]]++] = nid;
+  }
+
+  // A changed node invalidates the combined node it was in and the one it is
+  // in now, along with all their nodes
+  std::vector<bool> hit(nodes_count, false), dead(gcount, false);
+  std::vector<int> hit_nids, pending;
+  for (size_t i=0; i < changed.size(); i++)
+  {
+    if (changed[i] >= 0 && changed[i] < nodes_count)
+      pending.push_back(changed[i]);
+  }
+
+  typedef std::map<pnodegroup_t, int> ng_gid_t;
+  ng_gid_t new_ngs;
+  while (!pending.empty())
+  {
+    int nid = pending.back();
+    pending.pop_back();
+    if (hit[nid])
+      continue;
+
+    hit[nid] = true;
+    hit_nids.push_back(nid);
+
+    int gid = nid2gid[nid];
+    if (!dead[gid])
+    {
+      dead[gid] = true;
+      pending.insert(
+        pending.end(),
+        members.begin() + members_first[gid],
+        members.begin() + members_first[gid + 1]);
+    }
+
+    nodeloc_t *loc = gm->find_nodeid_loc(nid);
+    if (loc == NULL)
+      return false;
+
+    if (new_ngs.insert(std::make_pair(loc->ng, -1)).second)
+    {
+      for (nodegroup_t::iterator it=loc->ng->begin(); it != loc->ng->end(); ++it)
+        pending.push_back((*it)->nid);
+    }
+  }
+
+  if (hit_nids.empty())
+    return true;
+
+  // Forget the NGs of the dead combined nodes
+  for (ng2nid_t::iterator it=group2id.begin(); it != group2id.end(); /* incr in loop */)
+  {
+    if (dead[it->second])
+      group2id.erase(it++);
+    else
+      ++it;
+  }
+
+  // Keep the id of the combined node that held the first node of an NG
+  std::vector<bool> reused(gcount, false);
+  for (ng_gid_t::iterator it=new_ngs.begin(); it != new_ngs.end(); ++it)
+  {
+    pnodedef_t nd = it->first->get_first_node();
+    if (nd == NULL || nd->nid < 0 || nd->nid >= nodes_count)
+      return false;
+
+    int gid = nid2gid[nd->nid];
+    if (!reused[gid])
+    {
+      reused[gid] = true;
+      it->second = gid;
+    }
+  }
+
+  // The other NGs take the freed ids, then new ones
+  std::vector<int> holes;
+  for (int gid=0; gid < gcount; gid++)
+  {
+    if (dead[gid] && !reused[gid])
+      holes.push_back(gid);
+  }
+
+  size_t i_hole = 0;
+  int new_gcount = gcount;
+  for (ng_gid_t::iterator it=new_ngs.begin(); it != new_ngs.end(); ++it)
+  {
+    if (it->second != -1)
+      continue;
+    it->second = i_hole < holes.size() ? holes[i_hole++] : new_gcount++;
+  }
+  holes.erase(holes.begin(), holes.begin() + i_hole);
+
+  // The freed ids at the end shrink the graph. Any other one would stay in
+  // the graph as an empty node and no other combined node may change id:
+  // rebuild the graph instead
+  while (!holes.empty() && holes.back() == new_gcount - 1)
+  {
+    holes.pop_back();
+    --new_gcount;
+  }
+  if (!holes.empty())
+    return false;
+
+  // Drop the edges and the data of the dead combined nodes
+  del_combined_edges(edge_map, mg, dead);
+  for (int gid=0; gid < gcount; gid++)
+  {
+    if (dead[gid])
+      node_map.erase(gid);
+  }
+
+  if (new_gcount > gcount)
+    mg->resize(new_gcount);
+
+  // Build the new combined nodes
+  for (ng_gid_t::iterator it=new_ngs.begin(); it != new_ngs.end(); ++it)
+  {
+    pnodegroup_t ng = it->first;
+    int gid = it->second;
+
+    nodeloc_t *loc = gm->find_nodeid_loc(ng->get_first_node()->nid);
+    gnode_t *gn = node_map.add(gid);
+    gn->id = gid;
+    init_combined_gnode(gn, loc, fc, false);
+    group2id[ng] = gid;
+
+    for (nodegroup_t::iterator it_nd=ng->begin(); it_nd != ng->end(); ++it_nd)
+      nid2gid[(*it_nd)->nid] = gid;
+  }
+
+  // Rebuild the edges from, then to the changed nodes
+  typedef std::vector<gedgemap_t::iterator> edge_order_t;
+  edge_order_t edge_order;
+  std::sort(hit_nids.begin(), hit_nids.end());
+  for (size_t i=0; i < hit_nids.size(); i++)
+  {
+    int nid = hit_nids[i];
+    int gid = nid2gid[nid];
+    for (int pass=0; pass < 2; pass++)
+    {
+      int count = pass == 0 ? fc->nsucc(nid) : fc->npred(nid);
+      for (int j=0; j < count; j++)
+      {
+        int other = pass == 0 ? fc->succ(nid, j) : fc->pred(nid, j);
+
+        // Edges between changed nodes are met from their source
+        if (pass == 1 && hit[other])
+          continue;
+
+        int other_gid = nid2gid[other];
+        if (other_gid == gid)
+          continue;
+
+        ++edge_map.fc_edge_count;
+        std::pair<gedgemap_t::iterator, bool> ins = edge_map.insert(
+          std::make_pair(
+            pass == 0 ? std::make_pair(gid, other_gid) : std::make_pair(other_gid, gid), 
+            0));
+        if (ins.second)
+          edge_order.push_back(ins.first);
+        ++ins.first->second;
+      }
+    }
+  }
+
+  for (edge_order_t::iterator it=edge_order.begin();
+       it != edge_order.end();
+       ++it)
+  {
+    gedgemap_t::iterator e = *it;
+
+    edge_info_t ei;
+    ei.width = gedgemap_t::get_width(e->second);
+    mg->add_edge(e->first.first, e->first.second, &ei);
+  }
+
+  if (new_gcount < mg->size())
+    mg->resize(new_gcount);
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Add a node to the hierarchical view
+*/
+static gnode_t *add_hier_node(
+    gnodemap_t &node_map,
+    hier_nodes_t &hier_nodes,
+    hier_level_e level,
+    int nid)
+{
+  int gid = int(hier_nodes.size());
+
+  hier_node_t hn;
+  hn.level = level;
+  hn.nid = nid;
+  hier_nodes.push_back(hn);
+
+  gnode_t *gn = node_map.add(gid);
+  gn->id = gid;
+  return gn;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Build the nodes and the edges of the hierarchical view. They are
+*        left partially built on failure
+*/
+static bool build_hier_mg(
+    groupman_t *gm,
+    const hier_expand_t &expand,
+    gnodemap_t &node_map,
+    hier_nodes_t &hier_nodes,
+    gedgemap_t &edge_map,
+    std::vector<int> &nid2gid,
+    mutable_graph_t *mg,
+    qflow_chart_t *fc)
+{
+  int nodes_count = fc->size();
+  nid2gid.assign(nodes_count, -1);
+  hier_nodes.clear();
+  edge_map.clear();
+
+  const gm_flat_t *flat = gm->get_flat();
+  for (size_t i=0; i < flat->sg_count(); i++)
+  {
+    psupergroup_t sg = flat->sgs[i];
+    if (flat->ng_begin(i) == flat->ng_end(i))
+      continue;
+
+    uint32 nd_first = flat->nd_begin(flat->ng_begin(i));
+    uint32 nd_last = flat->nd_end(flat->ng_end(i) - 1);
+    if (nd_first == nd_last)
+      continue;
+
+    if (!expand.is_sg_expanded(flat, i))
+    {
+      // One node for the whole SG
+      gnode_t *gn = add_hier_node(node_map, hier_nodes, hlvl_sg, flat->nids[nd_first]);
+      gn->text.sprnt("\n\n\n%s\n\n\n", sg->get_display_name());
+      gn->hint.sprnt("%u groups, %u blocks",
+        flat->ng_end(i) - flat->ng_begin(i),
+        nd_last - nd_first);
+
+      for (uint32 k=nd_first; k < nd_last; k++)
+      {
+        int nid = flat->nids[k];
+        if (nid < 0 || nid >= nodes_count)
+          return false;
+        nid2gid[nid] = gn->id;
+      }
+      continue;
+    }
+
+    for (uint32 j=flat->ng_begin(i); j < flat->ng_end(i); j++)
+    {
+      pnodegroup_t ng = flat->ngs[j];
+      if (ng->empty())
+        continue;
+
+      bool ng_expanded = expand.is_ng_expanded(flat, j);
+
+      // One node for the NG, as in the combined view
+      gnode_t *gn = NULL;
+      if (!ng_expanded)
+      {
+        nodeloc_t loc(sg, ng, flat->nds[flat->nd_begin(j)]);
+        gn = add_hier_node(node_map, hier_nodes, hlvl_ng, flat->nids[flat->nd_begin(j)]);
+        init_combined_gnode(gn, &loc, fc, false);
+      }
+
+      for (uint32 k=flat->nd_begin(j); k < flat->nd_end(j); k++)
+      {
+        int nid = flat->nids[k];
+        if (nid < 0 || nid >= nodes_count)
+          return false;
+
+        // One node per block, as in the single view
+        if (ng_expanded)
+        {
+          gn = add_hier_node(node_map, hier_nodes, hlvl_block, nid);
+          gn->blocks.push_back(fc->blocks[nid].startEA);
+          gn->blocks.push_back(fc->blocks[nid].endEA);
+          gn->text_pending = true;
+        }
+        nid2gid[nid] = gn->id;
+      }
+    }
+  }
+
+  // Build the edges between the nodes, merging the parallel ones
+  typedef std::vector<gedgemap_t::iterator> edge_order_t;
+  edge_order_t edge_order;
+  for (int nid=0; nid < nodes_count; nid++)
+  {
+    int gid = nid2gid[nid];
+    if (gid == -1)
+      return false;
+
+    for (int isucc=0, succ_sz=fc->nsucc(nid); isucc < succ_sz; isucc++)
+    {
+      int succ_gid = nid2gid[fc->succ(nid, isucc)];
+      if (succ_gid == -1)
+        return false;
+
+      if (succ_gid == gid)
+        continue;
+
+      ++edge_map.fc_edge_count;
+      std::pair<gedgemap_t::iterator, bool> ins = edge_map.insert(
+        std::make_pair(std::make_pair(gid, succ_gid), 0));
+      if (ins.second)
+        edge_order.push_back(ins.first);
+      ++ins.first->second;
+    }
+  }
+
+  mg->resize(int(hier_nodes.size()));
+  for (edge_order_t::iterator it=edge_order.begin();
+       it != edge_order.end();
+       ++it)
+  {
+    gedgemap_t::iterator e = *it;
+
+    edge_info_t ei;
+    ei.width = gedgemap_t::get_width(e->second);
+    mg->add_edge(e->first.first, e->first.second, &ei);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool fc_to_hier_mg(
+    groupman_t *gm,
+    const hier_expand_t &expand,
+    gnodemap_t &node_map,
+    hier_nodes_t &hier_nodes,
+    gedgemap_t &edge_map,
+    std::vector<int> &nid2gid,
+    mutable_graph_t *mg,
+    qflow_chart_t *fc)
+{
+  if (build_hier_mg(gm, expand, node_map, hier_nodes, edge_map, nid2gid, mg, fc))
+    return true;
+
+  // Leave no partial view behind
+  node_map.clear();
+  hier_nodes.clear();
+  edge_map.clear();
+  nid2gid.clear();
+  return false;
+}
+
 //--------------------------------------------------------------------------
 void build_groupman_from_fc(
     qflow_chart_t *fc,
@@ -148,11 +605,56 @@ void build_groupman_from_3dvec(
   }
 }
 
+//--------------------------------------------------------------------------
+const char *sanitize_report_t::get_kind_name(sanitize_issue_e kind)
+{
+  static const char *const names[sanitize_issue_count] =
+  {
+    "missing",
+    "stale range",
+    "duplicate",
+    "out of range",
+  };
+  return kind < sanitize_issue_count ? names[kind] : "unknown";
+}
+
+//--------------------------------------------------------------------------
+static void add_sanitize_issue(
+    sanitize_report_t *report,
+    sanitize_issue_e kind,
+    psupergroup_t sg,
+    pnodedef_t nd,
+    qflow_chart_t *fc)
+{
+  if (report == NULL)
+    return;
+
+  sanitize_issue_t issue;
+  issue.kind = kind;
+  issue.nid = nd->nid;
+  issue.sg = sg;
+  issue.nd = nd;
+  if (kind == sanitize_out_of_range)
+  {
+    issue.fc_start = issue.fc_end = BADADDR;
+  }
+  else
+  {
+    qbasic_block_t &block = fc->blocks[nd->nid];
+    issue.fc_start = block.startEA;
+    issue.fc_end = block.endEA;
+  }
+
+  report->issues.push_back(issue);
+  ++report->counts[kind];
+}
+
 //--------------------------------------------------------------------------
 bool sanitize_groupman(
   ea_t func_ea,
   groupman_t *gm,
-  qflow_chart_t *fc)
+  qflow_chart_t *fc,
+  sanitize_report_t *report)
 {
   // Build function's flowchart (if needed)
   qflow_chart_t _fc;
@@ -163,49 +665,121 @@ bool sanitize_groupman(
       return false;
   }
 
-  // Create a group for all potentially missing nodes
-  psupergroup_t missing_sg = new supergroup_t();
+  if (report != NULL)
+    report->clear();
 
   int nodes_count = fc->size();
 
-  nid2ndef_t *nds = gm->get_nds();
+  // Presence bitmap of the flowchart nodes
+  std::vector<bool> present(nodes_count, false);
+  int present_count = 0;
+
+  // Check all the nodes of the path SGL in a single pass
+  psupergroup_listp_t sgl = gm->get_path_sgl();
+  for (supergroup_listp_t::iterator it=sgl->begin();
+       it != sgl->end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
+    {
+      pnodegroup_t ng = *it;
+      for (nodegroup_t::iterator it=ng->begin();
+           it != ng->end();
+           ++it)
+      {
+        pnodedef_t nd = *it;
+        int nid = nd->nid;
+        if (nid < 0 || nid >= nodes_count)
+        {
+          add_sanitize_issue(report, sanitize_out_of_range, sg, nd, fc);
+          continue;
+        }
+
+        if (present[nid])
+        {
+          add_sanitize_issue(report, sanitize_duplicate, sg, nd, fc);
+          continue;
+        }
+
+        present[nid] = true;
+        ++present_count;
+
+        qbasic_block_t &block = fc->blocks[nid];
+        if (nd->start != block.startEA || nd->end != block.endEA)
+          add_sanitize_issue(report, sanitize_stale_range, sg, nd, fc);
+      }
+    }
+  }
+
+  int missing_count = nodes_count - present_count;
+  if (missing_count == 0)
+    return true;
+
+  // Allocate the group for all the missing nodes at once
+  gm->get_arena()->reserve(missing_count, missing_count, 1);
+
+  psupergroup_t missing_sg = gm->add_supergroup(gm->get_path_sgl());
+  missing_sg->name = missing_sg->id = "orphan_nodes";
 
-  // Verify that all nodes are present
+  // This is a synthetic group
+  missing_sg->is_synthetic = true;
+
+  nodedef_vec_t orphans;
+  orphans.reserve(missing_count);
   for (int n=0; n < nodes_count; n++)
   {
-    nid2ndef_t::iterator it = nds->find(n);
-    if (it != nds->end())
+    if (present[n])
       continue;
 
+    // Add the node to its own group
+    pnodegroup_t ng = missing_sg->add_nodegroup();
+
     // Convert basic block to an ND
     qbasic_block_t &block = fc->blocks[n];
-    pnodedef_t nd = new nodedef_t();
+    pnodedef_t nd = ng->add_node();
     nd->nid = n;
     nd->start = block.startEA;
     nd->end = block.endEA;
 
-    // Add the node to its own group
-    pnodegroup_t ng = missing_sg->add_nodegroup();
-    ng->add_node(nd);
+    orphans.push_back(nd);
+    add_sanitize_issue(report, sanitize_missing, missing_sg, nd, fc);
   }
 
-  if (missing_sg->gcount() == 0)
+  // Let the lookups know about the new nodes
+  gm->map_nodedefs(orphans);
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool remap_groupman(
+  ea_t func_ea,
+  groupman_t *gm,
+  groupman_t *out,
+  qflow_chart_t *fc,
+  gm_remap_report_t *report)
+{
+  // Build function's flowchart (if needed)
+  qflow_chart_t _fc;
+  if (fc == NULL)
   {
-    // No orphan nodes where found, get rid of the group
-    delete missing_sg;
+    fc = &_fc;
+    if (!get_func_flowchart(func_ea, *fc))
+      return false;
   }
-  else
-  {
-    // Found at least one orphan node, add it to the groupman
-    missing_sg->name = missing_sg->id = "orphan_nodes";
-
-    // This is a synthetic group
-    missing_sg->is_synthetic = true;
 
-    gm->add_supergroup(
-          gm->get_path_sgl(),
-          missing_sg);
+  int nodes_count = fc->size();
+  gm_blocks_t blocks(nodes_count);
+  for (int n=0; n < nodes_count; n++)
+  {
+    qbasic_block_t &block = fc->blocks[n];
+    blocks[n].nid = n;
+    blocks[n].start = block.startEA;
+    blocks[n].end = block.endEA;
   }
 
-  return true;
-}
\ No newline at end of file
+  return gm_remap(gm, blocks, out, report);
+}
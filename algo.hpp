@@ -29,13 +29,26 @@ History
 
 //--------------------------------------------------------------------------
 #include <map>
+#include <set>
 #include <pro.h>
 #include <funcs.hpp>
 #include <gdl.hpp>
 #include <graph.hpp>
 #include "groupman.h"
+#include "gmdiff.h"
+#include "gmhier.h"
 #include "util.h"
 
+//--------------------------------------------------------------------------
+/**
+* @brief Initialize the node data of a combined node from its NG
+*/
+void init_combined_gnode(
+    gnode_t *gn,
+    nodeloc_t *loc,
+    qflow_chart_t *fc,
+    bool show_nids_only);
+
 //--------------------------------------------------------------------------
 /**
 * @brief Creates a mutable graph that have the combined nodes per the groupmanager
@@ -49,6 +62,7 @@ class fc_to_combined_mg
   gnodemap_t *node_map;
   groupman_t *gm;
   qflow_chart_t *fc;
+  std::vector<int> *nid2gid;
   bool show_nids_only;
 
   /**
@@ -71,51 +85,10 @@ class fc_to_combined_mg
       group_id = group2id->size();  
       (*group2id)[loc->ng] = group_id;
 
-      // Initialize this group's node id
-      gnode_t gn;
-      gn.id = group_id;
-      size_t t = loc->ng->size();
-      for (nodegroup_t::iterator it=loc->ng->begin();
-           it != loc->ng->end();
-           ++it)
-      {
-        if (show_nids_only)
-        {
-          gn.text.cat_sprnt("%d", (*it)->nid);
-          if (--t > 0)
-            gn.text.append(", ");
-        }
-
-        qbasic_block_t &block = fc->blocks[(*it)->nid];
-        qstring s;
-        get_disasm_text(
-          block.startEA, 
-          block.endEA, 
-          &s);
-        gn.hint.append(s);
-      }
-
-      if (!show_nids_only)
-      {
-        // Are there any groupped nodes?
-        if (loc->ng->size() > 1)
-        {
-          //TODO: OPTION: enlarge groupped label
-          gn.text.append("\n\n\n");
-
-          // Display the group name or the group id
-          gn.text.append(loc->sg->get_display_name());
-
-          gn.text.append("\n\n\n");
-        }
-        else
-        {
-          gn.text = gn.hint;
-        }
-      }
-
-      // Cache the node data
-      (*node_map)[group_id] = gn;
+      // Initialize and cache this group's node data
+      gnode_t *gn = node_map->add(group_id);
+      gn->id = group_id;
+      init_combined_gnode(gn, loc, fc, show_nids_only);
     }
     else
     {
@@ -123,6 +96,9 @@ class fc_to_combined_mg
       group_id = it->second;
     }
 
+    if (nid2gid != NULL)
+      (*nid2gid)[n] = group_id;
+
     return group_id;
   }
 
@@ -134,6 +110,7 @@ class fc_to_combined_mg
     groupman_t *gm,
     gnodemap_t &node_map,
     ng2nid_t &group2id,
+    gedgemap_t &edge_map,
     mutable_graph_t *mg)
   {
     // Take a reference to the local variables so they are used
@@ -156,6 +133,13 @@ class fc_to_combined_mg
 
     // Resize the graph
     mg->resize(node_count);
+    if (nid2gid != NULL)
+      nid2gid->resize(fc->size(), -1);
+
+    // Edges in the order they are first met
+    typedef std::vector<gedgemap_t::iterator> edge_order_t;
+    edge_order_t edge_order;
+    edge_map.clear();
 
     // Build the combined graph
     int snodes_count = fc->size();
@@ -184,10 +168,28 @@ class fc_to_combined_mg
           // Do nothing, consider as one node
           continue;
         }
-        // Add an edge
-        mg->add_edge(group_id, succ_grid, NULL);
+
+        // Count the parallel edges as one weighted edge
+        ++edge_map.fc_edge_count;
+        std::pair<gedgemap_t::iterator, bool> ins = edge_map.insert(
+          std::make_pair(std::make_pair(group_id, succ_grid), 0));
+        if (ins.second)
+          edge_order.push_back(ins.first);
+        ++ins.first->second;
       }
     }
+
+    // Add the edges, the heavier ones being thicker
+    for (edge_order_t::iterator it=edge_order.begin();
+         it != edge_order.end();
+         ++it)
+    {
+      gedgemap_t::iterator e = *it;
+
+      edge_info_t ei;
+      ei.width = gedgemap_t::get_width(e->second);
+      mg->add_edge(e->first.first, e->first.second, &ei);
+    }
     return true;
   }
 
@@ -201,7 +203,9 @@ public:
       gnodemap_t &node_map,
       ng2nid_t &group2id,
       mutable_graph_t *mg,
-      qflow_chart_t *fc = NULL): show_nids_only(false)
+      qflow_chart_t *fc = NULL,
+      gedgemap_t *edge_map = NULL,
+      std::vector<int> *nid2gid = NULL): nid2gid(nid2gid), show_nids_only(false)
   {
     // Build function's flowchart (if needed)
     qflow_chart_t _fc;
@@ -212,10 +216,55 @@ public:
         return;
     }
 
-    build(fc, gm, node_map, group2id, mg);
+    gedgemap_t _edge_map;
+    if (edge_map == NULL)
+      edge_map = &_edge_map;
+
+    build(fc, gm, node_map, group2id, *edge_map, mg);
   }
 };
 
+//--------------------------------------------------------------------------
+/**
+* @brief Patch a combined graph built by fc_to_combined_mg() after grouping
+*        edits. Only the combined nodes holding the changed nodes and their
+*        edges are rebuilt: the other combined nodes keep their ids. The
+*        freed ids go to the new combined nodes, the graph must be rebuilt
+*        if some of them are left over
+* @param changed - ids of the changed nodes (see groupman_t::take_changes())
+* @param nid2gid - combined node id of each flowchart node
+* @return False if the graph must be rebuilt instead
+*/
+bool update_combined_mg(
+    groupman_t *gm,
+    const std::vector<int> &changed,
+    gnodemap_t &node_map,
+    ng2nid_t &group2id,
+    gedgemap_t &edge_map,
+    std::vector<int> &nid2gid,
+    mutable_graph_t *mg,
+    qflow_chart_t *fc);
+
+//--------------------------------------------------------------------------
+/**
+* @brief Build the hierarchical view: each SG is one node unless expanded
+*        to its NGs, each NG of an expanded SG is one node unless expanded
+*        to its blocks. Only the nodes of the expanded groups are created
+* @param hier_nodes - receives the level of each graph node
+* @param nid2gid - receives the graph node showing each flowchart node
+* @return False if the groupman does not cover the flowchart. The node data,
+*         the levels, the edges and the node map are then cleared
+*/
+bool fc_to_hier_mg(
+    groupman_t *gm,
+    const hier_expand_t &expand,
+    gnodemap_t &node_map,
+    hier_nodes_t &hier_nodes,
+    gedgemap_t &edge_map,
+    std::vector<int> &nid2gid,
+    mutable_graph_t *mg,
+    qflow_chart_t *fc);
+
 //--------------------------------------------------------------------------
 /**
 * @brief Build a mutable graph from a function address
@@ -246,14 +295,101 @@ void build_groupman_from_3dvec(
   groupman_t *gm,
   bool sanitize);
 
+//--------------------------------------------------------------------------
+/**
+* @brief Kinds of inconsistencies between a groupman and a flowchart
+*/
+enum sanitize_issue_e
+{
+  // A flowchart node is not in the path SGL. It was added to the orphans SG
+  sanitize_missing      = 0,
+  // A node's recorded start/end disagree with its flowchart block
+  sanitize_stale_range  = 1,
+  // A node id appears more than once in the path SGL
+  sanitize_duplicate    = 2,
+  // A node id is not in the flowchart
+  sanitize_out_of_range = 3,
+
+  sanitize_issue_count
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief An inconsistency found by sanitize_groupman()
+*/
+struct sanitize_issue_t
+{
+  sanitize_issue_e kind;
+  int nid;
+
+  // The node as recorded in the groupman (the added one for missing nodes)
+  psupergroup_t sg;
+  pnodedef_t nd;
+
+  // The flowchart block bounds (BADADDR for out of range nodes)
+  ea_t fc_start;
+  ea_t fc_end;
+};
+typedef std::vector<sanitize_issue_t> sanitize_issues_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Result of sanitize_groupman()
+*/
+struct sanitize_report_t
+{
+  sanitize_issues_t issues;
+
+  // Count of issues of each kind
+  size_t counts[sanitize_issue_count];
+
+  sanitize_report_t()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    issues.clear();
+    memset(counts, 0, sizeof(counts));
+  }
+
+  inline bool empty() const { return issues.empty(); }
+
+  /**
+  * @brief Return the name of an issue kind
+  */
+  static const char *get_kind_name(sanitize_issue_e kind);
+};
+
 //--------------------------------------------------------------------------
 /**
 * @brief Sanitize the contents of the groupman path SGL versus the flowchart 
-         of the function
+*        of the function. The nodes that are missing are added to a synthetic
+*        orphans SG. The other inconsistencies are only reported
+* @param report - if not NULL, receives every inconsistency found
 */
 bool sanitize_groupman(
   ea_t func_ea,
   groupman_t *gm,
-  qflow_chart_t *fc = NULL);
+  qflow_chart_t *fc = NULL,
+  sanitize_report_t *report = NULL);
+
+//--------------------------------------------------------------------------
+/**
+* @brief Carry a grouping made for an older flowchart of the function over
+*        to its current flowchart, matching the nodes to the blocks by
+*        address (see gm_remap()). The new blocks are not added: call
+*        sanitize_groupman() on the result
+* @param out - receives the remapped grouping
+* @param report - if not NULL, receives the counts of changes
+* @return True if the grouping had to be remapped into 'out'
+*/
+bool remap_groupman(
+  ea_t func_ea,
+  groupman_t *gm,
+  groupman_t *out,
+  qflow_chart_t *fc = NULL,
+  gm_remap_report_t *report = NULL);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,376 @@
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+BBGroup database module
+
+--------------------------------------------------------------------------*/
+
+#define USE_STANDARD_FILE_FUNCTIONS
+#include "bbgdb.h"
+#include "bufwriter.h"
+#include <fpro.h>
+
+//--------------------------------------------------------------------------
+static const char STR_DB_EXT[] = ".bbgdb";
+
+static const uint32 BBGDB_MAGIC   = 0x44474242; // "BBGD"
+static const uint16 BBGDB_VERSION = 1;
+
+#pragma pack(push, 1)
+struct bbgdb_header_t
+{
+  uint32 magic;
+  uint16 version;
+  uint16 header_size;
+  uint32 count;
+  uint32 reserved;
+  uint64 index_offset;
+};
+
+struct bbgdb_disk_entry_t
+{
+  uint64 func_ea;
+  uint64 offset;
+  uint64 size;
+};
+#pragma pack(pop)
+
+//--------------------------------------------------------------------------
+bbgroup_db_t::bbgroup_db_t(): index_offset(0), dead_bytes(0), batch_fp(NULL)
+{
+}
+
+//--------------------------------------------------------------------------
+bbgroup_db_t::~bbgroup_db_t()
+{
+  close();
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::is_db_filename(const char *filename)
+{
+  size_t len = qstrlen(filename);
+  size_t ext_len = qnumber(STR_DB_EXT) - 1;
+  return len >= ext_len && stricmp(filename + len - ext_len, STR_DB_EXT) == 0;
+}
+
+//--------------------------------------------------------------------------
+void bbgroup_db_t::close()
+{
+  if (batch_fp != NULL)
+    end_batch();
+
+  mf.close();
+  index.clear();
+  filename.qclear();
+  index_offset = 0;
+  dead_bytes = 0;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::open(
+    const char *filename,
+    bool create)
+{
+  close();
+
+  if (!qfileexist(filename))
+  {
+    if (!create)
+      return false;
+
+    // Write an empty database
+    FILE *fp = qfopen(filename, "wb");
+    if (fp == NULL)
+      return false;
+
+    index_offset = sizeof(bbgdb_header_t);
+    bool ok = write_index(fp);
+    qfclose(fp);
+    if (!ok)
+      return false;
+  }
+
+  this->filename = filename;
+  if (!read_index())
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::read_index()
+{
+  index.clear();
+  dead_bytes = 0;
+
+  // The file is mapped but only the header and index pages get touched
+  if (!mf.is_open() && !mf.open(filename.c_str()))
+    return false;
+
+  const char *buf = mf.data();
+  size_t size = mf.size();
+
+  bbgdb_header_t hdr;
+  if (size < sizeof(hdr))
+    return false;
+
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (   hdr.magic != BBGDB_MAGIC
+      || hdr.version > BBGDB_VERSION
+      || hdr.header_size < sizeof(hdr)
+      || hdr.index_offset < hdr.header_size
+      || hdr.index_offset > size
+      || hdr.count > (size - hdr.index_offset) / sizeof(bbgdb_disk_entry_t))
+  {
+    return false;
+  }
+
+  index_offset = hdr.index_offset;
+
+  uint64 live_bytes = hdr.header_size + uint64(hdr.count) * sizeof(bbgdb_disk_entry_t);
+  const char *p = buf + hdr.index_offset;
+  for (uint32 i=0; i < hdr.count; i++, p += sizeof(bbgdb_disk_entry_t))
+  {
+    bbgdb_disk_entry_t de;
+    memcpy(&de, p, sizeof(de));
+
+    // Records live between the header and the index
+    if (   de.offset < hdr.header_size
+        || de.offset > index_offset
+        || de.size > index_offset - de.offset)
+    {
+      index.clear();
+      return false;
+    }
+
+    bbgdb_entry_t &e = index[ea_t(de.func_ea)];
+    e.offset = de.offset;
+    e.size = de.size;
+    live_bytes += de.size;
+  }
+
+  dead_bytes = size - live_bytes;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::write_index(FILE *fp)
+{
+  // Write the index entries
+  std::vector<bbgdb_disk_entry_t> entries;
+  entries.reserve(index.size());
+  for (bbgdb_index_t::const_iterator it=index.begin();
+       it != index.end();
+       ++it)
+  {
+    bbgdb_disk_entry_t de;
+    de.func_ea = it->first;
+    de.offset = it->second.offset;
+    de.size = it->second.size;
+    entries.push_back(de);
+  }
+
+  size_t sz = entries.size() * sizeof(bbgdb_disk_entry_t);
+  if (sz != 0 && qfwrite(fp, &entries[0], sz) != ssize_t(sz))
+    return false;
+
+  // Make sure the index is on the disk before the header refers to it
+  qflush(fp);
+
+  bbgdb_header_t hdr;
+  hdr.magic = BBGDB_MAGIC;
+  hdr.version = BBGDB_VERSION;
+  hdr.header_size = sizeof(hdr);
+  hdr.count = uint32(index.size());
+  hdr.reserved = 0;
+  hdr.index_offset = index_offset;
+
+  if (   qfseek(fp, 0, SEEK_SET) != 0
+      || qfwrite(fp, &hdr, sizeof(hdr)) != sizeof(hdr))
+  {
+    return false;
+  }
+
+  qflush(fp);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::load(
+    ea_t func_ea,
+    groupman_t *gm,
+    bool init_cache)
+{
+  bbgdb_index_t::const_iterator it = index.find(func_ea);
+  if (it == index.end())
+    return false;
+
+  if (!mf.is_open() && !mf.open(filename.c_str()))
+    return false;
+
+  const bbgdb_entry_t &e = it->second;
+  if (e.offset + e.size > mf.size())
+    return false;
+
+  return gm->parse_bin_buffer(
+    mf.data() + size_t(e.offset),
+    size_t(e.size),
+    init_cache);
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::begin_batch()
+{
+  if (!is_open() || batch_fp != NULL)
+    return false;
+
+  // The file is about to grow: drop the mapping
+  mf.close();
+
+  batch_fp = qfopen(filename.c_str(), "r+b");
+  if (batch_fp == NULL)
+    return false;
+
+  // The current index is going to be replaced
+  dead_bytes += index.size() * sizeof(bbgdb_disk_entry_t);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::end_batch()
+{
+  if (batch_fp == NULL)
+    return false;
+
+  // Append the new index
+  bool ok =    qfseek(batch_fp, 0, SEEK_END) == 0
+            && (index_offset = uint64(qftell(batch_fp)), write_index(batch_fp));
+
+  qfclose(batch_fp);
+  batch_fp = NULL;
+
+  // Resync with what is really on the disk
+  if (!ok)
+    read_index();
+
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::store(
+    ea_t func_ea,
+    groupman_t *gm)
+{
+  if (!is_open())
+    return false;
+
+  std::vector<char> rec;
+  if (!gm->emit_bin_buffer(&rec))
+    return false;
+
+  // Outside of a batch, each store is a batch of its own
+  bool own_batch = batch_fp == NULL;
+  if (own_batch && !begin_batch())
+    return false;
+
+  // Append the record
+  bool ok = qfseek(batch_fp, 0, SEEK_END) == 0;
+  uint64 pos = ok ? uint64(qftell(batch_fp)) : 0;
+  ok = ok && (rec.empty() || qfwrite(batch_fp, &rec[0], rec.size()) == ssize_t(rec.size()));
+  if (ok)
+  {
+    // The previous record of this function is now unused
+    bbgdb_entry_t &e = index[func_ea];
+    dead_bytes += e.size;
+
+    e.offset = pos;
+    e.size = rec.size();
+  }
+
+  if (own_batch)
+    ok = end_batch() && ok;
+
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+bool bbgroup_db_t::compact()
+{
+  if (   !is_open() 
+      || batch_fp != NULL 
+      || (!mf.is_open() && !mf.open(filename.c_str())))
+    return false;
+
+  qstring tmp_filename = filename;
+  tmp_filename.append(".tmp");
+
+  FILE *fp = qfopen(tmp_filename.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+
+  // Leave room for the header then copy the live records
+  bbgdb_header_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  bool ok = qfwrite(fp, &hdr, sizeof(hdr)) == sizeof(hdr);
+
+  bbgdb_index_t new_index;
+  uint64 pos = sizeof(hdr);
+  for (bbgdb_index_t::const_iterator it=index.begin();
+       ok && it != index.end();
+       ++it)
+  {
+    const bbgdb_entry_t &e = it->second;
+    if (e.offset + e.size > mf.size())
+    {
+      ok = false;
+      break;
+    }
+
+    ok = e.size == 0 || qfwrite(fp, mf.data() + size_t(e.offset), size_t(e.size)) == ssize_t(e.size);
+
+    bbgdb_entry_t &ne = new_index[it->first];
+    ne.offset = pos;
+    ne.size = e.size;
+    pos += e.size;
+  }
+
+  // Write the index with the new offsets
+  uint64 old_index_offset = index_offset;
+  bool swapped = ok;
+  if (ok)
+  {
+    index.swap(new_index);
+    index_offset = pos;
+    ok = write_index(fp);
+  }
+  qfclose(fp);
+
+  if (!ok)
+  {
+    qunlink(tmp_filename.c_str());
+    if (swapped)
+    {
+      index.swap(new_index);
+      index_offset = old_index_offset;
+    }
+    return false;
+  }
+
+  // Replace the database file
+  mf.close();
+  if (!replace_file(tmp_filename.c_str(), filename.c_str()))
+  {
+    // The old file is still in place: go back to its layout
+    qunlink(tmp_filename.c_str());
+    index.swap(new_index);
+    index_offset = old_index_offset;
+    return false;
+  }
+
+  dead_bytes = 0;
+  return true;
+}
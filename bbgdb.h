@@ -0,0 +1,152 @@
+#ifndef __BBGDB__
+#define __BBGDB__
+
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+BBGroup database module
+
+This module stores the groupings of many functions in a single file.
+Each function is kept as a binary bbgroup record and found through an
+index keyed by the function start address.
+
+--------------------------------------------------------------------------*/
+
+//--------------------------------------------------------------------------
+#include <pro.h>
+#include <map>
+#include "groupman.h"
+#include "mmfile.h"
+
+//--------------------------------------------------------------------------
+/**
+* @brief Location of a function record in the database file
+*/
+struct bbgdb_entry_t
+{
+  uint64 offset;
+  uint64 size;
+};
+
+//--------------------------------------------------------------------------
+typedef std::map<ea_t, bbgdb_entry_t> bbgdb_index_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Multi-function bbgroup database
+*
+* Layout of the file:
+*   header : magic, version, count of index entries and index file offset
+*   records: binary bbgroup records (see groupman_t::emit_bin_buffer())
+*   index  : (function EA, record offset, record size) entries
+*
+* Storing a function appends its record and a new index at the end of
+* the file, then points the header to the new index. The records and
+* the indices that were replaced are left behind until compact() is called.
+* Many stores can share a single index write with begin_batch()/end_batch().
+*/
+class bbgroup_db_t
+{
+  qstring filename;
+  bbgdb_index_t index;
+  uint64 index_offset;
+  uint64 dead_bytes;
+
+  // Mapped lazily when a function is loaded
+  mmfile_t mf;
+
+  // File opened for appending while a batch of stores is in progress
+  FILE *batch_fp;
+
+  // Not copyable
+  bbgroup_db_t(const bbgroup_db_t &);
+  bbgroup_db_t &operator=(const bbgroup_db_t &);
+
+  /**
+  * @brief Read the header and the index
+  */
+  bool read_index();
+
+  /**
+  * @brief Write the index at the current file position then the header
+  */
+  bool write_index(FILE *fp);
+
+public:
+  bbgroup_db_t();
+  ~bbgroup_db_t();
+
+  /**
+  * @brief Open a database file. Only the index is read
+  * @param create - create an empty database if the file does not exist
+  */
+  bool open(
+    const char *filename,
+    bool create = false);
+
+  /**
+  * @brief Close the database
+  */
+  void close();
+
+  /**
+  * @brief Is the database opened?
+  */
+  inline bool is_open() const { return !filename.empty(); }
+
+  /**
+  * @brief Return the per-function index
+  */
+  inline const bbgdb_index_t &get_index() const { return index; }
+
+  /**
+  * @brief Return the count of bytes taken by replaced records and indices
+  */
+  inline uint64 get_dead_bytes() const { return dead_bytes; }
+
+  /**
+  * @brief Checks whether the grouping of a function is stored
+  */
+  inline bool has_function(ea_t func_ea) const
+  {
+    return index.find(func_ea) != index.end();
+  }
+
+  /**
+  * @brief Load the grouping of one function
+  */
+  bool load(
+    ea_t func_ea,
+    groupman_t *gm,
+    bool init_cache = true);
+
+  /**
+  * @brief Store (or replace) the grouping of one function by appending it
+  */
+  bool store(
+    ea_t func_ea,
+    groupman_t *gm);
+
+  /**
+  * @brief Start a batch of stores: the index is written once by end_batch()
+  */
+  bool begin_batch();
+
+  /**
+  * @brief Write the index of the records stored since begin_batch()
+  */
+  bool end_batch();
+
+  /**
+  * @brief Rewrite the database without the replaced records
+  */
+  bool compact();
+
+  /**
+  * @brief Checks whether a file name has the database extension
+  */
+  static bool is_db_filename(const char *filename);
+};
+
+#endif
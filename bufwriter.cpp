@@ -0,0 +1,168 @@
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Buffered writer module
+
+--------------------------------------------------------------------------*/
+
+#ifdef __NT__
+  #include <windows.h>
+#endif
+
+#define USE_STANDARD_FILE_FUNCTIONS
+#include "bufwriter.h"
+#include <fpro.h>
+
+//--------------------------------------------------------------------------
+bool replace_file(
+    const char *src,
+    const char *dst)
+{
+#ifdef __NT__
+  return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+#else
+  // rename() atomically replaces the destination
+  return qrename(src, dst) == 0;
+#endif
+}
+
+//--------------------------------------------------------------------------
+bufwriter_t::bufwriter_t(size_t cap): fp(NULL), used(0), cap(cap), failed(false)
+{
+  buf = (char *)qalloc(cap);
+}
+
+//--------------------------------------------------------------------------
+bufwriter_t::~bufwriter_t()
+{
+  close();
+  qfree(buf);
+}
+
+//--------------------------------------------------------------------------
+bool bufwriter_t::open(
+    const char *filename,
+    bool text,
+    bool atomic)
+{
+  close();
+
+  if (buf == NULL)
+    return false;
+
+  this->filename = filename;
+  if (atomic)
+  {
+    tmp_filename = filename;
+    tmp_filename.append(".tmp");
+  }
+  else
+  {
+    tmp_filename.qclear();
+  }
+
+  fp = qfopen(atomic ? tmp_filename.c_str() : filename, text ? "w" : "wb");
+  used = 0;
+  failed = fp == NULL;
+
+  return fp != NULL;
+}
+
+//--------------------------------------------------------------------------
+bool bufwriter_t::flush()
+{
+  if (used != 0 && fp != NULL && !failed)
+    failed = qfwrite(fp, buf, used) != ssize_t(used);
+
+  used = 0;
+  return !failed;
+}
+
+//--------------------------------------------------------------------------
+bool bufwriter_t::close()
+{
+  if (fp == NULL)
+    return false;
+
+  flush();
+  if (qfclose(fp) != 0)
+    failed = true;
+
+  fp = NULL;
+
+  if (!tmp_filename.empty())
+  {
+    if (failed || !replace_file(tmp_filename.c_str(), filename.c_str()))
+    {
+      qunlink(tmp_filename.c_str());
+      failed = true;
+    }
+    tmp_filename.qclear();
+  }
+
+  return !failed;
+}
+
+//--------------------------------------------------------------------------
+void bufwriter_t::write(const void *p, size_t n)
+{
+  const char *s = (const char *)p;
+
+  // Big blocks do not go through the buffer
+  if (n >= cap)
+  {
+    flush();
+    if (fp != NULL && !failed)
+      failed = qfwrite(fp, s, n) != ssize_t(n);
+    return;
+  }
+
+  while (n > 0)
+  {
+    if (used == cap)
+      flush();
+
+    size_t c = qmin(n, cap - used);
+    memcpy(buf + used, s, c);
+    used += c;
+    s += c;
+    n -= c;
+  }
+}
+
+//--------------------------------------------------------------------------
+void bufwriter_t::put_dec(int v)
+{
+  char tmp[16];
+  char *p = tmp + sizeof(tmp);
+
+  // Work on the unsigned value so INT_MIN is handled
+  uint32 u = v < 0 ? 0 - uint32(v) : uint32(v);
+  do
+  {
+    *--p = char('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+
+  if (v < 0)
+    *--p = '-';
+
+  write(p, tmp + sizeof(tmp) - p);
+}
+
+//--------------------------------------------------------------------------
+void bufwriter_t::put_hex(uint64 v)
+{
+  static const char digits[] = "0123456789ABCDEF";
+
+  char tmp[16];
+  char *p = tmp + sizeof(tmp);
+  do
+  {
+    *--p = digits[v & 0xF];
+    v >>= 4;
+  } while (v != 0);
+
+  write(p, tmp + sizeof(tmp) - p);
+}
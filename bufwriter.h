@@ -0,0 +1,107 @@
+#ifndef __BUFWRITER__
+#define __BUFWRITER__
+
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Buffered writer module
+
+This module formats output into a large reusable buffer and writes it to
+the file in big chunks. Files can be written to a temporary file that
+replaces the destination only once everything was written successfully.
+
+--------------------------------------------------------------------------*/
+
+//--------------------------------------------------------------------------
+#include <pro.h>
+#include <stdio.h>
+
+//--------------------------------------------------------------------------
+/**
+* @brief Buffered file writer with fast integer formatting
+*/
+class bufwriter_t
+{
+  FILE *fp;
+  char *buf;
+  size_t used;
+  size_t cap;
+  bool failed;
+
+  qstring filename;
+  qstring tmp_filename;
+
+  // Not copyable
+  bufwriter_t(const bufwriter_t &);
+  bufwriter_t &operator=(const bufwriter_t &);
+
+public:
+  bufwriter_t(size_t cap = 256 * 1024);
+  ~bufwriter_t();
+
+  /**
+  * @brief Open the output file
+  * @param text - open the file in text mode
+  * @param atomic - write to a temporary file renamed to 'filename' by close()
+  */
+  bool open(
+    const char *filename,
+    bool text,
+    bool atomic = false);
+
+  /**
+  * @brief Flush and close the file
+  * @return False if anything failed to be written.
+  *         In atomic mode, the destination file is then left untouched
+  */
+  bool close();
+
+  /**
+  * @brief Write the buffer contents to the file
+  */
+  bool flush();
+
+  /**
+  * @brief Write raw bytes
+  */
+  void write(const void *p, size_t n);
+
+  /**
+  * @brief Write a character
+  */
+  inline void put(char c)
+  {
+    if (used == cap)
+      flush();
+    buf[used++] = c;
+  }
+
+  /**
+  * @brief Write a NUL terminated string
+  */
+  inline void put(const char *s)
+  {
+    write(s, qstrlen(s));
+  }
+
+  /**
+  * @brief Write a signed decimal number (as "%d")
+  */
+  void put_dec(int v);
+
+  /**
+  * @brief Write an unsigned uppercase hexadecimal number (as "%X")
+  */
+  void put_hex(uint64 v);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Replace a file with another one
+*/
+bool replace_file(
+    const char *src,
+    const char *dst);
+
+#endif
@@ -0,0 +1,993 @@
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Grouping diff and merge module
+
+--------------------------------------------------------------------------*/
+
+#include "gmdiff.h"
+#include <algorithm>
+
+//--------------------------------------------------------------------------
+//--  LAYOUTS  -------------------------------------------------------------
+//--------------------------------------------------------------------------
+// Every node met in the compared groupings gets an index in a table of
+// (start, end) keys sorted by address. Each grouping is then flattened into
+// a layout: its SGs, its NGs and the NG of each node index.
+//--------------------------------------------------------------------------
+typedef std::pair<ea_t, ea_t> gd_key_t;
+typedef std::vector<gd_key_t> gd_keys_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief An NG of a layout. Its nodes are nodes[first, first + count)
+*/
+struct gd_ng_t
+{
+  pnodegroup_t ng;
+  int sg;
+  int first;
+  int count;
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief A flattened path grouping
+*/
+class gd_layout_t
+{
+public:
+  std::vector<psupergroup_t> sgs;
+  std::vector<gd_ng_t> ngs;
+
+  /**
+  * @brief The node indices of all the NGs, in the NGs order
+  */
+  std::vector<int> nodes;
+
+  /**
+  * @brief NG and node definition of each node index (-1/NULL if absent)
+  */
+  std::vector<int> node_ng;
+  nodedef_vec_t node_nd;
+
+  void build(groupman_t *gm, const gd_keys_t &keys);
+
+  /**
+  * @brief Return the NG of 'other' having the same nodes as one of our NGs
+  * @return The NG index or -1
+  */
+  int find_same(int ng, const gd_layout_t &other) const;
+
+  /**
+  * @brief Return the NG of a node index
+  */
+  inline int get_ng(int k) const { return node_ng[k]; }
+
+  /**
+  * @brief Return the SG of a node index or -1
+  */
+  inline int get_sg(int k) const
+  {
+    int ng = node_ng[k];
+    return ng < 0 ? -1 : ngs[ng].sg;
+  }
+};
+
+//--------------------------------------------------------------------------
+static inline int find_key(
+    const gd_keys_t &keys,
+    pnodedef_t nd)
+{
+  return int(std::lower_bound(
+    keys.begin(),
+    keys.end(),
+    gd_key_t(nd->start, nd->end)) - keys.begin());
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Collect the sorted keys of the nodes of many groupings
+*/
+static void collect_keys(
+    groupman_t **gms,
+    int count,
+    gd_keys_t *keys)
+{
+  keys->clear();
+  for (int i=0; i < count; i++)
+  {
+    nid2ndef_t *nds = gms[i]->get_nds();
+    keys->reserve(keys->size() + nds->size());
+
+    psupergroup_listp_t sgl = gms[i]->get_path_sgl();
+    for (supergroup_listp_t::iterator it=sgl->begin(); it != sgl->end(); ++it)
+    {
+      psupergroup_t sg = *it;
+      for (nodegroup_list_t::iterator it=sg->groups.begin(); it != sg->groups.end(); ++it)
+      {
+        pnodegroup_t ng = *it;
+        for (nodegroup_t::iterator it=ng->begin(); it != ng->end(); ++it)
+        {
+          pnodedef_t nd = *it;
+          keys->push_back(gd_key_t(nd->start, nd->end));
+        }
+      }
+    }
+  }
+
+  std::sort(keys->begin(), keys->end());
+  keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+}
+
+//--------------------------------------------------------------------------
+void gd_layout_t::build(
+    groupman_t *gm,
+    const gd_keys_t &keys)
+{
+  node_ng.assign(keys.size(), -1);
+  node_nd.assign(keys.size(), NULL);
+
+  psupergroup_listp_t sgl = gm->get_path_sgl();
+  for (supergroup_listp_t::iterator it=sgl->begin(); it != sgl->end(); ++it)
+  {
+    psupergroup_t sg = *it;
+    int sg_idx = int(sgs.size());
+    sgs.push_back(sg);
+
+    for (nodegroup_list_t::iterator it=sg->groups.begin(); it != sg->groups.end(); ++it)
+    {
+      gd_ng_t gng;
+      gng.ng = *it;
+      gng.sg = sg_idx;
+      gng.first = int(nodes.size());
+
+      int ng_idx = int(ngs.size());
+      for (nodegroup_t::iterator it=gng.ng->begin(); it != gng.ng->end(); ++it)
+      {
+        // A node met twice stays where it was met first
+        pnodedef_t nd = *it;
+        int k = find_key(keys, nd);
+        if (node_ng[k] >= 0)
+          continue;
+
+        node_ng[k] = ng_idx;
+        node_nd[k] = nd;
+        nodes.push_back(k);
+      }
+
+      // Empty NGs do not group anything
+      gng.count = int(nodes.size()) - gng.first;
+      if (gng.count != 0)
+        ngs.push_back(gng);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+int gd_layout_t::find_same(
+    int ng,
+    const gd_layout_t &other) const
+{
+  const gd_ng_t &gng = ngs[ng];
+  int other_ng = other.node_ng[nodes[gng.first]];
+  if (other_ng < 0 || other.ngs[other_ng].count != gng.count)
+    return -1;
+
+  for (int i=1; i < gng.count; i++)
+  {
+    if (other.node_ng[nodes[gng.first + i]] != other_ng)
+      return -1;
+  }
+  return other_ng;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Pair the SGs of two layouts: each SG goes with the SG sharing the
+*        most nodes with it if that SG picks it back
+*/
+static void match_sgs(
+    const gd_layout_t &x,
+    const gd_layout_t &y,
+    std::vector<int> *x2y,
+    std::vector<int> *y2x)
+{
+  // Count the nodes shared by each pair of SGs
+  typedef std::pair<int, int> sg_pair_t;
+  std::vector<sg_pair_t> pairs;
+  for (size_t k=0; k < x.node_ng.size(); k++)
+  {
+    int sx = x.get_sg(int(k)), sy = y.get_sg(int(k));
+    if (sx >= 0 && sy >= 0)
+      pairs.push_back(sg_pair_t(sx, sy));
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  std::vector<size_t> x_best(x.sgs.size(), 0), y_best(y.sgs.size(), 0);
+  std::vector<int> x_pick(x.sgs.size(), -1), y_pick(y.sgs.size(), -1);
+  for (size_t i=0, j; i < pairs.size(); i = j)
+  {
+    for (j=i+1; j < pairs.size() && pairs[j] == pairs[i]; j++)
+      ;
+
+    int sx = pairs[i].first, sy = pairs[i].second;
+    size_t shared = j - i;
+    if (shared > x_best[sx])
+    {
+      x_best[sx] = shared;
+      x_pick[sx] = sy;
+    }
+    if (shared > y_best[sy])
+    {
+      y_best[sy] = shared;
+      y_pick[sy] = sx;
+    }
+  }
+
+  x2y->assign(x.sgs.size(), -1);
+  y2x->assign(y.sgs.size(), -1);
+  for (size_t sx=0; sx < x.sgs.size(); sx++)
+  {
+    int sy = x_pick[sx];
+    if (sy >= 0 && y_pick[sy] == int(sx))
+    {
+      (*x2y)[sx] = sy;
+      (*y2x)[sy] = int(sx);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+//--  DIFF  ----------------------------------------------------------------
+//--------------------------------------------------------------------------
+void gm_diff_t::clear()
+{
+  ops.clear();
+  memset(counts, 0, sizeof(counts));
+}
+
+//--------------------------------------------------------------------------
+const char *gm_diff_t::get_kind_name(gm_diff_op_e kind)
+{
+  static const char *const names[gm_diff_op_count] =
+  {
+    "sg_add",
+    "sg_remove",
+    "sg_attr",
+    "ng_add",
+    "ng_remove",
+    "ng_move"
+  };
+  return kind < gm_diff_op_count ? names[kind] : "?";
+}
+
+//--------------------------------------------------------------------------
+static void add_diff_op(
+    gm_diff_t *diff,
+    gm_diff_op_e kind,
+    psupergroup_t sg_a,
+    pnodegroup_t ng_a,
+    psupergroup_t sg_b,
+    pnodegroup_t ng_b)
+{
+  gm_diff_op_t op;
+  op.kind = kind;
+  op.sg_a = sg_a;
+  op.ng_a = ng_a;
+  op.sg_b = sg_b;
+  op.ng_b = ng_b;
+  diff->ops.push_back(op);
+  ++diff->counts[kind];
+}
+
+//--------------------------------------------------------------------------
+void gm_diff(
+    groupman_t *a,
+    groupman_t *b,
+    gm_diff_t *diff)
+{
+  diff->clear();
+
+  groupman_t *gms[2] = {a, b};
+  gd_keys_t keys;
+  collect_keys(gms, 2, &keys);
+
+  gd_layout_t la, lb;
+  la.build(a, keys);
+  lb.build(b, keys);
+
+  std::vector<int> a2b, b2a;
+  match_sgs(la, lb, &a2b, &b2a);
+
+  // Removed and renamed SGs
+  for (size_t i=0; i < la.sgs.size(); i++)
+  {
+    psupergroup_t sg_a = la.sgs[i];
+    if (a2b[i] < 0)
+    {
+      add_diff_op(diff, gm_diff_sg_remove, sg_a, NULL, NULL, NULL);
+      continue;
+    }
+
+    psupergroup_t sg_b = lb.sgs[a2b[i]];
+    if (sg_a->id != sg_b->id || sg_a->name != sg_b->name)
+      add_diff_op(diff, gm_diff_sg_attr, sg_a, NULL, sg_b, NULL);
+  }
+
+  // Removed and moved NGs
+  for (size_t i=0; i < la.ngs.size(); i++)
+  {
+    const gd_ng_t &ng_a = la.ngs[i];
+    psupergroup_t sg_a = la.sgs[ng_a.sg];
+
+    int j = la.find_same(int(i), lb);
+    if (j < 0)
+    {
+      add_diff_op(diff, gm_diff_ng_remove, sg_a, ng_a.ng, NULL, NULL);
+      continue;
+    }
+
+    const gd_ng_t &ng_b = lb.ngs[j];
+    if (a2b[ng_a.sg] != ng_b.sg)
+      add_diff_op(diff, gm_diff_ng_move, sg_a, ng_a.ng, lb.sgs[ng_b.sg], ng_b.ng);
+  }
+
+  // Added NGs
+  for (size_t j=0; j < lb.ngs.size(); j++)
+  {
+    const gd_ng_t &ng_b = lb.ngs[j];
+    if (lb.find_same(int(j), la) < 0)
+      add_diff_op(diff, gm_diff_ng_add, NULL, NULL, lb.sgs[ng_b.sg], ng_b.ng);
+  }
+
+  // Added SGs
+  for (size_t j=0; j < lb.sgs.size(); j++)
+  {
+    if (b2a[j] < 0)
+      add_diff_op(diff, gm_diff_sg_add, NULL, NULL, lb.sgs[j], NULL);
+  }
+}
+
+//--------------------------------------------------------------------------
+//--  THREE-WAY MERGE  -----------------------------------------------------
+//--------------------------------------------------------------------------
+// The nodes changed by a side are the nodes of its NGs that are not in the
+// base and of the base NGs it did not keep. Linking these nodes per NG in a
+// disjoint set gives regions that each side grouped on its own: each region
+// is taken as a whole from the base, from the only side that changed it or
+// from "our" side.
+//--------------------------------------------------------------------------
+enum
+{
+  GD_BASE   = 0,
+  GD_OURS   = 1,
+  GD_THEIRS = 2,
+  GD_SIDES  = 3
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Disjoint set of node indices
+*/
+class gd_uf_t
+{
+  std::vector<int> parent;
+
+public:
+  gd_uf_t(size_t count): parent(count)
+  {
+    for (size_t i=0; i < count; i++)
+      parent[i] = int(i);
+  }
+
+  int find(int k)
+  {
+    while (parent[k] != k)
+    {
+      parent[k] = parent[parent[k]];
+      k = parent[k];
+    }
+    return k;
+  }
+
+  void link(int a, int b)
+  {
+    a = find(a);
+    b = find(b);
+    if (a != b)
+      parent[qmax(a, b)] = qmin(a, b);
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief An NG of the merged grouping
+*/
+struct gd_out_ng_t
+{
+  int side;
+  int ng;
+  int sg;
+  int first_key;
+
+  inline bool operator<(const gd_out_ng_t &other) const
+  {
+    return sg != other.sg ? sg < other.sg : first_key < other.first_key;
+  }
+};
+
+//--------------------------------------------------------------------------
+void gm_merge_report_t::clear()
+{
+  conflicts.clear();
+  memset(counts, 0, sizeof(counts));
+}
+
+//--------------------------------------------------------------------------
+const char *gm_merge_report_t::get_kind_name(gm_conflict_e kind)
+{
+  static const char *const names[gm_conflict_count] =
+  {
+    "grouping",
+    "placement",
+    "attr"
+  };
+  return kind < gm_conflict_count ? names[kind] : "?";
+}
+
+//--------------------------------------------------------------------------
+static gm_conflict_t &add_conflict(
+    gm_merge_report_t *report,
+    gm_conflict_e kind,
+    psupergroup_t sg_ours,
+    psupergroup_t sg_theirs)
+{
+  report->conflicts.push_back(gm_conflict_t());
+  gm_conflict_t &c = report->conflicts.back();
+  c.kind = kind;
+  c.sg_ours = sg_ours;
+  c.sg_theirs = sg_theirs;
+  ++report->counts[kind];
+  return c;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Three-way merge of a value. NULL stands for a missing value
+* @return The merged value. 'conflict' is set if both sides changed it
+*/
+template <class T> static const T *merge_value(
+    const T *base,
+    const T *ours,
+    const T *theirs,
+    bool *conflict)
+{
+  bool ours_changed = ours != NULL && (base == NULL || !(*ours == *base));
+  bool theirs_changed = theirs != NULL && (base == NULL || !(*theirs == *base));
+
+  *conflict = ours_changed && theirs_changed && !(*ours == *theirs);
+  if (ours_changed)
+    return ours;
+  if (theirs_changed)
+    return theirs;
+  return base != NULL ? base : ours != NULL ? ours : theirs;
+}
+
+//--------------------------------------------------------------------------
+static bool nd_nid_less(pnodedef_t a, pnodedef_t b)
+{
+  return a->nid < b->nid;
+}
+
+//--------------------------------------------------------------------------
+bool gm_merge3(
+    groupman_t *base,
+    groupman_t *ours,
+    groupman_t *theirs,
+    groupman_t *out,
+    gm_merge_report_t *report)
+{
+  if (out == base || out == ours || out == theirs)
+    return false;
+
+  gm_merge_report_t dummy_report;
+  if (report == NULL)
+    report = &dummy_report;
+  report->clear();
+
+  groupman_t *gms[GD_SIDES] = {base, ours, theirs};
+  gd_keys_t keys;
+  collect_keys(gms, GD_SIDES, &keys);
+
+  int nkeys = int(keys.size());
+  gd_layout_t lay[GD_SIDES];
+  for (int v=0; v < GD_SIDES; v++)
+    lay[v].build(gms[v], keys);
+
+  const gd_layout_t &lb = lay[GD_BASE];
+
+  // Link the nodes each side changed and remember who changed them
+  gd_uf_t uf(nkeys);
+  std::vector<uint8> changed_by(nkeys, 0);
+  for (int v=GD_OURS; v <= GD_THEIRS; v++)
+  {
+    const gd_layout_t &lv = lay[v];
+    uint8 mask = uint8(1 << v);
+    for (int pass=0; pass < 2; pass++)
+    {
+      // New NGs of this side, then base NGs it did not keep
+      const gd_layout_t &l = pass == 0 ? lv : lb;
+      const gd_layout_t &other = pass == 0 ? lb : lv;
+      for (size_t i=0; i < l.ngs.size(); i++)
+      {
+        if (l.find_same(int(i), other) >= 0)
+          continue;
+
+        const gd_ng_t &gng = l.ngs[i];
+        const int *nodes = &l.nodes[gng.first];
+        for (int n=0; n < gng.count; n++)
+        {
+          changed_by[nodes[n]] |= mask;
+          uf.link(nodes[0], nodes[n]);
+        }
+      }
+    }
+  }
+
+  // Decide which side each region is taken from
+  std::vector<uint8> region_changes(nkeys, 0);
+  for (int k=0; k < nkeys; k++)
+    region_changes[uf.find(k)] |= changed_by[k];
+
+  std::vector<uint8> region_side(nkeys, GD_BASE);
+  std::vector<bool> region_conflict(nkeys, false);
+  for (int k=0; k < nkeys; k++)
+  {
+    uint8 changes = region_changes[k];
+    if (changes == (1 << GD_OURS))
+      region_side[k] = GD_OURS;
+    else if (changes == (1 << GD_THEIRS))
+      region_side[k] = GD_THEIRS;
+    else if (changes != 0)
+      region_side[k] = GD_OURS;
+  }
+
+  // Regions changed by both sides conflict unless they were grouped alike
+  for (int v=GD_OURS; v <= GD_THEIRS; v++)
+  {
+    const gd_layout_t &lv = lay[v];
+    const gd_layout_t &other = lay[v == GD_OURS ? GD_THEIRS : GD_OURS];
+    for (size_t i=0; i < lv.ngs.size(); i++)
+    {
+      int r = uf.find(lv.nodes[lv.ngs[i].first]);
+      if (   region_changes[r] == ((1 << GD_OURS) | (1 << GD_THEIRS))
+          && !region_conflict[r]
+          && lv.find_same(int(i), other) < 0)
+      {
+        region_conflict[r] = true;
+      }
+    }
+  }
+
+  // Report the conflicting regions with their nodes
+  std::vector<int> region_report(nkeys, -1);
+  for (int k=0; k < nkeys; k++)
+  {
+    int r = uf.find(k);
+    if (!region_conflict[r])
+      continue;
+
+    if (region_report[r] < 0)
+    {
+      int so = lay[GD_OURS].get_sg(k), st = lay[GD_THEIRS].get_sg(k);
+      add_conflict(
+        report,
+        gm_conflict_grouping,
+        so < 0 ? NULL : lay[GD_OURS].sgs[so],
+        st < 0 ? NULL : lay[GD_THEIRS].sgs[st]);
+      region_report[r] = int(report->conflicts.size() - 1);
+    }
+
+    pnodedef_t nd = lay[GD_OURS].node_nd[k];
+    for (int v=GD_BASE; nd == NULL && v < GD_SIDES; v++)
+      nd = lay[v].node_nd[k];
+    report->conflicts[region_report[r]].nodes.push_back(nd);
+  }
+
+  // SGs of all the sides are given a common identity: the base SG they
+  // match, then the new SGs of our side, then the new SGs of their side
+  std::vector<int> o2b, b2o, t2b, b2t, o2t, t2o;
+  match_sgs(lay[GD_OURS], lb, &o2b, &b2o);
+  match_sgs(lay[GD_THEIRS], lb, &t2b, &b2t);
+  match_sgs(lay[GD_OURS], lay[GD_THEIRS], &o2t, &t2o);
+
+  int nb = int(lb.sgs.size());
+  int no = int(lay[GD_OURS].sgs.size());
+  int nt = int(lay[GD_THEIRS].sgs.size());
+
+  std::vector<int> ident[GD_SIDES];
+  ident[GD_BASE].resize(nb);
+  for (int s=0; s < nb; s++)
+    ident[GD_BASE][s] = s;
+
+  ident[GD_OURS].resize(no);
+  for (int s=0; s < no; s++)
+    ident[GD_OURS][s] = o2b[s] >= 0 ? o2b[s] : nb + s;
+
+  ident[GD_THEIRS].resize(nt);
+  for (int s=0; s < nt; s++)
+  {
+    int so = t2o[s];
+    if (t2b[s] >= 0)
+      ident[GD_THEIRS][s] = t2b[s];
+    else if (so >= 0 && o2b[so] < 0)
+      ident[GD_THEIRS][s] = nb + so;
+    else
+      ident[GD_THEIRS][s] = nb + no + s;
+  }
+
+  int nident = nb + no + nt;
+  std::vector<psupergroup_t> reps[GD_SIDES];
+  for (int v=0; v < GD_SIDES; v++)
+  {
+    reps[v].assign(nident, NULL);
+    for (size_t s=0; s < lay[v].sgs.size(); s++)
+      reps[v][ident[v][s]] = lay[v].sgs[s];
+  }
+
+  // Gather the NGs of each region from its side and place them in an SG
+  std::vector<gd_out_ng_t> out_ngs;
+  for (int side=0; side < GD_SIDES; side++)
+  {
+    const gd_layout_t &ls = lay[side];
+    for (size_t i=0; i < ls.ngs.size(); i++)
+    {
+      const gd_ng_t &gng = ls.ngs[i];
+      int first_key = ls.nodes[gng.first];
+      if (region_side[uf.find(first_key)] != side)
+        continue;
+
+      // Where does each side put this NG?
+      int sg[GD_SIDES];
+      for (int v=0; v < GD_SIDES; v++)
+      {
+        int j = v == side ? int(i) : ls.find_same(int(i), lay[v]);
+        sg[v] = j < 0 ? -1 : ident[v][lay[v].ngs[j].sg];
+      }
+
+      bool conflict;
+      const int *placed = merge_value(
+        sg[GD_BASE] < 0 ? NULL : &sg[GD_BASE],
+        sg[GD_OURS] < 0 ? NULL : &sg[GD_OURS],
+        sg[GD_THEIRS] < 0 ? NULL : &sg[GD_THEIRS],
+        &conflict);
+
+      if (conflict)
+      {
+        gm_conflict_t &c = add_conflict(
+          report,
+          gm_conflict_placement,
+          reps[GD_OURS][sg[GD_OURS]],
+          reps[GD_THEIRS][sg[GD_THEIRS]]);
+        for (int n=0; n < gng.count; n++)
+          c.nodes.push_back(ls.node_nd[ls.nodes[gng.first + n]]);
+      }
+
+      gd_out_ng_t ong;
+      ong.side = side;
+      ong.ng = int(i);
+      ong.sg = *placed;
+      ong.first_key = first_key;
+      out_ngs.push_back(ong);
+    }
+  }
+  std::sort(out_ngs.begin(), out_ngs.end());
+
+  // Build the merged grouping
+  out->clear();
+
+  nodedef_vec_t out_nds;
+  out_nds.reserve(nkeys);
+
+  psupergroup_t out_sg = NULL;
+  int cur_sg = -1;
+  for (size_t i=0; i < out_ngs.size(); i++)
+  {
+    const gd_out_ng_t &ong = out_ngs[i];
+    if (ong.sg != cur_sg)
+    {
+      cur_sg = ong.sg;
+      psupergroup_t sgb = reps[GD_BASE][cur_sg];
+      psupergroup_t sgo = reps[GD_OURS][cur_sg];
+      psupergroup_t sgt = reps[GD_THEIRS][cur_sg];
+
+      bool id_conflict, name_conflict;
+      const qstring *id = merge_value(
+        sgb == NULL ? NULL : &sgb->id,
+        sgo == NULL ? NULL : &sgo->id,
+        sgt == NULL ? NULL : &sgt->id,
+        &id_conflict);
+      const qstring *name = merge_value(
+        sgb == NULL ? NULL : &sgb->name,
+        sgo == NULL ? NULL : &sgo->name,
+        sgt == NULL ? NULL : &sgt->name,
+        &name_conflict);
+
+      if (id_conflict || name_conflict)
+        add_conflict(report, gm_conflict_attr, sgo, sgt);
+
+      out_sg = out->add_supergroup();
+      out_sg->id = *id;
+      out_sg->name = *name;
+      out_sg->is_synthetic = (sgo != NULL ? sgo : sgt != NULL ? sgt : sgb)->is_synthetic;
+    }
+
+    const gd_layout_t &ls = lay[ong.side];
+    const gd_ng_t &gng = ls.ngs[ong.ng];
+    pnodegroup_t ng = out_sg->add_nodegroup();
+    for (int n=0; n < gng.count; n++)
+    {
+      pnodedef_t src = ls.node_nd[ls.nodes[gng.first + n]];
+      pnodedef_t nd = ng->add_node();
+      nd->nid = src->nid;
+      nd->start = src->start;
+      nd->end = src->end;
+      out_nds.push_back(nd);
+    }
+  }
+
+  std::sort(out_nds.begin(), out_nds.end(), nd_nid_less);
+  out->map_nodedefs(out_nds);
+  out->initialize_lookups();
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+//--  REMAP  ---------------------------------------------------------------
+//--------------------------------------------------------------------------
+// Each block is owned by the path node it overlaps the most. The blocks
+// owned by each node are then listed in address order so that the grouping
+// is rebuilt in one walk of the flat view of the path SGs.
+//--------------------------------------------------------------------------
+void gm_remap_report_t::clear()
+{
+  kept = renumbered = resized = split = merged = dropped = added = 0;
+}
+
+//--------------------------------------------------------------------------
+static bool block_start_less(const nodedef_t &a, const nodedef_t &b)
+{
+  return a.start < b.start;
+}
+
+static bool ea_before_block(ea_t ea, const nodedef_t &b)
+{
+  return ea < b.start;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Add the blocks owned by a node to an NG
+*/
+static void add_owned_blocks(
+    const gm_blocks_t &blks,
+    const std::vector<int> &owned,
+    const std::vector<int> &owned_first,
+    int k,
+    pnodegroup_t ng,
+    nodedef_vec_t *out_nds)
+{
+  for (int i=owned_first[k]; i < owned_first[k + 1]; i++)
+  {
+    const nodedef_t &blk = blks[owned[i]];
+    pnodedef_t nd = ng->add_node();
+    nd->nid = blk.nid;
+    nd->start = blk.start;
+    nd->end = blk.end;
+    if (out_nds != NULL)
+      out_nds->push_back(nd);
+  }
+}
+
+//--------------------------------------------------------------------------
+bool gm_remap(
+    groupman_t *gm,
+    const gm_blocks_t &blocks,
+    groupman_t *out,
+    gm_remap_report_t *report)
+{
+  gm_remap_report_t dummy_report;
+  if (report == NULL)
+    report = &dummy_report;
+  report->clear();
+
+  if (out == gm)
+    return false;
+
+  // Blocks by address
+  gm_blocks_t blks(blocks);
+  std::sort(blks.begin(), blks.end(), block_start_less);
+  int nblks = int(blks.size());
+
+  // Load the similar SGs first: it would have the flat view rebuilt
+  psupergroup_listp_t similar_sgl = gm->get_similar_sgl();
+
+  // Find the node owning each block
+  const gm_flat_t *flat = gm->get_flat();
+  int nnodes = int(flat->nd_count());
+  std::vector<int> owner(nblks, -1);
+  std::vector<ea_t> best(nblks, 0);
+  std::vector<int> claims(nblks, 0);
+  for (int k=0; k < nnodes; k++)
+  {
+    ea_t start = flat->starts[k];
+    ea_t end = flat->ends[k];
+
+    // Only the last block starting before the node may overlap it too
+    gm_blocks_t::iterator it = std::upper_bound(blks.begin(), blks.end(), start, ea_before_block);
+    if (it != blks.begin())
+      --it;
+
+    for (; it != blks.end() && it->start < end; ++it)
+    {
+      ea_t lo = qmax(start, it->start);
+      ea_t hi = qmin(end, it->end);
+      if (hi <= lo)
+        continue;
+
+      int b = int(it - blks.begin());
+      ++claims[b];
+      if (hi - lo > best[b])
+      {
+        best[b] = hi - lo;
+        owner[b] = k;
+      }
+    }
+  }
+
+  // List the blocks of each node, in address order
+  std::vector<int> owned_first(nnodes + 1, 0);
+  for (int b=0; b < nblks; b++)
+  {
+    if (owner[b] == -1)
+      ++report->added;
+    else
+      ++owned_first[owner[b] + 1];
+
+    if (claims[b] > 1)
+      ++report->merged;
+  }
+  for (int k=0; k < nnodes; k++)
+    owned_first[k + 1] += owned_first[k];
+
+  std::vector<int> owned(owned_first[nnodes]);
+  std::vector<int> fill(owned_first.begin(), owned_first.end() - 1);
+  for (int b=0; b < nblks; b++)
+  {
+    if (owner[b] != -1)
+      owned[fill[owner[b]]++] = b;
+  }
+
+  for (int k=0; k < nnodes; k++)
+  {
+    int count = owned_first[k + 1] - owned_first[k];
+    if (count == 0)
+    {
+      ++report->dropped;
+    }
+    else if (count > 1)
+    {
+      ++report->split;
+    }
+    else
+    {
+      const nodedef_t &blk = blks[owned[owned_first[k]]];
+      if (blk.start != flat->starts[k] || blk.end != flat->ends[k])
+        ++report->resized;
+      else if (blk.nid != flat->nids[k])
+        ++report->renumbered;
+      else
+        ++report->kept;
+    }
+  }
+
+  if (!report->changed())
+    return false;
+
+  // The similar nodes are found through the path nodes with the same bounds
+  typedef std::pair<gd_key_t, int> gd_key_node_t;
+  std::vector<gd_key_node_t> path_keys(nnodes);
+  for (int k=0; k < nnodes; k++)
+    path_keys[k] = gd_key_node_t(gd_key_t(flat->starts[k], flat->ends[k]), k);
+  std::sort(path_keys.begin(), path_keys.end());
+
+  // Rebuild the grouping, leaving out the NGs and SGs without blocks
+  out->clear();
+  out->src_filename = gm->src_filename;
+  out->extra_sections = gm->extra_sections;
+  out->get_arena()->reserve(owned.size(), flat->ng_count(), flat->sg_count());
+
+  nodedef_vec_t out_nds;
+  out_nds.reserve(owned.size());
+  for (size_t i=0; i < flat->sg_count(); i++)
+  {
+    psupergroup_t src_sg = flat->sgs[i];
+    psupergroup_t sg = NULL;
+    for (uint32 j=flat->ng_begin(i); j < flat->ng_end(i); j++)
+    {
+      pnodegroup_t ng = NULL;
+      for (uint32 k=flat->nd_begin(j); k < flat->nd_end(j); k++)
+      {
+        if (owned_first[k] == owned_first[k + 1])
+          continue;
+
+        if (sg == NULL)
+        {
+          sg = out->add_supergroup();
+          sg->id = src_sg->id;
+          sg->name = src_sg->name;
+          sg->is_synthetic = src_sg->is_synthetic;
+        }
+        if (ng == NULL)
+          ng = sg->add_nodegroup();
+
+        add_owned_blocks(blks, owned, owned_first, k, ng, &out_nds);
+      }
+    }
+  }
+
+  psupergroup_listp_t out_similar = out->get_similar_sgl();
+  for (supergroup_listp_t::iterator it=similar_sgl->begin();
+       it != similar_sgl->end();
+       ++it)
+  {
+    psupergroup_t src_sg = *it;
+    psupergroup_t sg = NULL;
+    for (nodegroup_list_t::iterator it=src_sg->groups.begin();
+         it != src_sg->groups.end();
+         ++it)
+    {
+      pnodegroup_t ng = NULL;
+      for (nodegroup_t::iterator it_nd=(*it)->begin(); it_nd != (*it)->end(); ++it_nd)
+      {
+        pnodedef_t src = *it_nd;
+        std::vector<gd_key_node_t>::iterator it_key = std::lower_bound(
+            path_keys.begin(),
+            path_keys.end(),
+            gd_key_node_t(gd_key_t(src->start, src->end), -1));
+
+        if (   it_key == path_keys.end()
+            || it_key->first != gd_key_t(src->start, src->end))
+        {
+          continue;
+        }
+
+        int k = it_key->second;
+        if (owned_first[k] == owned_first[k + 1])
+          continue;
+
+        if (sg == NULL)
+        {
+          sg = out->add_supergroup(out_similar);
+          sg->id = src_sg->id;
+          sg->name = src_sg->name;
+          sg->is_synthetic = src_sg->is_synthetic;
+        }
+        if (ng == NULL)
+          ng = sg->add_nodegroup();
+
+        // Similar nodes are not mapped: only the path nodes are
+        add_owned_blocks(blks, owned, owned_first, k, ng, NULL);
+      }
+    }
+  }
+
+  std::sort(out_nds.begin(), out_nds.end(), nd_nid_less);
+  out->map_nodedefs(out_nds);
+  out->initialize_lookups();
+
+  return true;
+}
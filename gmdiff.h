@@ -0,0 +1,241 @@
+#ifndef __GMDIFF__
+#define __GMDIFF__
+
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Grouping diff and merge module
+
+This module compares the path groupings of group managers and merges the
+changes made to a common base grouping. Nodes are matched by their start
+and end addresses, not by their node ids, so that groupings made from
+different analyses of the same function can be compared. The same matching
+carries a grouping over to the new blocks of a function that was analyzed
+again.
+
+--------------------------------------------------------------------------*/
+
+//--------------------------------------------------------------------------
+#include <pro.h>
+#include <vector>
+#include "groupman.h"
+
+//--------------------------------------------------------------------------
+/**
+* @brief Kinds of grouping changes
+*/
+enum gm_diff_op_e
+{
+  gm_diff_sg_add    = 0,
+  gm_diff_sg_remove = 1,
+  gm_diff_sg_attr   = 2,
+  gm_diff_ng_add    = 3,
+  gm_diff_ng_remove = 4,
+  gm_diff_ng_move   = 5,
+  gm_diff_op_count
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief A change from a grouping 'a' to a grouping 'b'.
+*        The SG and NG of the side that does not have them are NULL
+*/
+struct gm_diff_op_t
+{
+  gm_diff_op_e kind;
+  psupergroup_t sg_a;
+  pnodegroup_t ng_a;
+  psupergroup_t sg_b;
+  pnodegroup_t ng_b;
+};
+typedef std::vector<gm_diff_op_t> gm_diff_ops_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief The changes between two groupings
+*/
+struct gm_diff_t
+{
+  gm_diff_ops_t ops;
+  size_t counts[gm_diff_op_count];
+
+  gm_diff_t()
+  {
+    clear();
+  }
+
+  void clear();
+
+  inline bool empty() { return ops.empty(); }
+
+  static const char *get_kind_name(gm_diff_op_e kind);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Kinds of merge conflicts
+*/
+enum gm_conflict_e
+{
+  // Both sides grouped the same nodes differently
+  gm_conflict_grouping  = 0,
+
+  // Both sides moved the same NG to different SGs
+  gm_conflict_placement = 1,
+
+  // Both sides changed the ID or the name of the same SG differently
+  gm_conflict_attr      = 2,
+
+  gm_conflict_count
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief A merge conflict. It is resolved by keeping "our" side
+*/
+struct gm_conflict_t
+{
+  gm_conflict_e kind;
+
+  /**
+  * @brief The SGs involved on both sides (NULL if unknown)
+  */
+  psupergroup_t sg_ours;
+  psupergroup_t sg_theirs;
+
+  /**
+  * @brief The nodes involved (none for attribute conflicts)
+  */
+  nodedef_vec_t nodes;
+};
+typedef std::vector<gm_conflict_t> gm_conflicts_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Conflicts met by a three-way merge
+*/
+struct gm_merge_report_t
+{
+  gm_conflicts_t conflicts;
+  size_t counts[gm_conflict_count];
+
+  gm_merge_report_t()
+  {
+    clear();
+  }
+
+  void clear();
+
+  inline bool empty() { return conflicts.empty(); }
+
+  static const char *get_kind_name(gm_conflict_e kind);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Compute the SG and NG changes that turn the grouping 'a' into 'b'.
+*        NGs are the same if they have the same nodes. SGs are paired with
+*        the SG of the other grouping sharing the most nodes with them
+*/
+void gm_diff(
+    groupman_t *a,
+    groupman_t *b,
+    gm_diff_t *diff);
+
+/**
+* @brief Merge the changes made by 'ours' and 'theirs' to the 'base' grouping
+*        The nodes changed by only one side are grouped as that side did.
+*        The nodes changed by both sides are grouped as 'ours' did and
+*        reported as conflicts unless both sides did the same change
+* @param out - receives the merged grouping. It must not be one of the inputs
+* @param report - if not NULL, receives the conflicts
+*/
+bool gm_merge3(
+    groupman_t *base,
+    groupman_t *ours,
+    groupman_t *theirs,
+    groupman_t *out,
+    gm_merge_report_t *report = NULL);
+
+//--------------------------------------------------------------------------
+/**
+* @brief The blocks of a function as nodes: their node ids and bounds
+*/
+typedef std::vector<nodedef_t> gm_blocks_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Counts of the node changes met by gm_remap()
+*/
+struct gm_remap_report_t
+{
+  /**
+  * @brief Nodes found as one block with the same bounds: with the same
+  *        node id or with another one
+  */
+  size_t kept;
+  size_t renumbered;
+
+  /**
+  * @brief Nodes found as one block with other bounds
+  */
+  size_t resized;
+
+  /**
+  * @brief Nodes spread over several blocks
+  */
+  size_t split;
+
+  /**
+  * @brief Blocks covering several nodes. They go to the NG of the node
+  *        they overlap the most
+  */
+  size_t merged;
+
+  /**
+  * @brief Nodes no block overlaps. They are left out
+  */
+  size_t dropped;
+
+  /**
+  * @brief Blocks no node overlaps. They are left out for the caller
+  *        to add (see sanitize_groupman())
+  */
+  size_t added;
+
+  gm_remap_report_t()
+  {
+    clear();
+  }
+
+  void clear();
+
+  /**
+  * @brief Does the grouping need to be remapped?
+  */
+  inline bool changed() const
+  {
+    return renumbered + resized + split + merged + dropped != 0;
+  }
+};
+
+/**
+* @brief Carry the path and similar groupings over to the blocks of a new
+*        analysis of the function. Each block goes to the NG of the path node
+*        it overlaps the most, so split blocks stay together and merged ones
+*        join one of their NGs. The similar nodes follow the path nodes with
+*        the same bounds. It costs O(n log n) in the count of nodes and blocks
+* @param blocks - the new blocks. They must not overlap each other
+* @param out - receives the remapped grouping. It must not be 'gm'
+* @param report - if not NULL, receives the counts of changes
+* @return True if the grouping had to be remapped. Otherwise 'out' is
+*         left untouched
+*/
+bool gm_remap(
+    groupman_t *gm,
+    const gm_blocks_t &blocks,
+    groupman_t *out,
+    gm_remap_report_t *report = NULL);
+
+#endif
@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Hierarchical view state module
+
+--------------------------------------------------------------------------*/
+
+#include "gmhier.h"
+
+//--------------------------------------------------------------------------
+bool hier_expand_t::has_node(
+    const std::set<int> &nids, 
+    const gm_flat_t *flat, 
+    uint32 ng)
+{
+  for (uint32 k=flat->nd_begin(ng); k < flat->nd_end(ng); k++)
+  {
+    if (nids.count(flat->nids[k]) != 0)
+      return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------
+bool hier_expand_t::is_sg_expanded(const gm_flat_t *flat, size_t sg) const
+{
+  if (sg_nids.empty())
+    return false;
+
+  for (uint32 j=flat->ng_begin(sg); j < flat->ng_end(sg); j++)
+  {
+    if (has_node(sg_nids, flat, j))
+      return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------
+bool hier_expand_t::is_ng_expanded(const gm_flat_t *flat, uint32 ng) const
+{
+  return !ng_nids.empty() && has_node(ng_nids, flat, ng);
+}
+
+//--------------------------------------------------------------------------
+bool hier_expand_t::expand(const hier_node_t &hn)
+{
+  switch (hn.level)
+  {
+    case hlvl_sg:
+      sg_nids.insert(hn.nid);
+      return true;
+    case hlvl_ng:
+      ng_nids.insert(hn.nid);
+      return true;
+    default:
+      return false;
+  }
+}
+
+//--------------------------------------------------------------------------
+bool hier_expand_t::collapse(groupman_t *gm, const hier_node_t &hn)
+{
+  nodeloc_t *loc = gm->find_nodeid_loc(hn.nid);
+  if (loc == NULL)
+    return false;
+
+  switch (hn.level)
+  {
+    // Collapse the NG of the block
+    case hlvl_block:
+    {
+      for (nodegroup_t::iterator it=loc->ng->begin(); it != loc->ng->end(); ++it)
+        ng_nids.erase((*it)->nid);
+      return true;
+    }
+    // Collapse the SG of the NG. Its NGs stay expanded if it is expanded again
+    case hlvl_ng:
+    {
+      for (nodegroup_list_t::iterator it=loc->sg->groups.begin();
+           it != loc->sg->groups.end();
+           ++it)
+      {
+        pnodegroup_t ng = *it;
+        for (nodegroup_t::iterator it_nd=ng->begin(); it_nd != ng->end(); ++it_nd)
+          sg_nids.erase((*it_nd)->nid);
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
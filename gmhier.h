@@ -0,0 +1,82 @@
+#ifndef __GMHIER__
+#define __GMHIER__
+
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Hierarchical view state module
+
+This module keeps which groups of the hierarchical view are expanded. The
+state is kept by node ids so that it survives the grouping edits.
+
+--------------------------------------------------------------------------*/
+
+//--------------------------------------------------------------------------
+#include <pro.h>
+#include <set>
+#include <vector>
+#include "groupman.h"
+
+//--------------------------------------------------------------------------
+/**
+* @brief Level of a node of the hierarchical view
+*/
+enum hier_level_e
+{
+  hlvl_sg,
+  hlvl_ng,
+  hlvl_block,
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief A node of the hierarchical view: its level and its first flowchart node
+*/
+struct hier_node_t
+{
+  hier_level_e level;
+  int nid;
+};
+typedef std::vector<hier_node_t> hier_nodes_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief The SGs shown at NG level and the NGs shown at block level.
+*        A group is expanded if any of its nodes was marked so that the
+*        state survives the grouping edits
+*/
+class hier_expand_t
+{
+  std::set<int> sg_nids;
+  std::set<int> ng_nids;
+
+  static bool has_node(const std::set<int> &nids, const gm_flat_t *flat, uint32 ng);
+
+public:
+  /**
+  * @brief Is an SG or an NG of the flat view expanded?
+  */
+  bool is_sg_expanded(const gm_flat_t *flat, size_t sg) const;
+  bool is_ng_expanded(const gm_flat_t *flat, uint32 ng) const;
+
+  /**
+  * @brief Show the groups of an SG node or the blocks of an NG node
+  * @return False if the node cannot be expanded
+  */
+  bool expand(const hier_node_t &hn);
+
+  /**
+  * @brief Show the NG of a block node or the SG of an NG node as one node
+  * @return False if the node cannot be collapsed
+  */
+  bool collapse(groupman_t *gm, const hier_node_t &hn);
+
+  inline void clear()
+  {
+    sg_nids.clear();
+    ng_nids.clear();
+  }
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Grouping publication module
+
+--------------------------------------------------------------------------*/
+
+#include "gmpub.h"
+
+//--------------------------------------------------------------------------
+gm_publisher_t::gm_publisher_t(): current(NULL), epoch(1), owned(false)
+{
+  for (int i=0; i < MAX_READERS; i++)
+  {
+    reader_t &r = readers[i];
+    r.epoch = 0;
+    r.depth = 0;
+    r.gm = NULL;
+    r.used = false;
+  }
+}
+
+//--------------------------------------------------------------------------
+gm_publisher_t::~gm_publisher_t()
+{
+  for (retired_vec_t::iterator it=retired.begin(); it != retired.end(); ++it)
+    delete it->gm;
+
+  delete current.load();
+}
+
+//--------------------------------------------------------------------------
+void gm_publisher_t::set_owner_thread()
+{
+  owner = std::this_thread::get_id();
+  owned = true;
+}
+
+//--------------------------------------------------------------------------
+bool gm_publisher_t::can_edit(groupman_t *gm)
+{
+  // Other threads may be reading the versions of a publisher not owned
+  return    owned
+         && std::this_thread::get_id() == owner
+         && gm != NULL
+         && gm == current.load();
+}
+
+//--------------------------------------------------------------------------
+bool gm_publisher_t::publish(groupman_t *gm)
+{
+  // Snapshots would keep changing the shared groups and their arena
+  if (   gm == NULL 
+      || gm->get_arena()->is_shared()
+      || !is_allowed_thread())
+  {
+    return false;
+  }
+
+  // Build the lookups now: readers must not change anything
+  gm->settle();
+
+  std::lock_guard<std::mutex> lock(write_lock);
+
+  groupman_t *old = current.exchange(gm);
+  if (old == gm)
+    return true;
+
+  // Readers entering from now on see the new version
+  uint64 e = epoch.fetch_add(1);
+  if (old != NULL)
+  {
+    retired_t r;
+    r.gm = old;
+    r.epoch = e;
+    retired.push_back(r);
+  }
+
+  reclaim_locked();
+  return true;
+}
+
+//--------------------------------------------------------------------------
+void gm_publisher_t::reclaim_locked()
+{
+  if (retired.empty())
+    return;
+
+  // The oldest epoch a reader may still hold a version of
+  uint64 oldest = uint64(-1);
+  for (int i=0; i < MAX_READERS; i++)
+  {
+    uint64 e = readers[i].epoch.load();
+    if (e != 0 && e < oldest)
+      oldest = e;
+  }
+
+  // A version retired in epoch 'e' was replaced before epoch 'e+1' began
+  size_t kept = 0;
+  for (size_t i=0; i < retired.size(); i++)
+  {
+    retired_t &r = retired[i];
+    if (r.epoch < oldest)
+      delete r.gm;
+    else
+      retired[kept++] = r;
+  }
+  retired.resize(kept);
+}
+
+//--------------------------------------------------------------------------
+size_t gm_publisher_t::reclaim()
+{
+  std::lock_guard<std::mutex> lock(write_lock);
+  reclaim_locked();
+  return retired.size();
+}
+
+//--------------------------------------------------------------------------
+size_t gm_publisher_t::get_retired_count()
+{
+  std::lock_guard<std::mutex> lock(write_lock);
+  return retired.size();
+}
+
+//--------------------------------------------------------------------------
+int gm_publisher_t::register_reader()
+{
+  if (!is_allowed_thread())
+    return -1;
+
+  for (int i=0; i < MAX_READERS; i++)
+  {
+    bool expected = false;
+    if (readers[i].used.compare_exchange_strong(expected, true))
+    {
+      readers[i].depth = 0;
+      readers[i].gm = NULL;
+      return i;
+    }
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------
+void gm_publisher_t::unregister_reader(int slot)
+{
+  if (slot < 0 || slot >= MAX_READERS)
+    return;
+
+  reader_t &r = readers[slot];
+  r.depth = 0;
+  r.gm = NULL;
+  r.epoch = 0;
+  r.used = false;
+}
+
+//--------------------------------------------------------------------------
+groupman_t *gm_publisher_t::read_lock(int slot)
+{
+  reader_t &r = readers[slot];
+  if (r.depth++ > 0)
+    return r.gm;
+
+  // Announce the epoch before loading the version: a writer that misses
+  // the announcement has already swapped the version
+  r.epoch = epoch.load();
+  r.gm = current.load();
+  return r.gm;
+}
+
+//--------------------------------------------------------------------------
+void gm_publisher_t::read_unlock(int slot)
+{
+  reader_t &r = readers[slot];
+  if (r.depth == 0 || --r.depth > 0)
+    return;
+
+  r.gm = NULL;
+  r.epoch = 0;
+}
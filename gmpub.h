@@ -0,0 +1,209 @@
+#ifndef __GMPUB__
+#define __GMPUB__
+
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Grouping publication module
+
+This module hands groupings over from the threads that compute them to
+the threads that display them. A writer publishes a new version of the
+grouping in one atomic step and readers get a version that does not
+change under them, without taking any lock.
+
+--------------------------------------------------------------------------*/
+
+//--------------------------------------------------------------------------
+#include <pro.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "groupman.h"
+
+//--------------------------------------------------------------------------
+/**
+* @brief Publishes the versions of a grouping to lock-free readers
+*
+* Readers register a slot once then enter and leave read sections. Entering
+* records the current epoch in the slot and returns the current version.
+* Publishing swaps the current version and starts a new epoch: the previous
+* version is retired with the epoch it was replaced in and deleted once
+* every reader in a read section entered a later epoch.
+*
+* Published versions are settled (see groupman_t::settle()) so that reading
+* them changes nothing. They must not be changed afterwards while other
+* threads may read them, and must not share their groups with a group
+* manager that is still changed (see groupman_t::snapshot()).
+*
+* Reader slots belong to one thread each. Read sections of a slot nest and
+* may span several calls: the version stays valid until the outermost
+* section is left. Publishing and reclaiming may be done from any thread.
+*
+* A publisher can instead be owned by one thread (see set_owner_thread()).
+* Readers and writers of other threads are then refused, and the owner may
+* change the current version in place (see can_edit()): nobody else can
+* read it meanwhile. The plugin works this way, its views and its chooser
+* all running in the UI thread.
+*/
+class gm_publisher_t
+{
+public:
+  enum { MAX_READERS = 16 };
+
+private:
+  struct retired_t
+  {
+    groupman_t *gm;
+    uint64 epoch;
+  };
+  typedef std::vector<retired_t> retired_vec_t;
+
+  struct reader_t
+  {
+    /**
+    * @brief Epoch the read section was entered in, 0 outside of sections
+    */
+    std::atomic<uint64> epoch;
+
+    /**
+    * @brief Used by the slot's thread only
+    */
+    int depth;
+    groupman_t *gm;
+
+    std::atomic<bool> used;
+  };
+
+  std::atomic<groupman_t *> current;
+  std::atomic<uint64> epoch;
+  reader_t readers[MAX_READERS];
+
+  // Only thread allowed to read and publish, if 'owned'
+  std::thread::id owner;
+  bool owned;
+
+  // Serializes the writers
+  std::mutex write_lock;
+  retired_vec_t retired;
+
+  // Not copyable
+  gm_publisher_t(const gm_publisher_t &);
+  gm_publisher_t &operator=(const gm_publisher_t &);
+
+  /**
+  * @brief Delete the retired versions no reader can hold anymore
+  */
+  void reclaim_locked();
+
+  /**
+  * @brief Is the calling thread allowed to use the publisher?
+  */
+  inline bool is_allowed_thread()
+  {
+    return !owned || std::this_thread::get_id() == owner;
+  }
+
+public:
+  gm_publisher_t();
+
+  /**
+  * @brief Delete all the versions. No reader may be in a read section
+  */
+  ~gm_publisher_t();
+
+  /**
+  * @brief Restrict the publisher to the calling thread, before any reader
+  *        is registered. The current version may then be changed in place
+  */
+  void set_owner_thread();
+
+  /**
+  * @brief Check whether a version may be changed in place: the publisher
+  *        is owned by the calling thread and it is still the current one.
+  *        Changing a replaced version would lose the changes
+  */
+  bool can_edit(groupman_t *gm);
+
+  /**
+  * @brief Make a group manager the current version and retire the previous
+  *        one. The publisher takes ownership of it
+  * @return False if it shares its groups with another group manager or
+  *         if the publisher is owned by another thread
+  */
+  bool publish(groupman_t *gm);
+
+  /**
+  * @brief Delete the retired versions no reader can hold anymore.
+  *        Publishing already does it
+  * @return The count of retired versions left
+  */
+  size_t reclaim();
+
+  /**
+  * @brief Return the count of retired versions not deleted yet
+  */
+  size_t get_retired_count();
+
+  /**
+  * @brief Return the current version. It is only safe to compare it
+  *        with another version: use a read section to access it
+  */
+  inline groupman_t *peek() { return current.load(); }
+
+  /**
+  * @brief Return the current epoch, incremented by each publication
+  */
+  inline uint64 get_epoch() { return epoch.load(); }
+
+  /**
+  * @brief Get a reader slot
+  * @return The slot or -1 if there are too many readers or if the
+  *         publisher is owned by another thread
+  */
+  int register_reader();
+
+  /**
+  * @brief Release a reader slot, leaving its read section
+  */
+  void unregister_reader(int slot);
+
+  /**
+  * @brief Enter a read section
+  * @return The current version (NULL if none was published) or, in a
+  *         nested section, the version of the outermost one
+  */
+  groupman_t *read_lock(int slot);
+
+  /**
+  * @brief Leave a read section
+  */
+  void read_unlock(int slot);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief A read section for the life of the object
+*/
+class gm_read_guard_t
+{
+  gm_publisher_t *pub;
+  int slot;
+  groupman_t *gm;
+
+public:
+  gm_read_guard_t(gm_publisher_t *pub, int slot): pub(pub), slot(slot)
+  {
+    gm = pub->read_lock(slot);
+  }
+
+  ~gm_read_guard_t()
+  {
+    pub->read_unlock(slot);
+  }
+
+  inline groupman_t *get() { return gm; }
+};
+
+#endif
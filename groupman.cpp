@@ -35,9 +35,13 @@ History
 #include "groupman.h"
 #include <fpro.h>
 #include <string>
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include "util.h"
+#include "mmfile.h"
+#include "bufwriter.h"
 
 //--------------------------------------------------------------------------
 static const char STR_ID[]          = "ID";
@@ -50,6 +54,285 @@ static const char STR_GROUP_NAME[]  = "GROUPNAME";
 static const char STR_PATHINFO[]    = "PATHINFO";
 static const char STR_SIMILARINFO[] = "SIMILARINFO";
 
+// Estimated size of the nodes of std::list and std::map
+#define LIST_NODE_SIZE(T) (2 * sizeof(void *) + sizeof(T))
+#define MAP_NODE_SIZE(K, V) (4 * sizeof(void *) + sizeof(std::pair<const K, V>))
+
+//--------------------------------------------------------------------------
+// Define to check the incrementally updated lookups against a full rebuild
+// after each groupman mutation
+//#define GM_DEBUG_LOOKUPS
+
+#ifdef GM_DEBUG_LOOKUPS
+  #include <kernwin.hpp>
+
+  #define VERIFY_LOOKUPS() \
+    if (!verify_lookups()) \
+      msg("GM: lookups out of sync after %s()\n", __FUNCTION__); \
+    if (!verify_stats()) \
+      msg("GM: stats out of sync after %s()\n", __FUNCTION__); \
+    if (!verify_flat()) \
+      msg("GM: flat view out of sync after %s()\n", __FUNCTION__)
+#else
+  #define VERIFY_LOOKUPS()
+#endif
+
+//--------------------------------------------------------------------------
+//--  NODE ADDRESS INDEX CLASS  --------------------------------------------
+//--------------------------------------------------------------------------
+void ndaddr_index_t::build(nid2ndef_t &nds)
+{
+  clear();
+
+  // Nodes without addresses are never found
+  entries_t entries;
+  entries.reserve(nds.size());
+  for (nid2ndef_t::iterator it=nds.begin(); it != nds.end(); ++it)
+  {
+    pnodedef_t nd = it->second;
+    if (nd->end <= nd->start)
+      continue;
+
+    entry_t e;
+    e.start = nd->start;
+    e.end   = nd->end;
+    e.nd    = nd;
+    entries.push_back(e);
+  }
+
+  // Sort by start address (keep the node id order for equal starts)
+  std::stable_sort(entries.begin(), entries.end());
+
+  // Put each node in the first layer it does not overlap
+  for (size_t i=0; i < entries.size(); i++)
+  {
+    entry_t &e = entries[i];
+    e.order = i;
+
+    size_t l = 0;
+    while (l < layers.size() && layers[l].back().end > e.start)
+      ++l;
+
+    if (l == layers.size())
+    {
+      layers.push_back(entries_t());
+      if (l == 0)
+        layers[0].reserve(entries.size());
+    }
+    layers[l].push_back(e);
+  }
+  count = entries.size();
+}
+
+//--------------------------------------------------------------------------
+bool ndaddr_index_t::ends_at_or_before(const entry_t &e, ea_t ea)
+{
+  return e.end <= ea;
+}
+
+//--------------------------------------------------------------------------
+size_t ndaddr_index_t::mem_bytes()
+{
+  size_t bytes = layers.capacity() * sizeof(entries_t);
+  for (layers_t::iterator it=layers.begin(); it != layers.end(); ++it)
+    bytes += it->capacity() * sizeof(entry_t);
+  return bytes;
+}
+
+//--------------------------------------------------------------------------
+pnodedef_t ndaddr_index_t::find(ea_t ea)
+{
+  entry_t key;
+  key.start = ea;
+
+  // Only the last node of a layer starting at or before 'ea' may contain it.
+  // The last one in address order wins among the layers
+  const entry_t *found = NULL;
+  for (layers_t::iterator it=layers.begin(); it != layers.end(); ++it)
+  {
+    entries_t::iterator e = std::upper_bound(it->begin(), it->end(), key);
+    if (e == it->begin())
+      continue;
+
+    --e;
+    if (e->end > ea && (found == NULL || e->order > found->order))
+      found = &*e;
+  }
+  return found == NULL ? NULL : found->nd;
+}
+
+//--------------------------------------------------------------------------
+size_t ndaddr_index_t::find_range(
+    ea_t start,
+    ea_t end,
+    nodedef_vec_t *out)
+{
+  if (start >= end)
+    return 0;
+
+  entry_t key;
+  key.start = end;
+
+  // The nodes of a layer overlapping [start, end) are contiguous: from the
+  // first one ending after 'start' to the last one starting before 'end'
+  typedef std::pair<size_t, pnodedef_t> hit_t;
+  std::vector<hit_t> hits;
+  size_t first = out->size();
+  for (layers_t::iterator it=layers.begin(); it != layers.end(); ++it)
+  {
+    entries_t::iterator e = std::lower_bound(
+      it->begin(), it->end(), start, ends_at_or_before);
+    entries_t::iterator e_end = std::lower_bound(e, it->end(), key);
+    for (; e != e_end; ++e)
+    {
+      // A single layer is in address order by itself
+      if (layers.size() == 1)
+        out->push_back(e->nd);
+      else
+        hits.push_back(hit_t(e->order, e->nd));
+    }
+  }
+
+  // Return the results in ascending address order
+  std::sort(hits.begin(), hits.end());
+  for (size_t i=0; i < hits.size(); i++)
+    out->push_back(hits[i].second);
+
+  return out->size() - first;
+}
+
+//--------------------------------------------------------------------------
+//--  NODE LOCATION TABLE CLASS  -------------------------------------------
+//--------------------------------------------------------------------------
+void nodeloc_table_t::reset(int max_nid, size_t nodes_count)
+{
+  sparse.clear();
+  count = 0;
+  expected = nodes_count;
+
+  // Size the dense table for all the ids at once if they are not too sparse
+  size_t dense_size = 0;
+  if (max_nid >= 0)
+    dense_size = fits_dense(max_nid) ? max_nid + 1 : nodes_count;
+
+  dense.assign(dense_size, nodeloc_t());
+}
+
+//--------------------------------------------------------------------------
+void nodeloc_table_t::set(int nid, const nodeloc_t &loc)
+{
+  // Grow the dense table geometrically
+  if (size_t(nid) >= dense.size() && fits_dense(nid))
+  {
+    dense.resize(qmax(size_t(nid) + 1, dense.size() * 3 / 2));
+
+    // Move the sparse ids now covered by the dense table
+    sparse_t::iterator it = sparse.lower_bound(0);
+    while (it != sparse.end() && size_t(it->first) < dense.size())
+    {
+      dense[it->first] = it->second;
+      sparse.erase(it++);
+    }
+  }
+
+  nodeloc_t *slot;
+  if (size_t(nid) < dense.size())
+    slot = &dense[nid];
+  else
+    slot = &sparse[nid];
+
+  if (slot->nd == NULL)
+    ++count;
+
+  *slot = loc;
+}
+
+//--------------------------------------------------------------------------
+size_t nodeloc_table_t::mem_bytes()
+{
+  return dense.capacity() * sizeof(nodeloc_t)
+       + sparse.size() * MAP_NODE_SIZE(int, nodeloc_t);
+}
+
+//--------------------------------------------------------------------------
+//--  ARENA CLASS  ---------------------------------------------------------
+//--------------------------------------------------------------------------
+pnodedef_t gm_arena_t::alloc_nd(gm_arena_t *arena)
+{
+  if (arena == NULL)
+    return new nodedef_t();
+  else
+    return arena->nds.alloc();
+}
+
+//--------------------------------------------------------------------------
+pnodegroup_t gm_arena_t::alloc_ng(gm_arena_t *arena)
+{
+  pnodegroup_t ng = arena == NULL ? new nodegroup_t() : arena->ngs.alloc();
+  ng->arena = arena;
+  return ng;
+}
+
+//--------------------------------------------------------------------------
+psupergroup_t gm_arena_t::alloc_sg(gm_arena_t *arena)
+{
+  psupergroup_t sg = arena == NULL ? new supergroup_t() : arena->sgs.alloc();
+  sg->arena = sg->groups.arena = arena;
+  return sg;
+}
+
+//--------------------------------------------------------------------------
+void gm_arena_t::free_nd(gm_arena_t *arena, pnodedef_t nd)
+{
+  if (arena == NULL)
+    delete nd;
+  else if (!arena->releasing && !arena->is_shared())
+    arena->nds.free(nd);
+}
+
+//--------------------------------------------------------------------------
+void gm_arena_t::free_ng(pnodegroup_t ng)
+{
+  gm_arena_t *arena = ng->arena;
+  if (arena == NULL)
+    delete ng;
+  else if (!arena->releasing)
+    arena->ngs.free(ng);
+}
+
+//--------------------------------------------------------------------------
+void gm_arena_t::free_sg(psupergroup_t sg)
+{
+  gm_arena_t *arena = sg->arena;
+  if (arena == NULL)
+  {
+    delete sg;
+  }
+  else if (!arena->releasing)
+  {
+    sg->clear();
+    arena->sgs.free(sg);
+  }
+}
+
+//--------------------------------------------------------------------------
+void gm_arena_t::release()
+{
+  // Destroying the SGs and NGs must not free their children one by one
+  releasing = true;
+  sgs.release();
+  ngs.release();
+  nds.release();
+  releasing = false;
+}
+
+//--------------------------------------------------------------------------
+void gm_arena_t::unref(gm_arena_t *arena)
+{
+  if (--arena->refs == 0)
+    delete arena;
+}
+
 //--------------------------------------------------------------------------
 //--  NODEGROUP_LIST CLASS  ------------------------------------------------
 //--------------------------------------------------------------------------
@@ -61,7 +344,7 @@ void nodegroup_list_t::free_nodegroup(bool free_nodes)
     if (free_nodes)
       ng->free_nodes();
 
-    delete ng;
+    gm_arena_t::free_ng(ng);
   }
 }
 
@@ -88,15 +371,17 @@ pnodegroup_t nodegroup_list_t::get_first_ng()
 pnodegroup_t nodegroup_list_t::find_biggest()
 {
   pnodegroup_t ng = NULL;
+  size_t ng_size = 0;
   for (iterator it=begin();
        it != end();
        ++it)
   {
     pnodegroup_t ng_f = *it;
-    if (    ng == NULL 
-      || ng->size() < ng_f->size())
+    size_t sz = ng_f->get_stats().node_count;
+    if (ng == NULL || ng_size < sz)
     {
       ng = ng_f;
+      ng_size = sz;
     }
   }
   return ng;
@@ -106,7 +391,7 @@ pnodegroup_t nodegroup_list_t::find_biggest()
 pnodegroup_t nodegroup_list_t::add_nodegroup(pnodegroup_t ng)
 {
   if (ng == NULL)
-    ng = new nodegroup_t();
+    ng = gm_arena_t::alloc_ng(arena);
 
   push_back(ng);
 
@@ -123,7 +408,7 @@ void nodegroup_t::free_nodes()
   for (iterator it=begin(); it != end(); ++it)
   {
     pnodedef_t nd = *it;
-    delete nd;
+    gm_arena_t::free_nd(arena, nd);
   }
 }
 
@@ -131,12 +416,29 @@ void nodegroup_t::free_nodes()
 pnodedef_t nodegroup_t::add_node(pnodedef_t nd)
 {
   if (nd == NULL)
-    nd = new nodedef_t();
+  {
+    nd = gm_arena_t::alloc_nd(arena);
+    stats_dirty = true;
+  }
+  else if (!stats_dirty)
+  {
+    stats.add(nd);
+  }
 
   push_back(nd);
   return nd;
 }
 
+//--------------------------------------------------------------------------
+void nodegroup_t::update_stats()
+{
+  stats.clear();
+  for (iterator it=begin(); it != end(); ++it)
+    stats.add(*it);
+
+  stats_dirty = false;
+}
+
 //--------------------------------------------------------------------------
 pnodedef_t nodegroup_t::get_first_node()
 {
@@ -157,17 +459,17 @@ supergroup_t::~supergroup_t()
 }
 
 //--------------------------------------------------------------------------
-supergroup_t::supergroup_t(): is_synthetic(false)
+supergroup_t::supergroup_t(): is_synthetic(false), arena(NULL), owner(0), biggest(NULL), stats_dirty(true)
 {
 }
 
 //--------------------------------------------------------------------------
 pnodegroup_t supergroup_t::add_nodegroup(pnodegroup_t ng)
 {
-  if (ng == NULL)
-    ng = new nodegroup_t();
+  ng = groups.add_nodegroup(ng);
 
-  groups.push_back(ng);
+  // The NG is usually filled after being added
+  invalidate_stats();
   return ng;
 }
 
@@ -176,14 +478,60 @@ void supergroup_t::clear()
 {
   groups.free_nodegroup(true);
   groups.clear();
+
+  stats.clear();
+  biggest = NULL;
+  stats_dirty = false;
 }
 
 //--------------------------------------------------------------------------
 void supergroup_t::remove_nodegroup(pnodegroup_t ng, bool free_ng)
 {
+  stats_sub(ng, ng->get_stats());
   groups.remove(ng);
   if (free_ng)
-    delete ng;
+    gm_arena_t::free_ng(ng);
+}
+
+//--------------------------------------------------------------------------
+void supergroup_t::update_stats()
+{
+  stats.clear();
+  biggest = NULL;
+  for (nodegroup_list_t::iterator it=groups.begin();
+       it != groups.end();
+       ++it)
+  {
+    pnodegroup_t ng = *it;
+    const gm_stats_t &st = ng->get_stats();
+    stats.add(st);
+    if (biggest == NULL || biggest->stats.node_count < st.node_count)
+      biggest = ng;
+  }
+  stats_dirty = false;
+}
+
+//--------------------------------------------------------------------------
+void supergroup_t::stats_add(
+    pnodegroup_t ng,
+    const gm_stats_t &st)
+{
+  if (stats_dirty)
+    return;
+
+  stats.add(st);
+  if (biggest == NULL || biggest->get_stats().node_count < ng->get_stats().node_count)
+    biggest = ng;
+}
+
+//--------------------------------------------------------------------------
+void supergroup_t::stats_sub(
+    pnodegroup_t ng,
+    const gm_stats_t &st)
+{
+  // The biggest NG may not be the biggest anymore
+  if (!stats_dirty && (!stats.sub(st) || ng == biggest))
+    stats_dirty = true;
 }
 
 //--------------------------------------------------------------------------
@@ -200,9 +548,30 @@ pnodegroup_t supergroup_t::get_first_ng()
 }
 
 //--------------------------------------------------------------------------
-void supergroup_listp_t::copy_to(psupergroup_t dest)
+void supergroup_t::copy_to(
+    psupergroup_t dest,
+    pnodegroup_t *ng)
 {
-  //TODO: to deep copy one SG to another
+  dest->id = id;
+  dest->name = name;
+  dest->is_synthetic = is_synthetic;
+
+  for (nodegroup_list_t::iterator it=groups.begin();
+       it != groups.end();
+       ++it)
+  {
+    pnodegroup_t src_ng = *it;
+    pnodegroup_t new_ng = dest->add_nodegroup();
+    new_ng->assign(src_ng->begin(), src_ng->end());
+    new_ng->stats = src_ng->stats;
+    new_ng->stats_dirty = src_ng->stats_dirty;
+
+    if (ng != NULL && *ng == src_ng)
+      *ng = new_ng;
+  }
+
+  // The biggest NG is one of the copies
+  dest->invalidate_stats();
 }
 
 //--------------------------------------------------------------------------
@@ -210,10 +579,7 @@ void supergroup_listp_t::remove_sg(psupergroup_t sg, bool free_sg)
 {
   remove(sg);
   if (free_sg)
-  {
-    sg->clear();
-    delete sg;
-  }
+    gm_arena_t::free_sg(sg);
 }
 
 //--------------------------------------------------------------------------
@@ -246,96 +612,562 @@ void supergroup_t::copy_attr_from(psupergroup_t sg)
 }
 
 //--------------------------------------------------------------------------
-//--  GROUP MANAGER CLASS  -------------------------------------------------
+//--  FLAT VIEW CLASS  -----------------------------------------------------
 //--------------------------------------------------------------------------
+void gm_flat_t::build(
+    psupergroup_listp_t sgl,
+    size_t nd_hint)
+{
+  sgs.clear();
+  ng_first.clear();
+  ngs.clear();
+  nd_first.clear();
+  nds.clear();
+  nids.clear();
+  starts.clear();
+  ends.clear();
+
+  if (nd_hint != 0)
+  {
+    nds.reserve(nd_hint);
+    nids.reserve(nd_hint);
+    starts.reserve(nd_hint);
+    ends.reserve(nd_hint);
+  }
+
+  for (supergroup_listp_t::iterator it=sgl->begin();
+       it != sgl->end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+    sgs.push_back(sg);
+    ng_first.push_back(uint32(ngs.size()));
+
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
+    {
+      pnodegroup_t ng = *it;
+      ngs.push_back(ng);
+      nd_first.push_back(uint32(nds.size()));
+
+      for (nodegroup_t::iterator it=ng->begin(); it != ng->end(); ++it)
+      {
+        pnodedef_t nd = *it;
+        nds.push_back(nd);
+        nids.push_back(nd->nid);
+        starts.push_back(nd->start);
+        ends.push_back(nd->end);
+      }
+    }
+  }
+
+  // Close the last ranges
+  ng_first.push_back(uint32(ngs.size()));
+  nd_first.push_back(uint32(nds.size()));
+}
 
 //--------------------------------------------------------------------------
-groupman_t::~groupman_t()
+void gm_flat_t::clear()
 {
-  clear();
+  std::vector<psupergroup_t>().swap(sgs);
+  std::vector<pnodegroup_t>().swap(ngs);
+  nodedef_vec_t().swap(nds);
+  std::vector<int>().swap(nids);
+  std::vector<ea_t>().swap(starts);
+  std::vector<ea_t>().swap(ends);
+
+  // An empty view still has the closing offsets
+  offsets_t(1, 0).swap(ng_first);
+  offsets_t(1, 0).swap(nd_first);
 }
 
 //--------------------------------------------------------------------------
-void groupman_t::clear()
+size_t gm_flat_t::mem_bytes() const
 {
-  clear_sgl(&path_sgl);
-  clear_sgl(&similar_sgl);
-  all_nodes.clear();
+  return sgs.capacity() * sizeof(psupergroup_t)
+       + ng_first.capacity() * sizeof(uint32)
+       + ngs.capacity() * sizeof(pnodegroup_t)
+       + nd_first.capacity() * sizeof(uint32)
+       + nds.capacity() * sizeof(pnodedef_t)
+       + nids.capacity() * sizeof(int)
+       + starts.capacity() * sizeof(ea_t)
+       + ends.capacity() * sizeof(ea_t);
 }
 
 //--------------------------------------------------------------------------
-void groupman_t::clear_sgl(psupergroup_listp_t sgl)
+//--  GROUP MANAGER CLASS  -------------------------------------------------
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+// Kinds of journal records. Each record is a splice between two lists:
+// the list nodes keep their identity so the iterators stay valid and the
+// same splice can be played back and forth
+enum
 {
-  for (supergroup_listp_t::iterator it=sgl->begin(); 
-       it != sgl->end();
-       ++it)
-  {
-    psupergroup_t sg = *it;
-    delete sg;
-  }
-  sgl->clear();
-}
+  JR_NODES, // A range of nodes moved between two NGs
+  JR_NG,    // An NG moved between two NG lists
+  JR_SGS,   // A range of SGs moved between two SG lists
+  JR_ATTRS, // The attributes of an SG changed
+};
 
 //--------------------------------------------------------------------------
-nodeloc_t *groupman_t::find_nodeid_loc(int nid)
+struct gm_jr_nodes_t
 {
-  nid2nloc_map_t::iterator it = nid2loc.find(nid);
-  if (it == nid2loc.end())
-    return NULL;
-  else
-    return &it->second;
-}
+  psupergroup_t from_sg, to_sg;
+  pnodegroup_t from_ng, to_ng;
+  nodegroup_t::iterator first, last, from_next, to_next;
+};
 
 //--------------------------------------------------------------------------
-nodeloc_t *groupman_t::find_node_loc(ea_t ea)
+struct gm_jr_ng_t
 {
-  //HINT: use a map with lower_bound() if this function is to be called
-  //      frequently and speed is of importance
-  for (nid2ndef_t::iterator it = all_nodes.begin();
-       it != all_nodes.end();
-       ++it)
+  // NULL for the edit's list of detached NGs
+  psupergroup_t from_sg, to_sg;
+  nodegroup_list_t *from, *to;
+  nodegroup_list_t::iterator it, from_next, to_next;
+};
+
+//--------------------------------------------------------------------------
+struct gm_jr_sgs_t
+{
+  psupergroup_listp_t from, to;
+  supergroup_listp_t::iterator first, last, from_next, to_next;
+  size_t count;
+};
+
+//--------------------------------------------------------------------------
+struct gm_jr_attrs_t
+{
+  psupergroup_t sg;
+  qstring old_id, old_name, new_id, new_name;
+  bool old_synthetic, new_synthetic;
+};
+
+//--------------------------------------------------------------------------
+struct gm_jentry_t
+{
+  qstring desc;
+
+  // Kind of each record, in order
+  std::vector<char> order;
+
+  std::vector<gm_jr_nodes_t> nodes;
+  std::vector<gm_jr_ng_t> ngs;
+  std::vector<gm_jr_sgs_t> sgs;
+  std::vector<gm_jr_attrs_t> attrs;
+
+  // The NGs and SGs detached by the edit, or created by it once undone
+  nodegroup_list_t ng_limbo;
+  supergroup_listp_t sg_limbo;
+
+  size_t bytes;
+
+  gm_jentry_t(): bytes(0)
   {
-    pnodedef_t nd = it->second;
-    if (nd->start >= ea && ea < nd->end)
-      return find_nodeid_loc(nd->nid);
   }
-  return NULL;
+};
+
+//--------------------------------------------------------------------------
+// Group managers may be created by several threads
+static std::atomic<uint32> next_cow_id(0);
+
+static const size_t DEFAULT_JOURNAL_LIMIT = 32 * 1024 * 1024;
+
+//--------------------------------------------------------------------------
+groupman_t::groupman_t(): 
+    arena(new gm_arena_t()), 
+    frozen(NULL), 
+    shared_nodes(NULL),
+    cow_id(++next_cow_id), 
+    addr_index_dirty(true), 
+    lazy_merges(false), 
+    merges_pending(false),
+    src_size(0),
+    lazy_similar(true),
+    similar_pending(false),
+    similar_lost(false),
+    journal_pos(0),
+    journal_bytes(0),
+    journal_limit(DEFAULT_JOURNAL_LIMIT),
+    journal_dropped(0),
+    journal_enabled(false),
+    jr_cur(NULL),
+    jr_depth(0),
+    flat_dirty(true),
+    changed_all(true)
+{
+  memset(mem_peak, 0, sizeof(mem_peak));
 }
 
 //--------------------------------------------------------------------------
-pnodedef_t groupman_t::get_first_nd()
+groupman_t::~groupman_t()
 {
-  // No super groups defined?
-  if (path_sgl.empty())
-    return NULL;
+  clear();
+  gm_arena_t::unref(arena);
+}
 
-  // Get the first super group
-  psupergroup_t first_sgroup = (*(path_sgl.begin()));
-  if (first_sgroup->gcount() == 0)
-    return NULL;
+//--------------------------------------------------------------------------
+void groupman_t::clear()
+{
+  // The recorded edits refer to the groups
+  clear_journal();
 
-  // Get groups count in the group
-  if (first_sgroup->groups.empty())
-    return NULL;
+  // The arena owns all the groups: forget about them and free them at once
+  path_sgl.clear();
+  similar_sgl.clear();
+  unfreeze();
+  unshare_nodes();
 
-  // Get first group
-  pnodegroup_t ng = *(first_sgroup->groups.begin());
-  if (ng->empty())
+  // Snapshots still use the shared arena: start a new one
+  if (arena->is_shared())
   {
-    // No nodes in the first group?
-    return NULL;
+    gm_arena_t::unref(arena);
+    arena = new gm_arena_t();
   }
   else
   {
-    // REturn the first node in the first group
-    return *(ng->begin());
+    arena->release();
   }
+
+  all_nodes.clear();
+  addr_index.clear();
+  addr_index_dirty = true;
+  merges_pending = false;
+  flat.clear();
+  flat_dirty = true;
+  changed_all = true;
+  std::vector<int>().swap(changed_nids);
+
+  extra_sections.qclear();
+  sections.clear();
+  similar_pending = false;
+  similar_lost = false;
 }
 
 //--------------------------------------------------------------------------
-bool groupman_t::parse_nodeset(
-      psupergroup_t sg,
-      char *grpstr)
+void groupman_t::clear_sgl(psupergroup_listp_t sgl)
+{
+  for (supergroup_listp_t::iterator it=sgl->begin(); 
+       it != sgl->end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+
+    // SGs shared with snapshots are left to them
+    if (sg->owner == cow_id)
+      gm_arena_t::free_sg(sg);
+  }
+  sgl->clear();
+  flat_dirty = true;
+  changed_all = true;
+}
+
+//--------------------------------------------------------------------------
+groupman_t *groupman_t::snapshot()
+{
+  // Do not hand over NGs that are half merged
+  if (merges_pending)
+    materialize_merges();
+
+  // The recorded edits refer to groups that are about to be shared
+  clear_journal();
+
+  // Hand over the lists and lookups
+  if (frozen == NULL)
+  {
+    frozen = new gm_frozen_t();
+    frozen->path_sgl.swap(path_sgl);
+    frozen->similar_sgl.swap(similar_sgl);
+    frozen->nid2loc.swap(nid2loc);
+    frozen->extra_sections.swap(extra_sections);
+  }
+
+  if (shared_nodes == NULL)
+  {
+    shared_nodes = new gm_shared_nodes_t();
+    shared_nodes->nds.swap(all_nodes);
+  }
+
+  groupman_t *gm = new groupman_t();
+  gm_arena_t::unref(gm->arena);
+  gm->arena = arena;
+  arena->add_ref();
+
+  gm->frozen = frozen;
+  ++frozen->refs;
+
+  gm->shared_nodes = shared_nodes;
+  ++shared_nodes->refs;
+
+  gm->src_filename = src_filename;
+  gm->sections = sections;
+  gm->src_size = src_size;
+  gm->lazy_similar = lazy_similar;
+  gm->similar_pending = similar_pending;
+  gm->similar_lost = similar_lost;
+  gm->lazy_merges = lazy_merges;
+  gm->journal_enabled = journal_enabled;
+  gm->journal_limit = journal_limit;
+
+  // From now on, both sides must copy the existing SGs before changing them
+  cow_id = ++next_cow_id;
+
+  return gm;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::thaw()
+{
+  gm_frozen_t *f = frozen;
+  frozen = NULL;
+
+  if (f->refs == 1)
+  {
+    // Last user: take everything over
+    path_sgl.swap(f->path_sgl);
+    similar_sgl.swap(f->similar_sgl);
+    nid2loc.swap(f->nid2loc);
+    extra_sections.swap(f->extra_sections);
+    delete f;
+  }
+  else
+  {
+    // Copy the SG pointers and the lookups. No SG, NG or node is copied
+    path_sgl = f->path_sgl;
+    similar_sgl = f->similar_sgl;
+    nid2loc = f->nid2loc;
+    extra_sections = f->extra_sections;
+    --f->refs;
+  }
+
+  // The node definitions stay shared: the address index is still valid
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::unfreeze()
+{
+  if (frozen == NULL)
+    return;
+
+  if (--frozen->refs == 0)
+    delete frozen;
+
+  frozen = NULL;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::own_nodes()
+{
+  gm_shared_nodes_t *sn = shared_nodes;
+  if (sn == NULL)
+    return;
+
+  shared_nodes = NULL;
+  if (sn->refs == 1)
+  {
+    all_nodes.swap(sn->nds);
+    delete sn;
+  }
+  else
+  {
+    // Same node definitions: the address index is still valid
+    all_nodes = sn->nds;
+    --sn->refs;
+  }
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::unshare_nodes()
+{
+  if (shared_nodes == NULL)
+    return;
+
+  if (--shared_nodes->refs == 0)
+    delete shared_nodes;
+
+  shared_nodes = NULL;
+}
+
+//--------------------------------------------------------------------------
+psupergroup_listp_t groupman_t::own_sgl(psupergroup_listp_t sgl)
+{
+  if (frozen != NULL)
+  {
+    // Translate the shared lists before they are copied in
+    if (sgl == &frozen->path_sgl)
+      sgl = &path_sgl;
+    else if (sgl == &frozen->similar_sgl)
+      sgl = &similar_sgl;
+  }
+  sync_groups();
+  return sgl;
+}
+
+//--------------------------------------------------------------------------
+psupergroup_t groupman_t::own_sg(
+    psupergroup_t sg,
+    pnodegroup_t *ng)
+{
+  if (sg->owner == cow_id)
+    return sg;
+
+  // Only thaw: merges pending on the owned NGs stay pending
+  if (frozen != NULL)
+    thaw();
+
+  psupergroup_t new_sg = gm_arena_t::alloc_sg(arena);
+  new_sg->owner = cow_id;
+  sg->copy_to(new_sg, ng);
+
+  // Replace the shared SG in its list
+  psupergroup_listp_t sgl = &path_sgl;
+  supergroup_listp_t::iterator it = std::find(sgl->begin(), sgl->end(), sg);
+  if (it == sgl->end())
+  {
+    sgl = &similar_sgl;
+    it = std::find(sgl->begin(), sgl->end(), sg);
+  }
+  if (it != sgl->end())
+    *it = new_sg;
+  flat_dirty = true;
+
+  // Nodes of the path SGs moved to the new NGs: views keyed by NG see it
+  // as a change
+  if (sgl == &path_sgl)
+  {
+    for (nodegroup_list_t::iterator it=new_sg->groups.begin();
+         it != new_sg->groups.end();
+         ++it)
+    {
+      relocate_ng(new_sg, *it);
+    }
+    note_changed(new_sg);
+  }
+
+  return new_sg;
+}
+
+//--------------------------------------------------------------------------
+nodeloc_t *groupman_t::own_loc(int nid)
+{
+  // The location is changed in place: look it up in our own table
+  sync_groups();
+  nodeloc_t *loc = nid2loc.find(nid);
+  if (loc != NULL && loc->sg->owner != cow_id)
+    own_sg(loc->sg);
+
+  // The location was updated in place
+  return loc;
+}
+
+//--------------------------------------------------------------------------
+pnodegroup_t groupman_t::own_ng(pnodegroup_t ng)
+{
+  pnodedef_t nd = ng->get_first_node();
+  if (nd == NULL)
+    return ng;
+
+  // Not synced on purpose: the NGs merged lazily are still valid
+  if (frozen != NULL)
+    thaw();
+
+  nodeloc_t *loc = nid2loc.find(nd->nid);
+  if (loc == NULL)
+    return ng;
+
+  // 'ng' may be the shared NG of an SG we already copied
+  if (loc->sg->owner != cow_id)
+    own_sg(loc->sg);
+
+  return loc->ng;
+}
+
+//--------------------------------------------------------------------------
+nodeloc_t *groupman_t::find_nodeid_loc(int nid)
+{
+  sync_reads();
+  return rd_nid2loc().find(nid);
+}
+
+//--------------------------------------------------------------------------
+ndaddr_index_t *groupman_t::get_addr_index()
+{
+  if (addr_index_dirty)
+  {
+    addr_index.build(rd_nodes());
+    addr_index_dirty = false;
+  }
+  return &addr_index;
+}
+
+//--------------------------------------------------------------------------
+nodeloc_t *groupman_t::find_node_loc(ea_t ea)
+{
+  pnodedef_t nd = get_addr_index()->find(ea);
+  return nd == NULL ? NULL : find_nodeid_loc(nd->nid);
+}
+
+//--------------------------------------------------------------------------
+size_t groupman_t::find_node_locs(
+    ea_t start,
+    ea_t end,
+    nodeloc_vec_t *out)
+{
+  nodedef_vec_t nds;
+  get_addr_index()->find_range(start, end, &nds);
+
+  size_t count = 0;
+  for (nodedef_vec_t::iterator it=nds.begin(); it != nds.end(); ++it)
+  {
+    nodeloc_t *loc = find_nodeid_loc((*it)->nid);
+    if (loc == NULL)
+      continue;
+
+    out->push_back(loc);
+    ++count;
+  }
+  return count;
+}
+
+//--------------------------------------------------------------------------
+pnodedef_t groupman_t::get_first_nd()
+{
+  sync_reads();
+  supergroup_listp_t &sgl = rd_path_sgl();
+
+  // No super groups defined?
+  if (sgl.empty())
+    return NULL;
+
+  // Get the first super group
+  psupergroup_t first_sgroup = (*(sgl.begin()));
+  if (first_sgroup->gcount() == 0)
+    return NULL;
+
+  // Get groups count in the group
+  if (first_sgroup->groups.empty())
+    return NULL;
+
+  // Get first group
+  pnodegroup_t ng = *(first_sgroup->groups.begin());
+  if (ng->empty())
+  {
+    // No nodes in the first group?
+    return NULL;
+  }
+  else
+  {
+    // REturn the first node in the first group
+    return *(ng->begin());
+  }
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::parse_nodeset(
+      psupergroup_t sg,
+      char *grpstr,
+      bool map_nodes)
 {
   // Find node group bounds
   for ( /*init*/ char *p_group_start = NULL, *p_group_end = NULL;
@@ -372,21 +1204,27 @@ bool groupman_t::parse_nodeset(
       nd->end = end;
 
       // Map this node
-      map_nodedef(nid, nd);
+      if (map_nodes)
+        map_nodedef(nid, nd);
     }
   }
   return true;
 }
 
 //--------------------------------------------------------------------------
-void groupman_t::initialize_lookups()
+void groupman_t::build_lookups(nodeloc_table_t &tbl)
 {
+  nid2ndef_t &nodes = rd_nodes();
+  supergroup_listp_t &sgl = rd_path_sgl();
+
   // Clear previous cache structures
-  nid2loc.clear();
+  tbl.reset(
+    nodes.empty() ? -1 : nodes.rbegin()->first,
+    nodes.size());
 
   // Build new cache
-  for (supergroup_listp_t::iterator it=path_sgl.begin();
-       it != path_sgl.end();
+  for (supergroup_listp_t::iterator it=sgl.begin();
+       it != sgl.end();
        ++it)
   {
     // Walk each super group
@@ -405,363 +1243,2654 @@ void groupman_t::initialize_lookups()
         nodedef_t *nd = *it;
         
         // Remember where this node is located
-        nid2loc[nd->nid] = nodeloc_t(sg, ng, nd);
+        tbl.set(nd->nid, nodeloc_t(sg, ng, nd));
       }
     }
   }
 }
 
 //--------------------------------------------------------------------------
-psupergroup_t groupman_t::add_supergroup(
-    psupergroup_listp_t sgl,
-    psupergroup_t sg)
+void groupman_t::initialize_lookups()
 {
-  if (sgl == NULL)
-    sgl = get_path_sgl();
+  sync_groups();
 
-  if (sg == NULL)
-    sg = new supergroup_t();
+  // The groups may have been changed directly: walk them once into the
+  // flat view and build the lookups from it
+  flat_dirty = true;
+  changed_all = true;
+  get_flat();
 
-  sgl->push_back(sg);
-  return sg;
-}
+  nid2ndef_t &nodes = rd_nodes();
+  nid2loc.reset(
+    nodes.empty() ? -1 : nodes.rbegin()->first,
+    nodes.size());
 
-//--------------------------------------------------------------------------
-void groupman_t::remove_supergroup(
-      psupergroup_listp_t sgl,
-      psupergroup_t sg)
-{
-  sgl->remove(sg);
+  for (size_t i=0; i < flat.sg_count(); i++)
+  {
+    psupergroup_t sg = flat.sgs[i];
+    for (uint32 j=flat.ng_begin(i); j < flat.ng_end(i); j++)
+    {
+      pnodegroup_t ng = flat.ngs[j];
+      for (uint32 k=flat.nd_begin(j); k < flat.nd_end(j); k++)
+        nid2loc.set(flat.nids[k], nodeloc_t(sg, ng, flat.nds[k]));
+    }
+  }
+
+  // The lookups are built once everything is loaded: a likely peak
+  sample_mem();
 }
 
 //--------------------------------------------------------------------------
-pnodegroup_t groupman_t::combine_ngl(pnodegroup_list_t ngl)
+bool groupman_t::verify_lookups()
 {
-  // Get the biggest group and use as the destination container
-  pnodegroup_t dest_ng = ngl->find_biggest();
+  sync_reads();
 
-  if (dest_ng == NULL)
-    return NULL;
+  nodeloc_table_t tbl;
+  build_lookups(tbl);
 
-  for (nodegroup_list_t::iterator it = ngl->begin();
-       it != ngl->end(); 
+  nodeloc_table_t &cur = rd_nid2loc();
+  if (tbl.size() != cur.size())
+    return false;
+
+  nid2ndef_t &nodes = rd_nodes();
+  for (nid2ndef_t::iterator it=nodes.begin();
+       it != nodes.end();
        ++it)
   {
-    pnodegroup_t ng = *it;
-
-    // Skip the dest NG
-    if (ng == dest_ng)
+    nodeloc_t *expected = tbl.find(it->first);
+    nodeloc_t *loc = cur.find(it->first);
+    if (expected == NULL && loc == NULL)
       continue;
 
-    // Get the first node from the other NG
-    pnodedef_t nd = ng->get_first_node();
-
-    // Node group is empty?
-    if (nd == NULL)
-      continue;
-
-    // Get the supergroup containing this node group
-    nodeloc_t *loc = find_nodeid_loc(nd->nid);
-
-    // Move all node definitions to the first node group
-    for (nodegroup_t::iterator it = ng->begin();
-         it != ng->end();
-         ++it)
-    {
-      pnodedef_t nd = *it;
-      dest_ng->add_node(nd);
-    }
-
-    // Clear the items in the node group
-    ng->clear();
-
-    // Remove this node group from the super group
-    loc->sg->remove_nodegroup(ng, false);
-    if (loc->sg->empty())
+    if (   expected == NULL 
+        || loc == NULL
+        || expected->sg != loc->sg
+        || expected->ng != loc->ng
+        || expected->nd != loc->nd)
     {
-      remove_supergroup(
-        get_path_sgl(),
-        loc->sg);
+      return false;
     }
   }
-
-  // Reinitialize lookups
-  initialize_lookups();
-
-  return dest_ng;
+  return true;
 }
 
 //--------------------------------------------------------------------------
-pnodegroup_t groupman_t::move_nodes_to_ng(pnodegroup_t ng)
+const gm_flat_t *groupman_t::get_flat()
 {
-  // Algo:
-  // ------
-  // Make a new NG
-  // Get the SG of the first selected node
-  // Remove each node from its NG
-  // Remove the NG from the SG if it becomes empty
-  // Remove SG if it becomes empty
-  // Add the ND to the new NG
-  // Add the new NG to the SG
-
-  psupergroup_t sg0 = NULL;
-  pnodegroup_t  new_ng = NULL;
-  for (nodegroup_t::iterator it=ng->begin();
-       it != ng->end();
-       ++it)
+  sync_reads();
+  if (flat_dirty)
   {
-    nodeloc_t *loc = find_nodeid_loc((*it)->nid);
+    flat.build(&rd_path_sgl(), rd_nodes().size());
+    flat_dirty = false;
+  }
+  return &flat;
+}
 
-    // Get the first SG
-    if (sg0 == NULL)
+//--------------------------------------------------------------------------
+bool groupman_t::verify_flat()
+{
+  // A view that missed a change is not rebuilt
+  get_flat();
+
+  supergroup_listp_t &sgl = rd_path_sgl();
+  size_t i = 0, j = 0, k = 0;
+  for (supergroup_listp_t::iterator it=sgl.begin();
+       it != sgl.end();
+       ++it, ++i)
+  {
+    psupergroup_t sg = *it;
+    if (   i >= flat.sg_count()
+        || flat.sgs[i] != sg
+        || flat.ng_begin(i) != j
+        || flat.ng_end(i) - j != sg->groups.size())
     {
-      sg0 = loc->sg;
-      // Make a new NG (once) and add it to the SG
-      new_ng = sg0->add_nodegroup();
+      return false;
     }
 
-    // Remove the node from its NG
-    loc->ng->remove(loc->nd);
-
-    // Empty NG? remove it
-    if (loc->ng->empty())
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it, ++j)
     {
-      loc->sg->remove_nodegroup(loc->ng, true);
-      if (loc->sg->empty())
-        path_sgl.remove_sg(loc->sg, true);
-    }
+      pnodegroup_t ng = *it;
+      if (   flat.ngs[j] != ng
+          || flat.nd_begin(j) != k
+          || flat.nd_end(j) - k != ng->size())
+      {
+        return false;
+      }
 
-    // Add the node to the new NG
-    new_ng->add_node(loc->nd);
+      for (nodegroup_t::iterator it=ng->begin(); it != ng->end(); ++it, ++k)
+      {
+        pnodedef_t nd = *it;
+        if (   flat.nds[k] != nd
+            || flat.nids[k] != nd->nid
+            || flat.starts[k] != nd->start
+            || flat.ends[k] != nd->end)
+        {
+          return false;
+        }
+      }
+    }
   }
-  // Reinitialize lookups
-  initialize_lookups();
-
-  return new_ng;
+  return i == flat.sg_count() && j == flat.ng_count() && k == flat.nd_count();
 }
 
 //--------------------------------------------------------------------------
-void groupman_t::emit_sgl(
-    FILE *fp,
-    psupergroup_listp_t sgl)
+void groupman_t::move_stats(
+    psupergroup_t from_sg,
+    pnodegroup_t from_ng,
+    psupergroup_t to_sg,
+    pnodegroup_t to_ng,
+    const gm_stats_t &st)
 {
-  for (supergroup_listp_t::iterator it=sgl->begin();
-       it != sgl->end();
-       ++it)
+  // Moving a whole NG leaves its own stats unchanged
+  if (from_ng != to_ng)
   {
-    psupergroup_t sg = *it;
+    from_ng->stats_sub(st);
+    to_ng->stats_add(st);
+  }
 
-    // Write ID
-    if (!sg->id.empty())
-      qfprintf(fp, "%s:%s;", STR_ID, sg->id.c_str());
+  if (from_sg != NULL)
+    from_sg->stats_sub(from_ng, st);
+  if (to_sg != NULL)
+    to_sg->stats_add(to_ng, st);
+}
 
-    // Write Name
-    if (!sg->name.empty())
-      qfprintf(fp, "%s:%s;", STR_GROUP_NAME, sg->name.c_str());
+//--------------------------------------------------------------------------
+bool groupman_t::verify_stats()
+{
+  sync_reads();
 
-    size_t group_count = sg->groups.size();
-    if (group_count > 0)
+  supergroup_listp_t &sgl = rd_path_sgl();
+  for (supergroup_listp_t::iterator it=sgl.begin();
+       it != sgl.end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+    gm_stats_t sg_st;
+    size_t biggest_count = 0;
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
     {
-      qfprintf(fp, "%s:", STR_NODESET);
-      nodegroup_list_t &ngl = sg->groups;
-      for (nodegroup_list_t::iterator it = ngl.begin(); 
-           it != ngl.end(); 
-           ++it)
+      pnodegroup_t ng = *it;
+      gm_stats_t st;
+      for (nodegroup_t::iterator it=ng->begin(); it != ng->end(); ++it)
+        st.add(*it);
+
+      const gm_stats_t &cached = ng->get_stats();
+      if (   cached.node_count != st.node_count
+          || cached.bytes != st.bytes
+          || cached.min_ea != st.min_ea
+          || cached.max_ea != st.max_ea)
       {
-        pnodegroup_t ng = *it;
+        return false;
+      }
+      sg_st.add(st);
+      biggest_count = qmax(biggest_count, st.node_count);
+    }
 
-        qfprintf(fp, "(");
+    const gm_stats_t &cached = sg->get_stats();
+    pnodegroup_t biggest = sg->get_biggest_ng();
+    if (   cached.node_count != sg_st.node_count
+        || cached.bytes != sg_st.bytes
+        || cached.min_ea != sg_st.min_ea
+        || cached.max_ea != sg_st.max_ea
+        || (biggest == NULL) != sg->groups.empty()
+        || (biggest != NULL && biggest->stats.node_count != biggest_count))
+    {
+      return false;
+    }
+  }
+  return true;
+}
 
-        size_t c = ng->size();
-        for (nodegroup_t::iterator it = ng->begin();
-             it != ng->end();
-             ++it)
-        {
-          nodedef_t *nd = *it;
-          qfprintf(fp, "%d : %a : %a", nd->nid, nd->start, nd->end);
-          if (--c != 0)
-            qfprintf(fp, ", ");
-        }
-        qfprintf(fp, ")");
-        if (--group_count != 0)
-          qfprintf(fp, ", ");
+//--------------------------------------------------------------------------
+void groupman_t::settle()
+{
+  load_similar();
+  sync_reads();
+  get_addr_index();
+  get_flat();
+
+  psupergroup_listp_t sgls[] = {&rd_path_sgl(), &rd_similar_sgl()};
+  for (size_t i=0; i < qnumber(sgls); i++)
+  {
+    for (supergroup_listp_t::iterator it=sgls[i]->begin();
+         it != sgls[i]->end();
+         ++it)
+    {
+      psupergroup_t sg = *it;
+      sg->get_stats();
+      for (nodegroup_list_t::iterator it=sg->groups.begin();
+           it != sg->groups.end();
+           ++it)
+      {
+        (*it)->get_stats();
       }
     }
-    qfprintf(fp, "\n");
   }
 }
 
 //--------------------------------------------------------------------------
-bool groupman_t::emit(
-        const char *filename, 
-        const char *additional_sections)
+void gm_mem_stats_t::clear()
 {
-  FILE *fp = qfopen(filename, "w");
-  if (fp == NULL)
-    return false;
+  memset(bytes, 0, sizeof(bytes));
+  memset(peak, 0, sizeof(peak));
+  total = peak_total = 0;
+  sg_count = ng_count = nd_count = 0;
+  shared = false;
+}
 
-  qfprintf(fp, "--%s\n", STR_PATHINFO);
-  emit_sgl(fp, &path_sgl);
+//--------------------------------------------------------------------------
+const char *gm_mem_stats_t::get_category_name(gm_mem_category_e cat)
+{
+  static const char *const names[] =
+  {
+    "SG objects",
+    "NG objects",
+    "ND objects",
+    "list nodes",
+    "nid2loc",
+    "all_nodes",
+    "address index",
+    "names",
+    "journal",
+    "other",
+    "flat view",
+  };
+  return cat < qnumber(names) ? names[cat] : "?";
+}
 
-  qfprintf(fp, "--%s\n", STR_SIMILARINFO);
-  emit_sgl(fp, &similar_sgl);
+//--------------------------------------------------------------------------
+void groupman_t::measure_mem(gm_mem_stats_t *st)
+{
+  st->clear();
 
-  // Emit additional sections
-  if (additional_sections != NULL)
-    qfprintf(fp, "%s\n", additional_sections);
+  // Measure the lists and lookups where they are: thawing would copy them
+  psupergroup_listp_t sgls[] = {&rd_path_sgl(), &rd_similar_sgl()};
+  for (size_t i=0; i < qnumber(sgls); i++)
+  {
+    for (supergroup_listp_t::iterator it=sgls[i]->begin();
+         it != sgls[i]->end();
+         ++it)
+    {
+      psupergroup_t sg = *it;
+      st->bytes[gm_mem_list_nodes] += LIST_NODE_SIZE(psupergroup_t)
+                                    + sg->groups.size() * LIST_NODE_SIZE(pnodegroup_t);
+      st->bytes[gm_mem_names] += sg->id.capacity() + sg->name.capacity();
 
-  qfclose(fp);
+      for (nodegroup_list_t::iterator it=sg->groups.begin();
+           it != sg->groups.end();
+           ++it)
+      {
+        st->bytes[gm_mem_list_nodes] += (*it)->size() * LIST_NODE_SIZE(pnodedef_t);
+      }
+    }
+  }
 
-  return true;
+  st->bytes[gm_mem_all_nodes] = rd_nodes().size() * MAP_NODE_SIZE(int, pnodedef_t);
+  st->bytes[gm_mem_nid2loc] = rd_nid2loc().mem_bytes();
+  st->bytes[gm_mem_addr_index] = addr_index.mem_bytes();
+  st->bytes[gm_mem_flat] = flat.mem_bytes();
+  st->bytes[gm_mem_journal] = journal_bytes + journal.capacity() * sizeof(gm_jentry_t *);
+
+  size_t other = src_filename.capacity()
+               + changed_nids.capacity() * sizeof(int)
+               + rd_extra_sections().capacity()
+               + sections.capacity() * sizeof(gm_section_t);
+  for (gm_sections_t::iterator it=sections.begin(); it != sections.end(); ++it)
+    other += it->name.capacity();
+  st->bytes[gm_mem_other] = other;
+
+  const gm_pool_stats_t *pools[] =
+  {
+    &arena->get_sg_stats(),
+    &arena->get_ng_stats(),
+    &arena->get_nd_stats(),
+  };
+  for (size_t i=0; i < qnumber(pools); i++)
+  {
+    st->bytes[gm_mem_sg_objects + i] = pools[i]->bytes;
+    st->peak[gm_mem_sg_objects + i] = pools[i]->peak_bytes;
+  }
+  st->sg_count = pools[0]->live;
+  st->ng_count = pools[1]->live;
+  st->nd_count = pools[2]->live;
+  st->shared = arena->is_shared();
 }
 
 //--------------------------------------------------------------------------
-bool groupman_t::parse_line(
+void groupman_t::sample_mem()
+{
+  gm_mem_stats_t st;
+  measure_mem(&st);
+  for (int i=0; i < gm_mem_count; i++)
+    mem_peak[i] = qmax(mem_peak[i], st.bytes[i]);
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::get_mem_stats(gm_mem_stats_t *st)
+{
+  measure_mem(st);
+  for (int i=0; i < gm_mem_count; i++)
+  {
+    // The pools know their own peaks
+    if (i > gm_mem_nd_objects)
+    {
+      mem_peak[i] = qmax(mem_peak[i], st->bytes[i]);
+      st->peak[i] = mem_peak[i];
+    }
+    st->total += st->bytes[i];
+    st->peak_total += st->peak[i];
+  }
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::relocate_ng(
     psupergroup_t sg,
-    char *line)
+    pnodegroup_t ng)
 {
-  for (char *saved_ptr, *token = qstrtok(line, ";", &saved_ptr); 
-       token != NULL;
-       token = qstrtok(NULL, ";", &saved_ptr))
+  for (nodegroup_t::iterator it=ng->begin(); it != ng->end(); ++it)
   {
-    char *val = strchr(token, ':');
-    if (val == NULL)
-      continue;
+    pnodedef_t nd = *it;
+    nid2loc.set(nd->nid, nodeloc_t(sg, ng, nd));
+  }
+}
 
-    // Kill separator and adjust value pointer
-    *val++ = '\0';
-    val = skip_spaces(val);
+//--------------------------------------------------------------------------
+void groupman_t::map_nodedefs(const nodedef_vec_t &nds)
+{
+  own_nodes();
 
-    // Set key pointer
-    char *key = skip_spaces(token);
+  // Walk the map along the sorted nodes so each insertion is hinted
+  nid2ndef_t::iterator hint = all_nodes.begin();
+  for (nodedef_vec_t::const_iterator it=nds.begin(); it != nds.end(); ++it)
+  {
+    pnodedef_t nd = *it;
+    while (hint != all_nodes.end() && hint->first < nd->nid)
+      ++hint;
 
-    if (stricmp(key, STR_ID) == 0)
-    {
-      sg->id = val;  
-    }
-    else if (stricmp(key, STR_GROUP_NAME) == 0)
-    {
-      sg->name = val;
-    }
-    else if (stricmp(key, STR_NODESET) == 0)
-    {
-      if (!parse_nodeset(sg, val))
-        return false;
-    }
+    if (hint != all_nodes.end() && hint->first == nd->nid)
+      hint->second = nd;
+    else
+      hint = all_nodes.insert(hint, nid2ndef_t::value_type(nd->nid, nd));
   }
-  return true;
+  addr_index_dirty = true;
 }
 
 //--------------------------------------------------------------------------
-bool groupman_t::parse(
-    const char *filename, 
-    bool init_cache)
+psupergroup_t groupman_t::add_supergroup(
+    psupergroup_listp_t sgl,
+    psupergroup_t sg)
 {
-  std::ifstream in_file(filename);
-  if (!in_file.is_open())
-    return false;
+  sgl = own_sgl(sgl == NULL ? &path_sgl : sgl);
 
-  // Remember the opened file name
-  this->src_filename = filename;
+  if (sg == NULL)
+  {
+    sg = gm_arena_t::alloc_sg(arena);
+    sg->owner = cow_id;
+  }
 
-  // Clear previous items
-  clear();
+  sgl->push_back(sg);
+  flat_dirty = true;
+  changed_all = true;
+  return sg;
+}
 
-  std::string line;
+//--------------------------------------------------------------------------
+void groupman_t::remove_supergroup(
+      psupergroup_listp_t sgl,
+      psupergroup_t sg)
+{
+  sgl = own_sgl(sgl);
+  sgl->remove(sg);
+  flat_dirty = true;
+  changed_all = true;
+}
 
-  //TODO: generate dummy group names ; int group_dummy_name;
-  psupergroup_listp_t cur_sgl = &path_sgl;
+//--------------------------------------------------------------------------
+pnodegroup_t groupman_t::combine_ngl(pnodegroup_list_t ngl)
+{
+  // Journaled merges are done right away
+  if (lazy_merges && !journal_enabled)
+    return combine_ngl_lazy(ngl);
 
-  while (in_file.good())
+  // Get the biggest group and use as the destination container
+  pnodegroup_t dest_ng = ngl->find_biggest();
+
+  if (dest_ng == NULL)
+    return NULL;
+
+  // Get the supergroup of the destination NG
+  pnodedef_t dest_nd = dest_ng->get_first_node();
+  nodeloc_t *dest_loc = dest_nd == NULL ? NULL : own_loc(dest_nd->nid);
+  if (dest_loc == NULL)
+    return NULL;
+
+  // The NGs of the list may be shared with a snapshot: work on our copies
+  pnodegroup_t listed_dest_ng = dest_ng;
+  dest_ng = dest_loc->ng;
+  psupergroup_t dest_sg = dest_loc->sg;
+
+  begin_edit("Combine groups");
+
+  for (nodegroup_list_t::iterator it = ngl->begin();
+       it != ngl->end(); 
+       ++it)
   {
-    // Read the line
-    std::getline(in_file, line);
+    pnodegroup_t ng = *it;
 
-    // Skip comment or empty lines
-    char *s = skip_spaces((char *)line.c_str());
-    if (s[0] == '\0' || s[0] == '#')
+    // Skip the dest NG
+    if (ng == listed_dest_ng)
       continue;
 
-    // Section switch?
-    if (s[0] == '-' && s[1] == '-' && s[2] != '\0')
-    {
-      s += 2;
-      if (qstrcmp(s, STR_PATHINFO) == 0)
-        cur_sgl = &path_sgl;
-      else if (qstrcmp(s, STR_SIMILARINFO) == 0)
-        cur_sgl = &similar_sgl;
-      else
-        cur_sgl = NULL;
+    // Get the first node from the other NG
+    pnodedef_t nd = ng->get_first_node();
 
-      // Skip this line after section switch
+    // Node group is empty?
+    if (nd == NULL)
       continue;
-    }
 
-    // Skip lines when no known SGL section is being parsed
-    if (cur_sgl == NULL)
+    // Get the supergroup containing this node group
+    nodeloc_t *loc = own_loc(nd->nid);
+    if (loc == NULL)
       continue;
 
-    // Take a copy of the line so we tokenize it
-    s = qstrdup(s);
+    psupergroup_t sg = loc->sg;
+    ng = loc->ng;
 
-    // Create a new super group definition per line
-    psupergroup_t sg = add_supergroup(cur_sgl);
+    // Listed twice?
+    if (ng == dest_ng)
+      continue;
 
-    parse_line(sg, s);
+    // Move all node definitions to the first node group
+    jr_move_nodes(sg, ng, ng->begin(), ng->end(), dest_sg, dest_ng);
 
-    // Free this line
-    qfree(s);
+    // Remove this node group from the super group
+    jr_remove_ng(sg, std::find(sg->groups.begin(), sg->groups.end(), ng));
+    if (sg->empty())
+      jr_remove_sg(std::find(path_sgl.begin(), path_sgl.end(), sg));
   }
-  in_file.close();
 
-  // Initialize cache
-  if (init_cache)
-    initialize_lookups();
+  end_edit();
 
-  return true;
+  VERIFY_LOOKUPS();
+
+  return dest_ng;
 }
 
 //--------------------------------------------------------------------------
-void groupman_t::reset_groupping()
+pnodegroup_t groupman_t::uf_find(pnodegroup_t ng)
 {
-  // ALGO
-  // -------
-  // TODO: The clear() and destructor is confusing and complicated. Simplify
-  //
-  // Go from SGL to SG to NGL to NG and clear references to node definitions
-  psupergroup_listp_t sgl = &path_sgl;
-  for (supergroup_listp_t::iterator it=sgl->begin(); 
-       it != sgl->end();
-       ++it)
+  // Path halving
+  while (ng->uf_parent != NULL)
   {
-    psupergroup_t sg = *it;
+    if (ng->uf_parent->uf_parent != NULL)
+      ng->uf_parent = ng->uf_parent->uf_parent;
+    ng = ng->uf_parent;
+  }
+  return ng;
+}
 
-    for (nodegroup_list_t::iterator it=sg->groups.begin();
-         it != sg->groups.end();
-         ++it)
+//--------------------------------------------------------------------------
+void groupman_t::uf_union(pnodegroup_t dest, pnodegroup_t src)
+{
+  src->uf_parent = dest;
+
+  // Append 'src' and the NGs it absorbed to the chain of 'dest'
+  if (dest->uf_tail == NULL)
+    dest->uf_next = src;
+  else
+    dest->uf_tail->uf_next = src;
+
+  dest->uf_tail = src->uf_tail == NULL ? src : src->uf_tail;
+  dest->uf_absorbed += src->size() + src->uf_absorbed;
+
+  src->uf_tail = NULL;
+  src->uf_absorbed = 0;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::set_lazy_merges(bool lazy)
+{
+  if (!lazy)
+    sync_groups();
+
+  lazy_merges = lazy;
+}
+
+//--------------------------------------------------------------------------
+pnodegroup_t groupman_t::combine_ngl_lazy(pnodegroup_list_t ngl)
+{
+  // Get the biggest group (counting what it absorbed already) as the destination
+  pnodegroup_t dest_ng = NULL;
+  size_t dest_size = 0;
+  for (nodegroup_list_t::iterator it = ngl->begin();
+       it != ngl->end(); 
+       ++it)
+  {
+    pnodegroup_t ng = uf_find(own_ng(*it));
+    size_t sz = ng->size() + ng->uf_absorbed;
+    if (dest_ng == NULL || dest_size < sz)
     {
-      pnodegroup_t ng = *it;
-      // Clear the node definitions -> no more ND references
-      ng->clear();
+      dest_ng = ng;
+      dest_size = sz;
+    }
+  }
+
+  if (dest_ng == NULL || dest_size == 0)
+    return dest_ng;
+
+  for (nodegroup_list_t::iterator it = ngl->begin();
+       it != ngl->end(); 
+       ++it)
+  {
+    pnodegroup_t ng = uf_find(own_ng(*it));
+
+    // Skip the dest NG and the empty NGs
+    if (ng == dest_ng || ng->size() + ng->uf_absorbed == 0)
+      continue;
+
+    uf_union(dest_ng, ng);
+    merges_pending = true;
+  }
+
+  return dest_ng;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::materialize_merges()
+{
+  merges_pending = false;
+  flat_dirty = true;
+  changed_all = true;
+
+  // Move the nodes of the merged NGs to their root, in merge order
+  for (supergroup_listp_t::iterator it=path_sgl.begin();
+       it != path_sgl.end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
+    {
+      pnodegroup_t ng = *it;
+      if (ng->uf_parent != NULL || ng->uf_next == NULL)
+        continue;
+
+      for (pnodegroup_t src = ng->uf_next; src != NULL; src = src->uf_next)
+      {
+        for (nodegroup_t::iterator it=src->begin(); it != src->end(); ++it)
+        {
+          pnodedef_t nd = *it;
+          nid2loc.set(nd->nid, nodeloc_t(sg, ng, nd));
+        }
+
+        const gm_stats_t &st = src->get_stats();
+        ng->stats_add(st);
+        sg->stats_add(ng, st);
+        ng->splice(ng->end(), *src);
+      }
+
+      ng->uf_next = ng->uf_tail = NULL;
+      ng->uf_absorbed = 0;
+    }
+  }
+
+  // Drop the merged NGs then the SGs left empty
+  for (supergroup_listp_t::iterator it=path_sgl.begin();
+       it != path_sgl.end();
+       /* incr in loop */)
+  {
+    psupergroup_t sg = *it;
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         /* incr in loop */)
+    {
+      pnodegroup_t ng = *it;
+      if (ng->uf_parent == NULL)
+      {
+        ++it;
+        continue;
+      }
+      it = sg->groups.erase(it);
+      gm_arena_t::free_ng(ng);
+      sg->invalidate_stats();
+    }
+
+    if (sg->empty())
+    {
+      it = path_sgl.erase(it);
+      gm_arena_t::free_sg(sg);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  VERIFY_LOOKUPS();
+}
+
+//--------------------------------------------------------------------------
+// A node and its position in its NG
+typedef std::pair<pnodedef_t, nodegroup_t::iterator> nd_pos_t;
+typedef std::vector<nd_pos_t> nd_pos_vec_t;
+
+static bool nd_pos_less(const nd_pos_t &a, const nd_pos_t &b)
+{
+  return a.first < b.first;
+}
+
+//--------------------------------------------------------------------------
+pnodegroup_t groupman_t::move_nodes_to_ng(pnodegroup_t ng)
+{
+  // Algo:
+  // ------
+  // Make a new NG
+  // Get the SG of the first selected node
+  // Find where each selected ND is in its previous NG in a single pass
+  // Move each ND to the new NG and point its location to it
+  // Remove the NGs that became empty from their SG
+  // Remove SG if it becomes empty
+
+  sync_groups();
+
+  // The selected nodes and the NGs and SGs they come from, resolved before
+  // editing. The nodes that are not in this grouping are skipped
+  psupergroup_t sg0 = NULL;
+  nodedef_vec_t sel_nds;
+  std::vector<pnodegroup_t> src_ngs;
+  std::vector<psupergroup_t> src_sgs;
+  for (nodegroup_t::iterator it=ng->begin();
+       it != ng->end();
+       ++it)
+  {
+    nodeloc_t *loc = own_loc((*it)->nid);
+    if (loc == NULL)
+      continue;
+
+    // Get the first SG
+    if (sg0 == NULL)
+      sg0 = loc->sg;
+
+    sel_nds.push_back(loc->nd);
+    src_ngs.push_back(loc->ng);
+    src_sgs.push_back(loc->sg);
+  }
+
+  if (sg0 == NULL)
+    return NULL;
+
+  begin_edit("Move nodes");
+
+  // Make a new NG and add it to the first SG
+  pnodegroup_t new_ng = jr_add_ng(sg0);
+
+  std::sort(sel_nds.begin(), sel_nds.end());
+  std::sort(src_ngs.begin(), src_ngs.end());
+  src_ngs.erase(std::unique(src_ngs.begin(), src_ngs.end()), src_ngs.end());
+
+  // Find the position of the selected nodes in their NG
+  nd_pos_vec_t nd_pos;
+  for (std::vector<pnodegroup_t>::iterator it=src_ngs.begin();
+       it != src_ngs.end();
+       ++it)
+  {
+    pnodegroup_t src_ng = *it;
+    for (nodegroup_t::iterator it=src_ng->begin(); it != src_ng->end(); ++it)
+    {
+      if (std::binary_search(sel_nds.begin(), sel_nds.end(), *it))
+        nd_pos.push_back(nd_pos_t(*it, it));
+    }
+  }
+  std::sort(nd_pos.begin(), nd_pos.end(), nd_pos_less);
+
+  // Move the nodes in the selection order
+  for (nodegroup_t::iterator it=ng->begin();
+       it != ng->end();
+       ++it)
+  {
+    nodeloc_t *loc = nid2loc.find((*it)->nid);
+
+    // Node not in this grouping or listed twice?
+    if (loc == NULL || loc->ng == new_ng)
+      continue;
+
+    nodegroup_t::iterator pos = std::lower_bound(
+      nd_pos.begin(), 
+      nd_pos.end(), 
+      nd_pos_t(loc->nd, nodegroup_t::iterator()), 
+      nd_pos_less)->second;
+
+    nodegroup_t::iterator next = pos;
+    jr_move_nodes(loc->sg, loc->ng, pos, ++next, sg0, new_ng);
+  }
+
+  std::sort(src_sgs.begin(), src_sgs.end());
+  src_sgs.erase(std::unique(src_sgs.begin(), src_sgs.end()), src_sgs.end());
+
+  // Remove the emptied NGs from their SGs, then the emptied SGs
+  bool sg_emptied = false;
+  for (std::vector<psupergroup_t>::iterator it=src_sgs.begin();
+       it != src_sgs.end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+    for (nodegroup_list_t::iterator it=sg->groups.begin(); it != sg->groups.end(); /* incr in loop */)
+    {
+      pnodegroup_t ng = *it;
+      if (ng->empty() && std::binary_search(src_ngs.begin(), src_ngs.end(), ng))
+        it = jr_remove_ng(sg, it);
+      else
+        ++it;
+    }
+    sg_emptied = sg_emptied || sg->empty();
+  }
+
+  if (sg_emptied)
+  {
+    for (supergroup_listp_t::iterator it=path_sgl.begin(); it != path_sgl.end(); /* incr in loop */)
+    {
+      psupergroup_t sg = *it;
+      if (sg->empty() && std::binary_search(src_sgs.begin(), src_sgs.end(), sg))
+        it = jr_remove_sg(it);
+      else
+        ++it;
+    }
+  }
+
+  end_edit();
+
+  VERIFY_LOOKUPS();
+
+  return new_ng;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::emit_sgl(
+    FILE *fp,
+    psupergroup_listp_t sgl)
+{
+  for (supergroup_listp_t::iterator it=sgl->begin();
+       it != sgl->end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+
+    // Write ID
+    if (!sg->id.empty())
+      qfprintf(fp, "%s:%s;", STR_ID, sg->id.c_str());
+
+    // Write Name
+    if (!sg->name.empty())
+      qfprintf(fp, "%s:%s;", STR_GROUP_NAME, sg->name.c_str());
+
+    size_t group_count = sg->groups.size();
+    if (group_count > 0)
+    {
+      qfprintf(fp, "%s:", STR_NODESET);
+      nodegroup_list_t &ngl = sg->groups;
+      for (nodegroup_list_t::iterator it = ngl.begin(); 
+           it != ngl.end(); 
+           ++it)
+      {
+        pnodegroup_t ng = *it;
+
+        qfprintf(fp, "(");
+
+        size_t c = ng->size();
+        for (nodegroup_t::iterator it = ng->begin();
+             it != ng->end();
+             ++it)
+        {
+          nodedef_t *nd = *it;
+          qfprintf(fp, "%d : %a : %a", nd->nid, nd->start, nd->end);
+          if (--c != 0)
+            qfprintf(fp, ", ");
+        }
+        qfprintf(fp, ")");
+        if (--group_count != 0)
+          qfprintf(fp, ", ");
+      }
+    }
+    qfprintf(fp, "\n");
+  }
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::emit_stdio(
+        const char *filename, 
+        const char *additional_sections)
+{
+  if (!load_similar())
+    return false;
+
+  sync_reads();
+
+  FILE *fp = qfopen(filename, "w");
+  if (fp == NULL)
+    return false;
+
+  qfprintf(fp, "--%s\n", STR_PATHINFO);
+  emit_sgl(fp, &rd_path_sgl());
+
+  qfprintf(fp, "--%s\n", STR_SIMILARINFO);
+  emit_sgl(fp, &rd_similar_sgl());
+
+  // Emit the sections we did not understand while parsing
+  qstring &extra = rd_extra_sections();
+  if (!extra.empty())
+    qfprintf(fp, "%s", extra.c_str());
+
+  // Emit additional sections
+  if (additional_sections != NULL)
+    qfprintf(fp, "%s\n", additional_sections);
+
+  qfclose(fp);
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::emit_sgl(
+    bufwriter_t *w,
+    psupergroup_listp_t sgl)
+{
+  gm_flat_t view;
+  view.build(sgl);
+  emit_sgl(w, view);
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::emit_sgl(
+    bufwriter_t *w,
+    const gm_flat_t &view)
+{
+  for (size_t i=0; i < view.sg_count(); i++)
+  {
+    psupergroup_t sg = view.sgs[i];
+
+    // Write ID
+    if (!sg->id.empty())
+    {
+      w->put(STR_ID);
+      w->put(':');
+      w->put(sg->id.c_str());
+      w->put(';');
+    }
+
+    // Write Name
+    if (!sg->name.empty())
+    {
+      w->put(STR_GROUP_NAME);
+      w->put(':');
+      w->put(sg->name.c_str());
+      w->put(';');
+    }
+
+    uint32 ng_end = view.ng_end(i);
+    if (view.ng_begin(i) != ng_end)
+    {
+      w->put(STR_NODESET);
+      w->put(':');
+      for (uint32 j=view.ng_begin(i); j < ng_end; j++)
+      {
+        w->put('(');
+
+        uint32 nd_end = view.nd_end(j);
+        for (uint32 k=view.nd_begin(j); k < nd_end; k++)
+        {
+          w->put_dec(view.nids[k]);
+          w->write(" : ", 3);
+          w->put_hex(view.starts[k]);
+          w->write(" : ", 3);
+          w->put_hex(view.ends[k]);
+          if (k + 1 != nd_end)
+            w->write(", ", 2);
+        }
+        w->put(')');
+        if (j + 1 != ng_end)
+          w->write(", ", 2);
+      }
+    }
+    w->put('\n');
+  }
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::emit(
+        const char *filename, 
+        const char *additional_sections,
+        bool atomic)
+{
+  if (!load_similar())
+    return false;
+
+  sync_reads();
+
+  if (is_bin_filename(filename))
+    return emit_bin(filename, additional_sections, atomic);
+
+  bufwriter_t w;
+  if (!w.open(filename, true, atomic))
+    return false;
+
+  w.write("--", 2);
+  w.put(STR_PATHINFO);
+  w.put('\n');
+  emit_sgl(&w, *get_flat());
+
+  w.write("--", 2);
+  w.put(STR_SIMILARINFO);
+  w.put('\n');
+  emit_sgl(&w, &rd_similar_sgl());
+
+  // Emit the sections we did not understand while parsing
+  qstring &extra = rd_extra_sections();
+  w.write(extra.c_str(), extra.length());
+
+  // Emit additional sections
+  if (additional_sections != NULL)
+  {
+    w.put(additional_sections);
+    w.put('\n');
+  }
+
+  return w.close();
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::parse_line(
+    psupergroup_t sg,
+    char *line,
+    bool map_nodes)
+{
+  for (char *saved_ptr, *token = qstrtok(line, ";", &saved_ptr); 
+       token != NULL;
+       token = qstrtok(NULL, ";", &saved_ptr))
+  {
+    char *val = strchr(token, ':');
+    if (val == NULL)
+      continue;
+
+    // Kill separator and adjust value pointer
+    *val++ = '\0';
+    val = skip_spaces(val);
+
+    // Set key pointer
+    char *key = skip_spaces(token);
+
+    if (stricmp(key, STR_ID) == 0)
+    {
+      sg->id = val;  
+    }
+    else if (stricmp(key, STR_GROUP_NAME) == 0)
+    {
+      sg->name = val;
+    }
+    else if (stricmp(key, STR_NODESET) == 0)
+    {
+      if (!parse_nodeset(sg, val, map_nodes))
+        return false;
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::parse_getline(
+    const char *filename, 
+    bool init_cache)
+{
+  std::ifstream in_file(filename);
+  if (!in_file.is_open())
+    return false;
+
+  // Remember the opened file name
+  this->src_filename = filename;
+
+  // Clear previous items
+  clear();
+
+  std::string line;
+
+  //TODO: generate dummy group names ; int group_dummy_name;
+  psupergroup_listp_t cur_sgl = &path_sgl;
+
+  while (in_file.good())
+  {
+    // Read the line
+    std::getline(in_file, line);
+
+    // Skip comment or empty lines
+    char *s = skip_spaces((char *)line.c_str());
+    if (s[0] == '\0' || s[0] == '#')
+      continue;
+
+    // Section switch?
+    if (s[0] == '-' && s[1] == '-' && s[2] != '\0')
+    {
+      if (qstrcmp(s + 2, STR_PATHINFO) == 0)
+        cur_sgl = &path_sgl;
+      else if (qstrcmp(s + 2, STR_SIMILARINFO) == 0)
+        cur_sgl = &similar_sgl;
+      else
+        cur_sgl = NULL;
+
+      // Keep unknown sections around
+      if (cur_sgl == NULL)
+      {
+        extra_sections.append(s);
+        extra_sections.append('\n');
+      }
+
+      // Skip this line after section switch
+      continue;
+    }
+
+    // Skip lines when no known SGL section is being parsed
+    if (cur_sgl == NULL)
+    {
+      extra_sections.append(s);
+      extra_sections.append('\n');
+      continue;
+    }
+
+    // Take a copy of the line so we tokenize it
+    s = qstrdup(s);
+
+    // Create a new super group definition per line
+    psupergroup_t sg = add_supergroup(cur_sgl);
+
+    parse_line(sg, s, cur_sgl == &path_sgl);
+
+    // Free this line
+    qfree(s);
+  }
+  in_file.close();
+
+  // Initialize cache
+  if (init_cache)
+    initialize_lookups();
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+//--  BINARY FORMAT  -------------------------------------------------------
+//--------------------------------------------------------------------------
+// The tables are written as raw structs, in the byte order of the host that
+// wrote the file. The magic doubles as a byte order mark: a file written on
+// a host of the other byte order reads as BBG_MAGIC_SWAPPED and is rejected.
+// The file is laid out as:
+//
+//   bbg_header_t
+//   string table: str_count x { uint32 length; char text[length]; }
+//   SG table    : sg_count  x bbg_sg_t
+//   NG table    : ng_count  x uint32 (count of nodes in each NG)
+//   ND table    : nd_count  x bbg_nd_t
+//
+// The SGs are stored path SGL first, their NGs and NDs follow the same order.
+// String #0 is always the empty string.
+//--------------------------------------------------------------------------
+static const char STR_BIN_EXT[] = ".bbgbin";
+
+static const uint32 BBG_MAGIC         = 0x42474242; // "BBGB"
+static const uint32 BBG_MAGIC_SWAPPED = 0x42424742;
+static const uint16 BBG_VERSION = 1;
+
+static const uint8 BBG_SGL_PATH    = 0;
+static const uint8 BBG_SGL_SIMILAR = 1;
+
+static const uint8 BBG_SGF_SYNTHETIC = 0x01;
+
+#pragma pack(push, 1)
+struct bbg_header_t
+{
+  uint32 magic;
+  uint16 version;
+  uint16 header_size;
+  uint32 str_count;
+  uint32 sg_count;
+  uint32 ng_count;
+  uint32 nd_count;
+  uint32 extra_str;
+};
+
+struct bbg_sg_t
+{
+  uint32 id_str;
+  uint32 name_str;
+  uint8 sgl;
+  uint8 flags;
+  uint16 reserved;
+  uint32 ng_count;
+};
+
+struct bbg_nd_t
+{
+  int32 nid;
+  uint64 start;
+  uint64 end;
+};
+#pragma pack(pop)
+
+//--------------------------------------------------------------------------
+/**
+* @brief Helper class to collect the binary tables before writing them
+*/
+class bbg_writer_t
+{
+public:
+  std::vector<char> strings;
+  std::vector<bbg_sg_t> sgs;
+  std::vector<uint32> ngs;
+  std::vector<bbg_nd_t> nds;
+  uint32 str_count;
+
+  bbg_writer_t(): str_count(0)
+  {
+    add_str("", 0);
+  }
+
+  uint32 add_str(const char *str, size_t len)
+  {
+    // All empty strings share the first entry
+    if (len == 0 && str_count != 0)
+      return 0;
+
+    uint32 len32 = uint32(len);
+    const char *p = (const char *)&len32;
+    strings.insert(strings.end(), p, p + sizeof(len32));
+    strings.insert(strings.end(), str, str + len);
+    return str_count++;
+  }
+
+  void add_sgl(psupergroup_listp_t sgl, uint8 sgl_type)
+  {
+    for (supergroup_listp_t::iterator it=sgl->begin();
+         it != sgl->end();
+         ++it)
+    {
+      psupergroup_t sg = *it;
+
+      bbg_sg_t bsg;
+      bsg.id_str = add_str(sg->id.c_str(), sg->id.length());
+      bsg.name_str = add_str(sg->name.c_str(), sg->name.length());
+      bsg.sgl = sgl_type;
+      bsg.flags = sg->is_synthetic ? BBG_SGF_SYNTHETIC : 0;
+      bsg.reserved = 0;
+      bsg.ng_count = uint32(sg->groups.size());
+      sgs.push_back(bsg);
+
+      for (nodegroup_list_t::iterator it=sg->groups.begin();
+           it != sg->groups.end();
+           ++it)
+      {
+        pnodegroup_t ng = *it;
+        ngs.push_back(uint32(ng->size()));
+        for (nodegroup_t::iterator it=ng->begin();
+             it != ng->end();
+             ++it)
+        {
+          pnodedef_t nd = *it;
+
+          bbg_nd_t bnd;
+          bnd.nid = nd->nid;
+          bnd.start = nd->start;
+          bnd.end = nd->end;
+          nds.push_back(bnd);
+        }
+      }
+    }
+  }
+
+  template <class T> static void append_table(std::vector<char> *out, const std::vector<T> &v)
+  {
+    if (v.empty())
+      return;
+
+    const char *p = (const char *)&v[0];
+    out->insert(out->end(), p, p + v.size() * sizeof(T));
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Checks whether a buffer starts with the binary format header
+*/
+static bool is_bin_buffer(const char *buf, size_t size)
+{
+  uint32 magic;
+  if (size < sizeof(magic))
+    return false;
+
+  memcpy(&magic, buf, sizeof(magic));
+  return magic == BBG_MAGIC || magic == BBG_MAGIC_SWAPPED;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::is_bin_filename(const char *filename)
+{
+  size_t len = qstrlen(filename);
+  size_t ext_len = qnumber(STR_BIN_EXT) - 1;
+  return len >= ext_len && stricmp(filename + len - ext_len, STR_BIN_EXT) == 0;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::emit_bin_buffer(
+    std::vector<char> *out,
+    const char *additional_sections)
+{
+  if (!load_similar())
+    return false;
+
+  sync_reads();
+
+  bbg_writer_t w;
+  w.add_sgl(&rd_path_sgl(), BBG_SGL_PATH);
+  w.add_sgl(&rd_similar_sgl(), BBG_SGL_SIMILAR);
+
+  qstring extra = rd_extra_sections();
+  if (additional_sections != NULL)
+  {
+    extra.append(additional_sections);
+    extra.append('\n');
+  }
+
+  bbg_header_t hdr;
+  hdr.magic = BBG_MAGIC;
+  hdr.version = BBG_VERSION;
+  hdr.header_size = sizeof(hdr);
+  hdr.extra_str = w.add_str(extra.c_str(), extra.length());
+  hdr.str_count = w.str_count;
+  hdr.sg_count = uint32(w.sgs.size());
+  hdr.ng_count = uint32(w.ngs.size());
+  hdr.nd_count = uint32(w.nds.size());
+
+  out->clear();
+  out->reserve(
+      sizeof(hdr) 
+    + w.strings.size() 
+    + w.sgs.size() * sizeof(bbg_sg_t)
+    + w.ngs.size() * sizeof(uint32)
+    + w.nds.size() * sizeof(bbg_nd_t));
+
+  const char *p = (const char *)&hdr;
+  out->insert(out->end(), p, p + sizeof(hdr));
+  bbg_writer_t::append_table(out, w.strings);
+  bbg_writer_t::append_table(out, w.sgs);
+  bbg_writer_t::append_table(out, w.ngs);
+  bbg_writer_t::append_table(out, w.nds);
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::emit_bin(
+    const char *filename, 
+    const char *additional_sections,
+    bool atomic)
+{
+  std::vector<char> buf;
+  if (!emit_bin_buffer(&buf, additional_sections))
+    return false;
+
+  bufwriter_t w;
+  if (!w.open(filename, false, atomic))
+    return false;
+
+  if (!buf.empty())
+    w.write(&buf[0], buf.size());
+
+  return w.close();
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::parse_bin_buffer(
+    const char *buf,
+    size_t size,
+    bool init_cache)
+{
+  // Clear previous items
+  clear();
+
+  bbg_header_t hdr;
+  if (size < sizeof(hdr))
+    return false;
+
+  // Files of the other byte order fail the magic check
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (   hdr.magic != BBG_MAGIC 
+      || hdr.version > BBG_VERSION
+      || hdr.header_size < sizeof(hdr)
+      || hdr.header_size > size)
+  {
+    return false;
+  }
+
+  // Newer minor revisions may have a bigger header: skip it all
+  const char *p = buf + hdr.header_size;
+  const char *end = buf + size;
+
+  // Locate the strings (each one at least has a length)
+  if (hdr.str_count == 0 || hdr.str_count > size_t(end - p) / sizeof(uint32))
+    return false;
+
+  std::vector<const char *> strs(hdr.str_count);
+  std::vector<uint32> strs_len(hdr.str_count);
+  for (uint32 i=0; i < hdr.str_count; i++)
+  {
+    uint32 len;
+    if (size_t(end - p) < sizeof(len))
+      return false;
+
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (size_t(end - p) < len)
+      return false;
+
+    strs[i] = p;
+    strs_len[i] = len;
+    p += len;
+  }
+
+  // Locate the fixed size tables
+  if (   uint64(end - p) < uint64(hdr.sg_count) * sizeof(bbg_sg_t)
+                         + uint64(hdr.ng_count) * sizeof(uint32)
+                         + uint64(hdr.nd_count) * sizeof(bbg_nd_t)
+      || hdr.extra_str >= hdr.str_count)
+  {
+    return false;
+  }
+  const char *p_sgs = p;
+  const char *p_ngs = p_sgs + hdr.sg_count * sizeof(bbg_sg_t);
+  const char *p_nds = p_ngs + hdr.ng_count * sizeof(uint32);
+
+  uint32 ng_idx = 0, nd_idx = 0;
+  bool ok = true;
+  for (uint32 i=0; ok && i < hdr.sg_count; i++)
+  {
+    bbg_sg_t bsg;
+    memcpy(&bsg, p_sgs + i * sizeof(bsg), sizeof(bsg));
+    if (   bsg.id_str >= hdr.str_count 
+        || bsg.name_str >= hdr.str_count
+        || bsg.ng_count > hdr.ng_count - ng_idx)
+    {
+      ok = false;
+      break;
+    }
+
+    psupergroup_t sg = add_supergroup(bsg.sgl == BBG_SGL_SIMILAR ? &similar_sgl : &path_sgl);
+    sg->id = qstring(strs[bsg.id_str], strs_len[bsg.id_str]);
+    sg->name = qstring(strs[bsg.name_str], strs_len[bsg.name_str]);
+    sg->is_synthetic = (bsg.flags & BBG_SGF_SYNTHETIC) != 0;
+
+    for (uint32 j=0; j < bsg.ng_count; j++, ng_idx++)
+    {
+      uint32 nd_count;
+      memcpy(&nd_count, p_ngs + ng_idx * sizeof(nd_count), sizeof(nd_count));
+      if (nd_count > hdr.nd_count - nd_idx)
+      {
+        ok = false;
+        break;
+      }
+
+      pnodegroup_t ng = sg->add_nodegroup();
+      for (uint32 k=0; k < nd_count; k++, nd_idx++)
+      {
+        bbg_nd_t bnd;
+        memcpy(&bnd, p_nds + nd_idx * sizeof(bnd), sizeof(bnd));
+
+        nodedef_t *nd = ng->add_node();
+        nd->nid = bnd.nid;
+        nd->start = ea_t(bnd.start);
+        nd->end = ea_t(bnd.end);
+
+        // Only the path nodes are looked up
+        if (bsg.sgl == BBG_SGL_SIMILAR)
+          continue;
+
+        // Nodes are usually stored by ascending ID: hint the insertion
+        nid2ndef_t::iterator it_nd = all_nodes.insert(
+          all_nodes.end(), 
+          nid2ndef_t::value_type(nd->nid, nd));
+        it_nd->second = nd;
+      }
+    }
+  }
+
+  addr_index_dirty = true;
+
+  // All the tables should have been consumed
+  if (!ok || ng_idx != hdr.ng_count || nd_idx != hdr.nd_count)
+  {
+    clear();
+    return false;
+  }
+
+  extra_sections = qstring(strs[hdr.extra_str], strs_len[hdr.extra_str]);
+
+  // Initialize cache
+  if (init_cache)
+    initialize_lookups();
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::convert(
+    const char *src_filename,
+    const char *dst_filename)
+{
+  groupman_t gm;
+  return gm.parse(src_filename, false) && gm.emit(dst_filename);
+}
+
+//--------------------------------------------------------------------------
+//--  IN PLACE SCANNER  ----------------------------------------------------
+//--------------------------------------------------------------------------
+// These helpers work on [p, end) ranges and never write to the input.
+// They accept what the qstrtok()/qsscanf() based parser accepts.
+//--------------------------------------------------------------------------
+static inline bool scan_is_space(char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+//--------------------------------------------------------------------------
+static inline const char *scan_spaces(const char *p, const char *end)
+{
+  while (p < end && scan_is_space(*p))
+    ++p;
+  return p;
+}
+
+//--------------------------------------------------------------------------
+static inline const char *scan_char(const char *p, const char *end, char c)
+{
+  const char *r = (const char *)memchr(p, c, end - p);
+  return r == NULL ? end : r;
+}
+
+//--------------------------------------------------------------------------
+static inline bool scan_key_is(
+    const char *key,
+    const char *end,
+    const char *name,
+    size_t name_len)
+{
+  return size_t(end - key) == name_len && strnicmp(key, name, name_len) == 0;
+}
+
+//--------------------------------------------------------------------------
+static inline bool scan_name_is(
+    const char *name,
+    const char *end,
+    const char *ref,
+    size_t ref_len)
+{
+  return size_t(end - name) == ref_len && memcmp(name, ref, ref_len) == 0;
+}
+
+//--------------------------------------------------------------------------
+static inline int scan_hex_digit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+
+  return -1;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Decode a decimal integer, like the '%d' scanf directive
+*/
+static bool scan_dec(const char **pp, const char *end, int *out)
+{
+  const char *p = scan_spaces(*pp, end);
+
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = *p++ == '-';
+
+  // Accumulate unsigned so out of range values wrap modulo 2^32 and are
+  // stored as their two's-complement int
+  const char *digits = p;
+  uint32 v = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    v = v * 10 + uint32(*p++ - '0');
+
+  if (p == digits)
+    return false;
+
+  *out = int(neg ? 0 - v : v);
+  *pp = p;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Decode an hexadecimal address, like the '%a' scanf directive
+*/
+static bool scan_hex(const char **pp, const char *end, ea_t *out)
+{
+  const char *p = scan_spaces(*pp, end);
+
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = *p++ == '-';
+
+  // Optional radix prefix
+  if (   end - p > 2
+      && p[0] == '0' 
+      && (p[1] | 0x20) == 'x' 
+      && scan_hex_digit(p[2]) != -1)
+  {
+    p += 2;
+  }
+
+  const char *digits = p;
+  ea_t v = 0;
+  for (int d; p < end && (d = scan_hex_digit(*p)) != -1; ++p)
+    v = (v << 4) | d;
+
+  if (p == digits)
+    return false;
+
+  *out = neg ? 0 - v : v;
+  *pp = p;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Match the " : " separator of the node triplets
+*/
+static inline bool scan_sep(const char **pp, const char *end)
+{
+  const char *p = scan_spaces(*pp, end);
+  if (p == end || *p != ':')
+    return false;
+
+  *pp = p + 1;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::scan_nodeset(
+    psupergroup_t sg,
+    const char *p,
+    const char *end,
+    bool map_nodes)
+{
+  // Find node group bounds
+  for (;;)
+  {
+    const char *p_group_start = scan_char(p, end, '(');
+    if (p_group_start == end)
+      break;
+
+    p_group_start = scan_spaces(p_group_start + 1, end);
+    const char *p_group_end = scan_char(p_group_start, end, ')');
+    if (p_group_end == end)
+      break;
+
+    // Advance to next group
+    p = scan_spaces(p_group_end + 1, end);
+
+    // Add a new group
+    pnodegroup_t ng = sg->add_nodegroup();
+
+    // Walk the comma separated "nid : start : end" triplets
+    for (const char *q = p_group_start, *q_end; q < p_group_end; q = q_end + 1)
+    {
+      q_end = scan_char(q, p_group_end, ',');
+
+      int nid;
+      if (!scan_dec(&q, q_end, &nid))
+        continue;
+
+      ea_t start = 0, end = 0;
+      if (   scan_sep(&q, q_end) 
+          && scan_hex(&q, q_end, &start)
+          && scan_sep(&q, q_end))
+      {
+        scan_hex(&q, q_end, &end);
+      }
+
+      // Create an ND
+      nodedef_t *nd = ng->add_node();
+      nd->nid = nid;
+      nd->start = start;
+      nd->end = end;
+
+      // Map this node
+      if (map_nodes)
+        map_nodedef(nid, nd);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::scan_line(
+    psupergroup_t sg,
+    const char *p,
+    const char *end,
+    bool map_nodes)
+{
+  // Walk the ';' separated "key : value" tokens
+  for (const char *tok_end; p < end; p = tok_end + 1)
+  {
+    tok_end = scan_char(p, end, ';');
+
+    const char *sep = scan_char(p, tok_end, ':');
+    if (sep == tok_end)
+      continue;
+
+    const char *key = scan_spaces(p, sep);
+    const char *val = scan_spaces(sep + 1, tok_end);
+
+    if (scan_key_is(key, sep, STR_ID, qnumber(STR_ID) - 1))
+      sg->id = qstring(val, tok_end - val);
+    else if (scan_key_is(key, sep, STR_GROUP_NAME, qnumber(STR_GROUP_NAME) - 1))
+      sg->name = qstring(val, tok_end - val);
+    else if (scan_key_is(key, sep, STR_NODESET, qnumber(STR_NODESET) - 1))
+      scan_nodeset(sg, val, tok_end, map_nodes);
+  }
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::scan_text(
+    const char *buf,
+    size_t size,
+    bool defer_similar,
+    gm_sections_t *sects)
+{
+  psupergroup_listp_t cur_sgl = &path_sgl;
+  bool skip = false;
+
+  const char *end = buf + size;
+  for (const char *line = buf, *eol; line < end; line = eol + 1)
+  {
+    eol = scan_char(line, end, '\n');
+
+    // Lines are read in text mode: drop the CR of CRLF line endings
+    const char *line_end = eol;
+    if (line_end > line && line_end[-1] == '\r')
+      --line_end;
+
+    // Skip comment or empty lines
+    const char *s = scan_spaces(line, line_end);
+    if (s == line_end || *s == '#')
+      continue;
+
+    // Section switch?
+    bool is_section = line_end - s > 2 && s[0] == '-' && s[1] == '-';
+    if (is_section)
+    {
+      if (scan_name_is(s + 2, line_end, STR_PATHINFO, qnumber(STR_PATHINFO) - 1))
+        cur_sgl = &path_sgl;
+      else if (scan_name_is(s + 2, line_end, STR_SIMILARINFO, qnumber(STR_SIMILARINFO) - 1))
+        cur_sgl = &similar_sgl;
+      else
+        cur_sgl = NULL;
+
+      // Deferred sections are only located
+      skip = defer_similar && cur_sgl == &similar_sgl;
+      similar_pending |= skip;
+
+      if (sects != NULL)
+      {
+        if (!sects->empty())
+          sects->back().size = uint64(line - buf) - sects->back().offset;
+
+        sects->push_back(gm_section_t());
+        gm_section_t &sect = sects->back();
+        sect.name = qstring(s + 2, line_end - s - 2);
+        sect.offset = uint64(s - buf);
+        sect.size = 0;
+      }
+    }
+
+    if (skip)
+      continue;
+
+    // Keep the lines of unknown sections around
+    if (cur_sgl == NULL)
+    {
+      extra_sections.append(s, line_end - s);
+      extra_sections.append('\n');
+      continue;
+    }
+
+    // Skip this line after section switch
+    if (is_section)
+      continue;
+
+    // Create a new super group definition per line
+    psupergroup_t sg = add_supergroup(cur_sgl);
+
+    scan_line(sg, s, line_end, cur_sgl == &path_sgl);
+  }
+
+  // The last section goes up to the end
+  if (sects != NULL && !sects->empty())
+    sects->back().size = uint64(size) - sects->back().offset;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::parse_buffer(
+    const char *buf,
+    size_t size,
+    bool init_cache)
+{
+  // Clear previous items
+  clear();
+
+  scan_text(buf, size, false, &sections);
+
+  // Initialize cache
+  if (init_cache)
+    initialize_lookups();
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::parse(
+    const char *filename, 
+    bool init_cache)
+{
+  mmfile_t mf;
+  if (!mf.open(filename))
+    return false;
+
+  if (is_bin_buffer(mf.data(), mf.size()))
+  {
+    if (!parse_bin_buffer(mf.data(), mf.size(), init_cache))
+      return false;
+  }
+  else
+  {
+    // Clear previous items
+    clear();
+
+    // The similar SGs are read by load_similar() when needed
+    scan_text(mf.data(), mf.size(), lazy_similar, &sections);
+    src_size = mf.size();
+
+    // Initialize cache
+    if (init_cache)
+      initialize_lookups();
+  }
+
+  // Remember the opened file name
+  this->src_filename = filename;
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::load_similar()
+{
+  if (!similar_pending)
+    return true;
+
+  // Do not try again: the sections stay pending so that saving fails
+  // rather than writing a file without them
+  if (similar_lost)
+    return false;
+
+  similar_lost = true;
+
+  mmfile_t mf;
+  if (!mf.open(src_filename.c_str()) || mf.size() != src_size)
+    return false;
+
+  // Check that the sections are still where they were
+  const char *buf = mf.data();
+  gm_sections_t::const_iterator it;
+  for (it=sections.begin(); it != sections.end(); ++it)
+  {
+    const gm_section_t &sect = *it;
+    if (   sect.offset + sect.size > src_size
+        || sect.size < sect.name.length() + 2
+        || memcmp(buf + size_t(sect.offset), "--", 2) != 0
+        || memcmp(buf + size_t(sect.offset) + 2, sect.name.c_str(), sect.name.length()) != 0)
+    {
+      return false;
+    }
+  }
+
+  similar_pending = false;
+  similar_lost = false;
+
+  // Each section starts with its own switch line
+  sync_groups();
+  for (it=sections.begin(); it != sections.end(); ++it)
+  {
+    const gm_section_t &sect = *it;
+    if (qstrcmp(sect.name.c_str(), STR_SIMILARINFO) == 0)
+      scan_text(buf + size_t(sect.offset), size_t(sect.size), false, NULL);
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::reset_groupping()
+{
+  sync_groups();
+
+  // Every node moves: the views are rebuilt
+  changed_all = true;
+
+  begin_edit("Reset groupping");
+  if (jr_cur != NULL)
+  {
+    // Build the new SGs aside, then swap them with the current ones
+    supergroup_listp_t &limbo = jr_cur->sg_limbo;
+    supergroup_listp_t::iterator fresh = limbo.end();
+    if (!limbo.empty())
+      --fresh;
+
+    nid2ndef_t &nodes = rd_nodes();
+    for (nid2ndef_t::iterator it=nodes.begin();
+         it != nodes.end();
+         ++it)
+    {
+      psupergroup_t sg = gm_arena_t::alloc_sg(arena);
+      sg->owner = cow_id;
+      pnodedef_t nd = it->second;
+      sg->add_nodegroup()->add_node(nd);
+      sg->id.sprnt("node%d", nd->nid);
+      limbo.push_back(sg);
+    }
+    fresh = fresh == limbo.end() ? limbo.begin() : ++fresh;
+
+    supergroup_listp_t::iterator old = path_sgl.empty() ? limbo.end() : path_sgl.begin();
+    jr_move_sgs(&path_sgl, path_sgl.begin(), path_sgl.end(), &limbo);
+
+    nid2loc.reset(
+      nodes.empty() ? -1 : nodes.rbegin()->first,
+      nodes.size());
+    jr_move_sgs(&limbo, fresh, old, &path_sgl);
+
+    end_edit();
+
+    VERIFY_LOOKUPS();
+    return;
+  }
+  end_edit();
+
+  // ALGO
+  // -------
+  // TODO: The clear() and destructor is confusing and complicated. Simplify
+  //
+  // Go from SGL to SG to NGL to NG and clear references to node definitions
+  psupergroup_listp_t sgl = &path_sgl;
+  for (supergroup_listp_t::iterator it=sgl->begin(); 
+       it != sgl->end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+
+    // SGs shared with snapshots are left untouched
+    if (sg->owner != cow_id)
+      continue;
+
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
+    {
+      pnodegroup_t ng = *it;
+      // Clear the node definitions -> no more ND references
+      ng->clear();
     }
   }
   
   // Properly clear the SGL which eventually have no nodes
   clear_sgl(sgl);
 
-  // Now repopulate from all_nodes
-  for (nid2ndef_t::iterator it=all_nodes.begin();
-       it != all_nodes.end();
+  // Now repopulate from all_nodes
+  nid2ndef_t &nodes = rd_nodes();
+  nid2loc.reset(
+    nodes.empty() ? -1 : nodes.rbegin()->first,
+    nodes.size());
+
+  for (nid2ndef_t::iterator it=nodes.begin();
+       it != nodes.end();
+       ++it)
+  {
+    psupergroup_t sg = add_supergroup(sgl);  
+    pnodegroup_t  ng = sg->add_nodegroup();
+    pnodedef_t    nd = it->second;
+    
+    ng->add_node(nd);
+    sg->id.sprnt("node%d", nd->nid);
+
+    // Remember where this node is located
+    nid2loc.set(nd->nid, nodeloc_t(sg, ng, nd));
+  }
+
+  VERIFY_LOOKUPS();
+}
+
+//--------------------------------------------------------------------------
+psupergroup_t groupman_t::promote_nodegroup(
+    psupergroup_t sg,
+    pnodegroup_t ng)
+{
+  sync_groups();
+
+  // SG has one NG? Most likely this is the same SG and NG, leave alone
+  if (sg->gcount() == 1)
+    return NULL;
+
+  sg = own_sg(sg, &ng);
+
+  begin_edit("Promote group");
+
+  // Make a new SG
+  psupergroup_t new_sg = jr_add_sg();
+  jr_save_attrs(sg);
+  new_sg->copy_attr_from(sg);
+
+  // Move the NG to the new SG: only the nodes of this NG changed their SG
+  jr_move_ng(sg, std::find(sg->groups.begin(), sg->groups.end(), ng), new_sg);
+
+  end_edit();
+
+  VERIFY_LOOKUPS();
+
+  return new_sg;
+}
+
+//--------------------------------------------------------------------------
+pnodegroup_t groupman_t::move_node_to_own_ng(pnodedef_t nd)
+{
+  sync_groups();
+
+  nodeloc_t *loc = own_loc(nd->nid);
+
+  // This node is the only one in the NG
+  if (loc == NULL || loc->ng->size() == 1)
+    return NULL;
+
+  begin_edit("Move node");
+
+  psupergroup_t sg = loc->sg;
+  pnodegroup_t ng = loc->ng;
+  nodegroup_t::iterator it = std::find(ng->begin(), ng->end(), loc->nd);
+
+  // Create a new node group in the SG and move the node to it
+  pnodegroup_t new_ng = jr_add_ng(sg);
+  nodegroup_t::iterator next = it;
+  jr_move_nodes(sg, ng, it, ++next, sg, new_ng);
+
+  end_edit();
+
+  VERIFY_LOOKUPS();
+
+  return new_ng;
+}
+
+//--------------------------------------------------------------------------
+pnodedef_t groupman_t::split_nodegroup(pnodegroup_t ng)
+{
+  sync_groups();
+
+  pnodedef_t nd = ng->get_first_node();
+  if (nd == NULL)
+    return NULL;
+
+  // Get the loc -> SG
+  nodeloc_t *loc = own_loc(nd->nid);
+  if (loc == NULL)
+    return NULL;
+
+  psupergroup_t sg = loc->sg;
+  ng = loc->ng;
+
+  begin_edit("Split group");
+
+  // Take out each ND in this NG
+  pnodedef_t last_nd = NULL;
+  while (ng->size() > 1)
+  {
+    nodegroup_t::iterator it = --ng->end();
+    last_nd = *it;
+
+    pnodegroup_t new_ng = jr_add_ng(sg);
+    jr_move_nodes(sg, ng, it, ng->end(), sg, new_ng);
+  }
+
+  end_edit();
+
+  VERIFY_LOOKUPS();
+
+  return last_nd;
+}
+
+//--------------------------------------------------------------------------
+//--  UNDO/REDO JOURNAL  ---------------------------------------------------
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+/**
+* @brief Approximate the memory used by an edit and the groups it may detach
+*/
+static size_t get_jentry_bytes(gm_jentry_t *e)
+{
+  // Count a list node per object kept detached
+  const size_t link_size = 3 * sizeof(void *);
+
+  size_t bytes = sizeof(*e)
+               + e->desc.size()
+               + e->order.capacity()
+               + e->nodes.capacity() * sizeof(gm_jr_nodes_t)
+               + e->ngs.capacity() * sizeof(gm_jr_ng_t)
+               + e->sgs.capacity() * sizeof(gm_jr_sgs_t)
+               + e->attrs.capacity() * sizeof(gm_jr_attrs_t);
+
+  // The groups the edit detached
+  for (size_t i=0; i < e->ngs.size(); i++)
+  {
+    if (e->ngs[i].to_sg == NULL)
+      bytes += sizeof(nodegroup_t) + link_size;
+  }
+
+  for (size_t i=0; i < e->sgs.size(); i++)
+  {
+    gm_jr_sgs_t &r = e->sgs[i];
+    if (r.to == &e->sg_limbo)
+      bytes += r.count * (sizeof(supergroup_t) + link_size);
+  }
+
+  for (size_t i=0; i < e->attrs.size(); i++)
+  {
+    gm_jr_attrs_t &a = e->attrs[i];
+    bytes += a.old_id.size() + a.old_name.size() + a.new_id.size() + a.new_name.size();
+  }
+
+  return bytes;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_move_nodes(
+    psupergroup_t from_sg,
+    pnodegroup_t from_ng,
+    nodegroup_t::iterator first,
+    nodegroup_t::iterator last,
+    psupergroup_t to_sg,
+    pnodegroup_t to_ng)
+{
+  if (first == last)
+    return;
+
+  flat_dirty = true;
+  for (nodegroup_t::iterator it=first; it != last && !changed_all; ++it)
+    note_changed((*it)->nid);
+
+  if (jr_cur != NULL)
+  {
+    gm_jr_nodes_t r;
+    r.from_sg = from_sg;
+    r.to_sg = to_sg;
+    r.from_ng = from_ng;
+    r.to_ng = to_ng;
+    r.first = first;
+    r.last = last;
+    --r.last;
+    r.from_next = last;
+    r.to_next = to_ng->end();
+
+    jr_cur->nodes.push_back(r);
+    jr_cur->order.push_back(JR_NODES);
+  }
+
+  to_ng->splice(to_ng->end(), *from_ng, first, last);
+
+  gm_stats_t st;
+  for (; first != to_ng->end(); ++first)
+  {
+    pnodedef_t nd = *first;
+    nid2loc.set(nd->nid, nodeloc_t(to_sg, to_ng, nd));
+    st.add(nd);
+  }
+  move_stats(from_sg, from_ng, to_sg, to_ng, st);
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_move_ng(
+    psupergroup_t from_sg,
+    nodegroup_list_t::iterator it,
+    psupergroup_t to_sg)
+{
+  nodegroup_list_t *to = to_sg == NULL ? &jr_cur->ng_limbo : &to_sg->groups;
+
+  pnodegroup_t ng = *it;
+  move_stats(from_sg, ng, to_sg, ng, ng->get_stats());
+  flat_dirty = true;
+  note_changed(ng);
+
+  if (jr_cur != NULL)
+  {
+    gm_jr_ng_t r;
+    r.from_sg = from_sg;
+    r.to_sg = to_sg;
+    r.from = from_sg == NULL ? &jr_cur->ng_limbo : &from_sg->groups;
+    r.to = to;
+    r.it = it;
+    r.from_next = it;
+    ++r.from_next;
+    r.to_next = to->end();
+
+    jr_cur->ngs.push_back(r);
+    jr_cur->order.push_back(JR_NG);
+
+    to->splice(to->end(), *r.from, it);
+  }
+  else
+  {
+    to->splice(to->end(), from_sg->groups, it);
+  }
+
+  if (to_sg != NULL)
+    relocate_ng(to_sg, *it);
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_move_sgs(
+    psupergroup_listp_t from,
+    supergroup_listp_t::iterator first,
+    supergroup_listp_t::iterator last,
+    psupergroup_listp_t to)
+{
+  if (first == last)
+    return;
+
+  flat_dirty = true;
+  for (supergroup_listp_t::iterator it=first; it != last; ++it)
+    note_changed(*it);
+
+  if (jr_cur != NULL)
+  {
+    gm_jr_sgs_t r;
+    r.from = from;
+    r.to = to;
+    r.first = first;
+    r.last = last;
+    --r.last;
+    r.from_next = last;
+    r.to_next = to->end();
+    r.count = std::distance(first, last);
+
+    jr_cur->sgs.push_back(r);
+    jr_cur->order.push_back(JR_SGS);
+  }
+
+  to->splice(to->end(), *from, first, last);
+  if (to != &path_sgl)
+    return;
+
+  for (; first != to->end(); ++first)
+  {
+    psupergroup_t sg = *first;
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
+    {
+      relocate_ng(sg, *it);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+pnodegroup_t groupman_t::jr_add_ng(psupergroup_t sg)
+{
+  if (jr_cur == NULL)
+  {
+    flat_dirty = true;
+    return sg->add_nodegroup();
+  }
+
+  // Created detached then attached so undo can detach it again
+  pnodegroup_t ng = jr_cur->ng_limbo.add_nodegroup(gm_arena_t::alloc_ng(arena));
+  jr_move_ng(NULL, --jr_cur->ng_limbo.end(), sg);
+  return ng;
+}
+
+//--------------------------------------------------------------------------
+nodegroup_list_t::iterator groupman_t::jr_remove_ng(
+    psupergroup_t sg,
+    nodegroup_list_t::iterator it)
+{
+  if (jr_cur == NULL)
+  {
+    sg->stats_sub(*it, (*it)->get_stats());
+    gm_arena_t::free_ng(*it);
+    flat_dirty = true;
+    return sg->groups.erase(it);
+  }
+
+  nodegroup_list_t::iterator next = it;
+  ++next;
+  jr_move_ng(sg, it, NULL);
+  return next;
+}
+
+//--------------------------------------------------------------------------
+psupergroup_t groupman_t::jr_add_sg()
+{
+  if (jr_cur == NULL)
+  {
+    // An empty SG changes no node
+    bool all = changed_all;
+    psupergroup_t sg = add_supergroup(&path_sgl);
+    changed_all = all;
+    return sg;
+  }
+
+  psupergroup_t sg = gm_arena_t::alloc_sg(arena);
+  sg->owner = cow_id;
+
+  supergroup_listp_t &limbo = jr_cur->sg_limbo;
+  limbo.push_back(sg);
+  jr_move_sgs(&limbo, --limbo.end(), limbo.end(), &path_sgl);
+  return sg;
+}
+
+//--------------------------------------------------------------------------
+supergroup_listp_t::iterator groupman_t::jr_remove_sg(supergroup_listp_t::iterator it)
+{
+  if (jr_cur == NULL)
+  {
+    gm_arena_t::free_sg(*it);
+    flat_dirty = true;
+    return path_sgl.erase(it);
+  }
+
+  supergroup_listp_t::iterator next = it;
+  ++next;
+  jr_move_sgs(&path_sgl, it, next, &jr_cur->sg_limbo);
+  return next;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_save_attrs(psupergroup_t sg)
+{
+  // The nodes are displayed with the SG name
+  note_changed(sg);
+
+  if (jr_cur == NULL)
+    return;
+
+  // The new attributes are taken when the edit ends
+  gm_jr_attrs_t r;
+  r.sg = sg;
+  r.old_id = sg->id;
+  r.old_name = sg->name;
+  r.old_synthetic = sg->is_synthetic;
+  r.new_synthetic = false;
+
+  jr_cur->attrs.push_back(r);
+  jr_cur->order.push_back(JR_ATTRS);
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_replay(gm_jentry_t *e, bool redo)
+{
+  size_t i_nodes = redo ? 0 : e->nodes.size();
+  size_t i_ngs   = redo ? 0 : e->ngs.size();
+  size_t i_sgs   = redo ? 0 : e->sgs.size();
+  size_t i_attrs = redo ? 0 : e->attrs.size();
+  flat_dirty = true;
+
+  for (size_t i=0; i < e->order.size(); i++)
+  {
+    switch (e->order[redo ? i : e->order.size() - 1 - i])
+    {
+      case JR_NODES:
+      {
+        gm_jr_nodes_t &r = e->nodes[redo ? i_nodes++ : --i_nodes];
+        pnodegroup_t src = redo ? r.from_ng : r.to_ng;
+        pnodegroup_t dst = redo ? r.to_ng : r.from_ng;
+        psupergroup_t dst_sg = redo ? r.to_sg : r.from_sg;
+
+        nodegroup_t::iterator end = r.last;
+        ++end;
+        dst->splice(redo ? r.to_next : r.from_next, *src, r.first, end);
+
+        gm_stats_t st;
+        for (nodegroup_t::iterator it=r.first; ; ++it)
+        {
+          pnodedef_t nd = *it;
+          nid2loc.set(nd->nid, nodeloc_t(dst_sg, dst, nd));
+          note_changed(nd->nid);
+          st.add(nd);
+          if (it == r.last)
+            break;
+        }
+        move_stats(redo ? r.from_sg : r.to_sg, src, dst_sg, dst, st);
+        break;
+      }
+      case JR_NG:
+      {
+        gm_jr_ng_t &r = e->ngs[redo ? i_ngs++ : --i_ngs];
+        nodegroup_list_t *src = redo ? r.from : r.to;
+        nodegroup_list_t *dst = redo ? r.to : r.from;
+        psupergroup_t dst_sg = redo ? r.to_sg : r.from_sg;
+
+        dst->splice(redo ? r.to_next : r.from_next, *src, r.it);
+        if (dst_sg != NULL)
+          relocate_ng(dst_sg, *r.it);
+
+        pnodegroup_t ng = *r.it;
+        move_stats(redo ? r.from_sg : r.to_sg, ng, dst_sg, ng, ng->get_stats());
+        note_changed(ng);
+        break;
+      }
+      case JR_SGS:
+      {
+        gm_jr_sgs_t &r = e->sgs[redo ? i_sgs++ : --i_sgs];
+        psupergroup_listp_t src = redo ? r.from : r.to;
+        psupergroup_listp_t dst = redo ? r.to : r.from;
+
+        supergroup_listp_t::iterator end = r.last;
+        ++end;
+        dst->splice(redo ? r.to_next : r.from_next, *src, r.first, end);
+        for (supergroup_listp_t::iterator it=r.first; ; ++it)
+        {
+          note_changed(*it);
+          if (it == r.last)
+            break;
+        }
+
+        if (dst != &path_sgl)
+          break;
+
+        for (supergroup_listp_t::iterator it=r.first; ; ++it)
+        {
+          psupergroup_t sg = *it;
+          for (nodegroup_list_t::iterator it_ng=sg->groups.begin();
+               it_ng != sg->groups.end();
+               ++it_ng)
+          {
+            relocate_ng(sg, *it_ng);
+          }
+          if (it == r.last)
+            break;
+        }
+        break;
+      }
+      case JR_ATTRS:
+      {
+        gm_jr_attrs_t &r = e->attrs[redo ? i_attrs++ : --i_attrs];
+        r.sg->id = redo ? r.new_id : r.old_id;
+        r.sg->name = redo ? r.new_name : r.old_name;
+        r.sg->is_synthetic = redo ? r.new_synthetic : r.old_synthetic;
+        note_changed(r.sg);
+        break;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::note_changed(int nid)
+{
+  if (changed_all)
+    return;
+
+  // Past that count, patching costs more than rebuilding
+  if (changed_nids.size() >= rd_nodes().size())
+  {
+    changed_all = true;
+    std::vector<int>().swap(changed_nids);
+    return;
+  }
+  changed_nids.push_back(nid);
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::note_changed(pnodegroup_t ng)
+{
+  for (nodegroup_t::iterator it=ng->begin(); 
+       it != ng->end() && !changed_all; 
        ++it)
   {
-    psupergroup_t sg = add_supergroup(sgl);  
-    pnodegroup_t  ng = sg->add_nodegroup();
-    pnodedef_t    nd = it->second;
-    
-    ng->add_node(nd);
-    sg->id.sprnt("node%d", nd->nid);
+    note_changed((*it)->nid);
+  }
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::note_changed(psupergroup_t sg)
+{
+  for (nodegroup_list_t::iterator it=sg->groups.begin();
+       it != sg->groups.end() && !changed_all;
+       ++it)
+  {
+    note_changed(*it);
+  }
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::take_changes(std::vector<int> *nids)
+{
+  // Pending merges change the grouping as a whole
+  sync_groups();
+
+  bool ok = !changed_all;
+  if (nids != NULL)
+  {
+    nids->clear();
+    if (ok)
+      nids->swap(changed_nids);
+  }
+  changed_nids.clear();
+  changed_all = false;
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_free_entry(gm_jentry_t *e)
+{
+  // The detached groups do not own their nodes: they are shared with the
+  // groups they were moved to or from
+  e->ng_limbo.free_nodegroup(false);
+  e->ng_limbo.clear();
+
+  for (supergroup_listp_t::iterator it=e->sg_limbo.begin();
+       it != e->sg_limbo.end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+
+    // SGs shared with snapshots are left to them
+    if (sg->owner != cow_id)
+      continue;
+
+    sg->groups.free_nodegroup(false);
+    sg->groups.clear();
+    gm_arena_t::free_sg(sg);
+  }
+  e->sg_limbo.clear();
+
+  delete e;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::jr_trim()
+{
+  size_t drop = 0;
+  while (journal_bytes > journal_limit && drop < journal_pos)
+  {
+    journal_bytes -= journal[drop]->bytes;
+    jr_free_entry(journal[drop]);
+    ++drop;
+  }
+
+  if (drop == 0)
+    return;
+
+  journal.erase(journal.begin(), journal.begin() + drop);
+  journal_pos -= drop;
+  journal_dropped += drop;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::clear_journal()
+{
+  for (size_t i=0; i < journal.size(); i++)
+    jr_free_entry(journal[i]);
+
+  journal.clear();
+  journal_pos = 0;
+  journal_bytes = 0;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::set_journal(bool enable)
+{
+  if (enable)
+    sync_groups();
+  else
+    clear_journal();
+
+  journal_enabled = enable;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::set_journal_limit(size_t bytes)
+{
+  journal_limit = bytes;
+  jr_trim();
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::get_journal_stats(gm_journal_stats_t *st)
+{
+  st->undo_count = journal_pos;
+  st->redo_count = journal.size() - journal_pos;
+  st->bytes = journal_bytes;
+  st->limit = journal_limit;
+  st->dropped = journal_dropped;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::begin_edit(const char *desc)
+{
+  if (jr_depth++ != 0 || !journal_enabled)
+    return;
+
+  // Lazy merges would have to be recorded when they get materialized
+  sync_groups();
+
+  jr_cur = new gm_jentry_t();
+  jr_cur->desc = desc;
+}
+
+//--------------------------------------------------------------------------
+void groupman_t::end_edit()
+{
+  if (jr_depth == 0 || --jr_depth != 0 || jr_cur == NULL)
+    return;
+
+  gm_jentry_t *e = jr_cur;
+  jr_cur = NULL;
+
+  // Nothing changed
+  if (e->order.empty())
+  {
+    jr_free_entry(e);
+    return;
+  }
+
+  for (size_t i=0; i < e->attrs.size(); i++)
+  {
+    gm_jr_attrs_t &r = e->attrs[i];
+    r.new_id = r.sg->id;
+    r.new_name = r.sg->name;
+    r.new_synthetic = r.sg->is_synthetic;
+  }
+
+  // The undone edits cannot be redone anymore
+  for (size_t i=journal_pos; i < journal.size(); i++)
+  {
+    journal_bytes -= journal[i]->bytes;
+    jr_free_entry(journal[i]);
   }
+  journal.resize(journal_pos);
+
+  e->bytes = get_jentry_bytes(e);
+  journal.push_back(e);
+  journal_pos = journal.size();
+  journal_bytes += e->bytes;
+
+  jr_trim();
+}
 
-  // Reinitialize lookups
-  initialize_lookups();
+//--------------------------------------------------------------------------
+bool groupman_t::undo()
+{
+  if (jr_depth != 0 || journal_pos == 0)
+    return false;
+
+  sync_groups();
+  jr_replay(journal[--journal_pos], false);
+
+  VERIFY_LOOKUPS();
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+bool groupman_t::redo()
+{
+  if (jr_depth != 0 || journal_pos == journal.size())
+    return false;
+
+  sync_groups();
+  jr_replay(journal[journal_pos++], true);
+
+  VERIFY_LOOKUPS();
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+const char *groupman_t::get_undo_desc()
+{
+  return journal_pos == 0 ? NULL : journal[journal_pos - 1]->desc.c_str();
+}
+
+//--------------------------------------------------------------------------
+const char *groupman_t::get_redo_desc()
+{
+  return journal_pos == journal.size() ? NULL : journal[journal_pos]->desc.c_str();
+}
+
+//--------------------------------------------------------------------------
+psupergroup_t groupman_t::set_sg_name(
+    psupergroup_t sg,
+    const char *name)
+{
+  sync_groups();
+  sg = own_sg(sg);
+
+  begin_edit("Rename group");
+  jr_save_attrs(sg);
+  sg->name = name;
+  end_edit();
+
+  return sg;
 }
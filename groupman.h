@@ -18,6 +18,12 @@ It also provides the group management class.
 #include <set>
 #include <list>
 #include <map>
+#include <vector>
+#include <new>
+
+//--------------------------------------------------------------------------
+class gm_arena_t;
+class bufwriter_t;
 
 //--------------------------------------------------------------------------
 struct nodedef_t
@@ -32,6 +38,75 @@ struct nodedef_t
 };
 typedef nodedef_t *pnodedef_t;
 
+//--------------------------------------------------------------------------
+/**
+* @brief Aggregate statistics of the nodes of an NG or of an SG
+*/
+struct gm_stats_t
+{
+  size_t node_count;
+
+  /**
+  * @brief Count of bytes covered by the nodes
+  */
+  uint64 bytes;
+
+  /**
+  * @brief Lowest start and highest end address (BADADDR and 0 without nodes)
+  */
+  ea_t min_ea;
+  ea_t max_ea;
+
+  gm_stats_t()
+  {
+    clear();
+  }
+
+  inline void clear()
+  {
+    node_count = 0;
+    bytes = 0;
+    min_ea = BADADDR;
+    max_ea = 0;
+  }
+
+  inline void add(const nodedef_t *nd)
+  {
+    ++node_count;
+    bytes += nd->end - nd->start;
+    if (nd->start < min_ea)
+      min_ea = nd->start;
+    if (nd->end > max_ea)
+      max_ea = nd->end;
+  }
+
+  inline void add(const gm_stats_t &st)
+  {
+    node_count += st.node_count;
+    bytes += st.bytes;
+    if (st.min_ea < min_ea)
+      min_ea = st.min_ea;
+    if (st.max_ea > max_ea)
+      max_ea = st.max_ea;
+  }
+
+  /**
+  * @brief Take nodes out
+  * @return False if the address bounds may have changed
+  */
+  inline bool sub(const gm_stats_t &st)
+  {
+    node_count -= st.node_count;
+    bytes -= st.bytes;
+    if (node_count == 0)
+    {
+      clear();
+      return true;
+    }
+    return st.min_ea > min_ea && st.max_ea < max_ea;
+  }
+};
+
 //--------------------------------------------------------------------------
 /**
 * @brief A list of nodes making up a group
@@ -39,8 +114,80 @@ typedef nodedef_t *pnodedef_t;
 class nodegroup_t: public std::list<pnodedef_t>
 {
 public:
+  /**
+  * @brief The arena this NG was allocated from and where its nodes come from
+  *        (NULL for heap allocated groups)
+  */
+  gm_arena_t *arena;
+
+  /**
+  * @brief Disjoint set links used by the lazy merges of groupman_t.
+  *        uf_parent is the NG this NG was merged into (NULL for a root).
+  *        A root chains the NGs merged into it through uf_next, in merge
+  *        order, and remembers the last one in uf_tail
+  */
+  nodegroup_t *uf_parent;
+  nodegroup_t *uf_next;
+  nodegroup_t *uf_tail;
+
+  /**
+  * @brief Count of nodes merged into this root but not moved in yet
+  */
+  size_t uf_absorbed;
+
+  /**
+  * @brief Cached statistics of the nodes and whether they must be recomputed
+  */
+  gm_stats_t stats;
+  bool stats_dirty;
+
+  nodegroup_t(): arena(NULL), uf_parent(NULL), uf_next(NULL), uf_tail(NULL), uf_absorbed(0), stats_dirty(false)
+  {
+  }
+
   void free_nodes();
+
+  /**
+  * @brief Add a node. A new node is not accounted for until the stats are
+  *        recomputed since its addresses are set by the caller
+  */
   pnodedef_t add_node(pnodedef_t nd = NULL);
+
+  /**
+  * @brief Return the statistics of the nodes
+  */
+  inline const gm_stats_t &get_stats()
+  {
+    if (stats_dirty)
+      update_stats();
+    return stats;
+  }
+
+  /**
+  * @brief Recompute the statistics of the nodes
+  */
+  void update_stats();
+
+  /**
+  * @brief Have the stats recomputed: needed after changing the list directly
+  */
+  inline void invalidate_stats() { stats_dirty = true; }
+
+  /**
+  * @brief Account for nodes moved in or out
+  */
+  inline void stats_add(const gm_stats_t &st)
+  {
+    if (!stats_dirty)
+      stats.add(st);
+  }
+
+  inline void stats_sub(const gm_stats_t &st)
+  {
+    if (!stats_dirty && !stats.sub(st))
+      stats_dirty = true;
+  }
+
   /**
   * @brief Return the first node definition from this group
   */
@@ -68,6 +215,92 @@ public:
 */
 typedef std::map<int, pnodedef_t> nid2ndef_t;
 
+//--------------------------------------------------------------------------
+/**
+* @brief A vector of node definitions
+*/
+typedef std::vector<pnodedef_t> nodedef_vec_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Address index of the node definitions.
+*        The nodes are spread over layers of disjoint nodes sorted by start
+*        address. Each node goes to the first layer it does not overlap so
+*        that only the overlapping nodes (stale or duplicate ones) make more
+*        layers. A lookup is one binary search per layer
+*/
+class ndaddr_index_t
+{
+  struct entry_t
+  {
+    ea_t start;
+    ea_t end;
+
+    // Position in the start address order of all the entries
+    size_t order;
+    pnodedef_t nd;
+
+    inline bool operator<(const entry_t &other) const
+    {
+      return start < other.start;
+    }
+  };
+  typedef std::vector<entry_t> entries_t;
+  typedef std::vector<entries_t> layers_t;
+  layers_t layers;
+  size_t count;
+
+  static bool ends_at_or_before(const entry_t &e, ea_t ea);
+
+public:
+  ndaddr_index_t(): count(0)
+  {
+  }
+
+  /**
+  * @brief Build the index from the node definitions lookup
+  */
+  void build(nid2ndef_t &nds);
+
+  /**
+  * @brief Clear the index
+  */
+  inline void clear()
+  {
+    layers.clear();
+    count = 0;
+  }
+
+  /**
+  * @brief Return the memory used by the entries
+  */
+  size_t mem_bytes();
+
+  /**
+  * @brief Number of indexed nodes
+  */
+  inline size_t size() { return count; }
+
+  /**
+  * @brief Number of layers: the deepest overlap of the nodes
+  */
+  inline size_t layer_count() { return layers.size(); }
+
+  /**
+  * @brief Find the node containing the given address
+  */
+  pnodedef_t find(ea_t ea);
+
+  /**
+  * @brief Find all the nodes overlapping [start, end)
+  * @return Count of found nodes. They are returned sorted by start address
+  */
+  size_t find_range(
+    ea_t start,
+    ea_t end,
+    nodedef_vec_t *out);
+};
+
 //--------------------------------------------------------------------------
 /**
 * @brief nodegroups type is a list of nodegroup type
@@ -75,6 +308,15 @@ typedef std::map<int, pnodedef_t> nid2ndef_t;
 class nodegroup_list_t: public std::list<pnodegroup_t>
 {
 public:
+  /**
+  * @brief The arena new node groups are allocated from (NULL for the heap)
+  */
+  gm_arena_t *arena;
+
+  nodegroup_list_t(): arena(NULL)
+  {
+  }
+
   void free_nodegroup(bool free_nodes);
   /**
   * @brief Return the first node definition from the first group in the group list
@@ -125,6 +367,24 @@ public:
   */
   nodegroup_list_t groups;
 
+  /**
+  * @brief The arena this SG was allocated from (NULL for the heap)
+  */
+  gm_arena_t *arena;
+
+  /**
+  * @brief Copy-on-write stamp of the groupman_t allowed to change this SG in place
+  */
+  uint32 owner;
+
+  /**
+  * @brief Cached statistics of all the nodes and the NG with the most nodes.
+  *        They are kept up to date by groupman_t and recomputed when dirty
+  */
+  gm_stats_t stats;
+  pnodegroup_t biggest;
+  bool stats_dirty;
+
   supergroup_t();
   ~supergroup_t();
 
@@ -134,7 +394,7 @@ public:
   void clear();
 
   /**
-  * @brief Add a new node group
+  * @brief Add a new node group. The stats are recomputed on the next query
   * @return Node group
   */
   pnodegroup_t add_nodegroup(pnodegroup_t ng = NULL);
@@ -150,6 +410,15 @@ public:
   */
   void copy_attr_from(supergroup_t *sg);
 
+  /**
+  * @brief Copy the attributes and the NGs of this SG to another SG.
+  *        The node definitions are shared, not copied
+  * @param ng - if not NULL, an NG of this SG to translate to its copy
+  */
+  void copy_to(
+    supergroup_t *dest,
+    nodegroup_t **ng = NULL);
+
   /**
   * @brief Return the count of defined groups
   */
@@ -174,154 +443,1300 @@ public:
   * @brief Return a descriptive name for the super group
   */
   const char *get_display_name(const char *defval = NULL);
-};
 
-//--------------------------------------------------------------------------
-typedef supergroup_t *psupergroup_t;
+  /**
+  * @brief Return the statistics of all the nodes
+  */
+  inline const gm_stats_t &get_stats()
+  {
+    if (stats_dirty)
+      update_stats();
+    return stats;
+  }
 
-//--------------------------------------------------------------------------
-class supergroup_listp_t: public std::list<psupergroup_t>
-{
-public:
   /**
-  * @brief Copy this SGL to the desired one
+  * @brief Return the NG with the most nodes (NULL if there are no NGs)
   */
-  void copy_to(psupergroup_t dest);
+  inline pnodegroup_t get_biggest_ng()
+  {
+    if (stats_dirty)
+      update_stats();
+    return biggest;
+  }
 
   /**
-  * @brief Remove a super group and frees it if needed
+  * @brief Recompute the statistics from the NGs
   */
-  void remove_sg(psupergroup_t sg, bool free_sg);
+  void update_stats();
+
+  /**
+  * @brief Have the stats recomputed: needed after changing the NGs directly
+  */
+  inline void invalidate_stats() { stats_dirty = true; }
+
+  /**
+  * @brief Account for nodes added to an NG or for an NG added
+  */
+  void stats_add(pnodegroup_t ng, const gm_stats_t &st);
+
+  /**
+  * @brief Account for nodes taken out of an NG or for an NG removed
+  */
+  void stats_sub(pnodegroup_t ng, const gm_stats_t &st);
 };
 
-typedef supergroup_listp_t *psupergroup_listp_t;
+//--------------------------------------------------------------------------
+typedef supergroup_t *psupergroup_t;
 
 //--------------------------------------------------------------------------
 /**
-* @brief Node location class
+* @brief Allocation statistics of a pool
 */
-struct nodeloc_t
+struct gm_pool_stats_t
 {
-  psupergroup_t sg;
-  pnodegroup_t  ng;
-  pnodedef_t    nd;
+  /**
+  * @brief Objects currently allocated
+  */
+  size_t live;
 
-  nodeloc_t(): sg(NULL), ng(NULL), nd(NULL)
-  {
-  }
-  nodeloc_t(psupergroup_t sg, 
-            pnodegroup_t ng,
-            pnodedef_t nd): sg(sg), ng(ng), nd(nd)
+  /**
+  * @brief Highest count of objects allocated at the same time
+  */
+  size_t peak;
+
+  /**
+  * @brief Total count of object allocations
+  */
+  size_t allocs;
+
+  /**
+  * @brief Total count of heap allocations (chunks) made by the pool
+  */
+  size_t chunks;
+
+  /**
+  * @brief Bytes currently reserved by the pool and the most ever reserved
+  */
+  size_t bytes;
+  size_t peak_bytes;
+
+  gm_pool_stats_t(): live(0), peak(0), allocs(0), chunks(0), bytes(0), peak_bytes(0)
   {
   }
 };
 
 //--------------------------------------------------------------------------
 /**
-* @brief Group management class
+* @brief Pool of objects of the same type.
+*        Objects are carved out of chunks so they keep stable addresses.
+*        Freed slots are reused and release() frees everything at once
 */
-class groupman_t
+template <class T>
+class gm_pool_t
 {
-private:
+  struct slot_t
+  {
+    union
+    {
+      slot_t *next_free;
+      double align;
+      char data[sizeof(T)];
+    };
+    bool live;
+  };
+
+  struct chunk_t
+  {
+    slot_t *slots;
+    size_t count;
+  };
+  typedef std::vector<chunk_t> chunks_t;
+
+  enum
+  {
+    FIRST_CHUNK_SIZE = 32,
+    MAX_CHUNK_SIZE   = 4096,
+  };
+
+  chunks_t chunks;
+  slot_t *free_list;
+  size_t capacity;
+  gm_pool_stats_t stats;
+
   /**
-  * @brief NodeId node location lookup map
+  * @brief Allocate a new chunk and put its slots in the free list
+  * @param count - count of slots or 0 to follow the chunk growth policy
   */
-  typedef std::map<int, nodeloc_t> nid2nloc_map_t;
-  nid2nloc_map_t nid2loc;
+  void grow(size_t count = 0)
+  {
+    chunk_t chunk;
+    if (count != 0)
+      chunk.count = count;
+    else
+      chunk.count = chunks.empty() ? FIRST_CHUNK_SIZE : qmin(chunks.back().count * 2, size_t(MAX_CHUNK_SIZE));
+    chunk.slots = new slot_t[chunk.count];
+    chunks.push_back(chunk);
+
+    // Link the slots so they are handed out in address order
+    for (size_t i = chunk.count; i-- > 0; )
+    {
+      slot_t *slot = &chunk.slots[i];
+      slot->live = false;
+      slot->next_free = free_list;
+      free_list = slot;
+    }
+
+    capacity += chunk.count;
+    ++stats.chunks;
+    stats.bytes += chunk.count * sizeof(slot_t);
+    if (stats.bytes > stats.peak_bytes)
+      stats.peak_bytes = stats.bytes;
+  }
+
+  // Not copyable
+  gm_pool_t(const gm_pool_t &);
+  gm_pool_t &operator=(const gm_pool_t &);
+
+public:
+  gm_pool_t(): free_list(NULL), capacity(0)
+  {
+  }
+
+  ~gm_pool_t()
+  {
+    release();
+  }
 
   /**
-  * @brief Path super groups definition
+  * @brief Allocate and default construct an object
   */
-  supergroup_listp_t path_sgl;
+  T *alloc()
+  {
+    if (free_list == NULL)
+      grow();
+
+    slot_t *slot = free_list;
+    free_list = slot->next_free;
+    T *obj = new (slot->data) T();
+    slot->live = true;
+
+    ++stats.allocs;
+    if (++stats.live > stats.peak)
+      stats.peak = stats.live;
+
+    return obj;
+  }
 
   /**
-  * @brief Similar nodes super groups
+  * @brief Make sure 'count' objects can be allocated without more than
+  *        one heap allocation
   */
-  supergroup_listp_t similar_sgl;
+  void reserve(size_t count)
+  {
+    size_t avail = capacity - stats.live;
+    if (count > avail)
+      grow(qmax(count - avail, size_t(FIRST_CHUNK_SIZE)));
+  }
 
   /**
-  * @brief A lookup table for all node definitions
+  * @brief Destroy an object and make its slot available again
   */
-  nid2ndef_t all_nodes;
+  void free(T *obj)
+  {
+    slot_t *slot = (slot_t *)obj;
+    obj->~T();
+    slot->live = false;
+    slot->next_free = free_list;
+    free_list = slot;
+    --stats.live;
+  }
 
   /**
-  * @brief Private copy constructor
+  * @brief Destroy all the live objects and free all the chunks
   */
-  groupman_t(const groupman_t &) { }
+  void release()
+  {
+    for (typename chunks_t::iterator it=chunks.begin(); it != chunks.end(); ++it)
+    {
+      for (size_t i=0; i < it->count; i++)
+      {
+        slot_t *slot = &it->slots[i];
+        if (slot->live)
+          ((T *)slot->data)->~T();
+      }
+      delete [] it->slots;
+    }
+    chunks.clear();
+    free_list = NULL;
+    capacity = 0;
+    stats.live = 0;
+    stats.bytes = 0;
+  }
 
   /**
-  * @brief Parse a nodeset string
+  * @brief Return the allocation statistics
   */
-  bool parse_nodeset(
-      psupergroup_t sg, 
-      char *grpstr);
+  inline const gm_pool_stats_t &get_stats() { return stats; }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Owns the nodes, node groups and super groups of a group manager
+*/
+class gm_arena_t
+{
+  gm_pool_t<nodedef_t> nds;
+  gm_pool_t<nodegroup_t> ngs;
+  gm_pool_t<supergroup_t> sgs;
 
   /**
-  * @brief Parse a line
+  * @brief Set while releasing: individual frees are skipped since
+  *        the pools destroy all the live objects anyway
   */
-  bool parse_line(
-      psupergroup_t sg,
-      char *line);
+  bool releasing;
 
   /**
-  * @brief Free and clear a super group list
+  * @brief Count of group managers sharing this arena (see groupman_t::snapshot())
   */
-  void clear_sgl(psupergroup_listp_t sgl);
+  int refs;
 
 public:
+  gm_arena_t(): releasing(false), refs(1)
+  {
+  }
+
+  ~gm_arena_t()
+  {
+    release();
+  }
 
   /**
-  * @brief File name that was last loaded
+  * @brief Allocate a node definition from the arena or the heap
   */
-  qstring src_filename;
+  static pnodedef_t alloc_nd(gm_arena_t *arena);
 
   /**
-  * @brief Method to initialize lookups
+  * @brief Allocate a node group from the arena or the heap
   */
-  void initialize_lookups();
+  static pnodegroup_t alloc_ng(gm_arena_t *arena);
 
   /**
-  * @brief Return the path super groups
+  * @brief Allocate a super group from the arena or the heap
   */
-  inline psupergroup_listp_t get_path_sgl() { return &path_sgl; }
+  static psupergroup_t alloc_sg(gm_arena_t *arena);
 
   /**
-  * @brief All the node defs
+  * @brief Free a node definition that was allocated with alloc_nd(arena).
+  *        Nodes of a shared arena are shared too and live as long as the arena
   */
-  inline nid2ndef_t *get_nds() 
-  { 
-    return &all_nodes; 
-  }
+  static void free_nd(gm_arena_t *arena, pnodedef_t nd);
 
   /**
-  * @ctor Default constructor
+  * @brief Free a node group (but not its nodes)
   */
-  groupman_t() { }
+  static void free_ng(pnodegroup_t ng);
 
   /**
-  * @dtor Destructor
+  * @brief Free a super group and its node groups and nodes
   */
-  ~groupman_t();
+  static void free_sg(psupergroup_t sg);
 
   /**
-  * @brief Clears the defined groups
+  * @brief Free all the objects at once
   */
-  void clear();
+  void release();
 
   /**
-  * @brief Remember the node definition
+  * @brief Make room for many objects at once before allocating them
   */
-  inline void map_nodedef(int nid, pnodedef_t nd) 
-  { 
-    all_nodes[nid] = nd; 
+  inline void reserve(
+    size_t nd_count,
+    size_t ng_count,
+    size_t sg_count)
+  {
+    nds.reserve(nd_count);
+    ngs.reserve(ng_count);
+    sgs.reserve(sg_count);
   }
 
   /**
-  * @brief Add a new super group
+  * @brief Add a reference to the arena
   */
-  psupergroup_t add_supergroup(
-    psupergroup_listp_t sgl = NULL,
-    psupergroup_t sg = NULL);
+  inline void add_ref() { ++refs; }
+
+  /**
+  * @brief Drop a reference to the arena and delete it with the last one
+  */
+  static void unref(gm_arena_t *arena);
+
+  /**
+  * @brief Is the arena shared by several group managers?
+  */
+  inline bool is_shared() { return refs > 1; }
+
+  /**
+  * @brief Return the allocation statistics of each pool
+  */
+  inline const gm_pool_stats_t &get_nd_stats() { return nds.get_stats(); }
+  inline const gm_pool_stats_t &get_ng_stats() { return ngs.get_stats(); }
+  inline const gm_pool_stats_t &get_sg_stats() { return sgs.get_stats(); }
+};
+
+//--------------------------------------------------------------------------
+class supergroup_listp_t: public std::list<psupergroup_t>
+{
+public:
+  /**
+  * @brief Remove a super group and frees it if needed
+  */
+  void remove_sg(psupergroup_t sg, bool free_sg);
+};
+
+typedef supergroup_listp_t *psupergroup_listp_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief A flat read-only copy of an SG list.
+*        The SGs, the NGs and the nodes are stored in arrays, in list order.
+*        The NGs of the SG 'i' are [ng_first[i], ng_first[i+1]) and the nodes
+*        of the NG 'j' are [nd_first[j], nd_first[j+1]). The node ids and
+*        addresses are copied next to each other so that walking them does
+*        not touch the node definitions.
+*        It refers to the groups: it must be rebuilt once they change
+*/
+class gm_flat_t
+{
+public:
+  typedef std::vector<uint32> offsets_t;
+
+  std::vector<psupergroup_t> sgs;
+  offsets_t ng_first;
+
+  std::vector<pnodegroup_t> ngs;
+  offsets_t nd_first;
+
+  nodedef_vec_t nds;
+  std::vector<int> nids;
+  std::vector<ea_t> starts;
+  std::vector<ea_t> ends;
+
+  gm_flat_t()
+  {
+    clear();
+  }
+
+  /**
+  * @brief Rebuild from an SG list, reusing the arrays
+  * @param nd_hint - expected count of nodes (0 if unknown)
+  */
+  void build(
+      psupergroup_listp_t sgl,
+      size_t nd_hint = 0);
+
+  /**
+  * @brief Clear and free the arrays
+  */
+  void clear();
+
+  inline size_t sg_count() const { return sgs.size(); }
+  inline size_t ng_count() const { return ngs.size(); }
+  inline size_t nd_count() const { return nds.size(); }
+
+  /**
+  * @brief Return the NG range of an SG and the node range of an NG
+  */
+  inline uint32 ng_begin(size_t sg) const { return ng_first[sg]; }
+  inline uint32 ng_end(size_t sg) const { return ng_first[sg + 1]; }
+  inline uint32 nd_begin(size_t ng) const { return nd_first[ng]; }
+  inline uint32 nd_end(size_t ng) const { return nd_first[ng + 1]; }
+
+  /**
+  * @brief Return the memory used by the arrays
+  */
+  size_t mem_bytes() const;
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Node location class
+*/
+struct nodeloc_t
+{
+  psupergroup_t sg;
+  pnodegroup_t  ng;
+  pnodedef_t    nd;
+
+  nodeloc_t(): sg(NULL), ng(NULL), nd(NULL)
+  {
+  }
+  nodeloc_t(psupergroup_t sg, 
+            pnodegroup_t ng,
+            pnodedef_t nd): sg(sg), ng(ng), nd(nd)
+  {
+  }
+};
+typedef std::vector<nodeloc_t *> nodeloc_vec_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Node id to node location lookup table.
+*        Flowchart node ids are numbered 0..N-1, so the locations are kept
+*        in a vector indexed by node id. Ids that would make the vector too
+*        sparse (negative or far beyond the node count) go to a map instead
+*/
+class nodeloc_table_t
+{
+  typedef std::vector<nodeloc_t> dense_t;
+  typedef std::map<int, nodeloc_t> sparse_t;
+
+  dense_t dense;
+  sparse_t sparse;
+
+  /**
+  * @brief Count of nodes with a location
+  */
+  size_t count;
+
+  /**
+  * @brief Count of nodes the table was prepared for
+  */
+  size_t expected;
+
+  /**
+  * @brief Can the node id be stored in the dense table?
+  */
+  inline bool fits_dense(int nid)
+  {
+    return nid >= 0 && size_t(nid) < (qmax(count, expected) + 1) * 2 + 1024;
+  }
+
+public:
+  nodeloc_table_t(): count(0), expected(0)
+  {
+  }
+
+  /**
+  * @brief Clear the table and prepare it for node ids up to 'max_nid'
+  */
+  void reset(int max_nid = -1, size_t nodes_count = 0);
+
+  /**
+  * @brief Set the location of a node
+  */
+  void set(int nid, const nodeloc_t &loc);
+
+  /**
+  * @brief Return the location of a node or NULL if not found
+  */
+  inline nodeloc_t *find(int nid)
+  {
+    if (size_t(nid) < dense.size())
+    {
+      nodeloc_t *loc = &dense[nid];
+      return loc->nd == NULL ? NULL : loc;
+    }
+    if (sparse.empty())
+      return NULL;
+
+    sparse_t::iterator it = sparse.find(nid);
+    return it == sparse.end() ? NULL : &it->second;
+  }
+
+  /**
+  * @brief Count of nodes in the table
+  */
+  inline size_t size() { return count; }
+
+  /**
+  * @brief Count of nodes that did not fit in the dense table
+  */
+  inline size_t sparse_size() { return sparse.size(); }
+
+  /**
+  * @brief Return the memory used by the table
+  */
+  size_t mem_bytes();
+
+  /**
+  * @brief Exchange the contents of two tables
+  */
+  inline void swap(nodeloc_table_t &other)
+  {
+    dense.swap(other.dense);
+    sparse.swap(other.sparse);
+    std::swap(count, other.count);
+    std::swap(expected, other.expected);
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Location of a "--NAME" section in a text groups definition file
+*/
+struct gm_section_t
+{
+  qstring name;
+
+  /**
+  * @brief Offset of the section line and size up to the next section
+  */
+  uint64 offset;
+  uint64 size;
+};
+typedef std::vector<gm_section_t> gm_sections_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief The lists and lookups of a group manager at the time it was snapshot.
+*        They are handed over as is so taking a snapshot is O(1). Each sharer
+*        reads them in place and copies them the first time it changes the
+*        grouping, the last one takes them
+*/
+struct gm_frozen_t
+{
+  int refs;
+  supergroup_listp_t path_sgl;
+  supergroup_listp_t similar_sgl;
+  nodeloc_table_t nid2loc;
+  qstring extra_sections;
+
+  gm_frozen_t(): refs(1)
+  {
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief The node definitions lookup shared with snapshots. The grouping
+*        edits do not change it: it is only copied when nodes are mapped
+*/
+struct gm_shared_nodes_t
+{
+  int refs;
+  nid2ndef_t nds;
+
+  gm_shared_nodes_t(): refs(1)
+  {
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief An edit recorded in the undo/redo journal (see groupman_t::begin_edit())
+*/
+struct gm_jentry_t;
+
+//--------------------------------------------------------------------------
+/**
+* @brief Undo/redo journal statistics
+*/
+struct gm_journal_stats_t
+{
+  /**
+  * @brief Count of edits that can be undone and redone
+  */
+  size_t undo_count;
+  size_t redo_count;
+
+  /**
+  * @brief Approximate memory used by the journal and its limit
+  */
+  size_t bytes;
+  size_t limit;
+
+  /**
+  * @brief Count of the oldest edits dropped to stay within the limit
+  */
+  size_t dropped;
+
+  gm_journal_stats_t(): undo_count(0), redo_count(0), bytes(0), limit(0), dropped(0)
+  {
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Categories of the memory used by a group manager
+*/
+enum gm_mem_category_e
+{
+  gm_mem_sg_objects = 0,
+  gm_mem_ng_objects = 1,
+  gm_mem_nd_objects = 2,
+
+  // Nodes of the SG lists, of the NG lists and of the NGs
+  gm_mem_list_nodes = 3,
+
+  gm_mem_nid2loc    = 4,
+  gm_mem_all_nodes  = 5,
+  gm_mem_addr_index = 6,
+
+  // IDs and names of the SGs
+  gm_mem_names      = 7,
+
+  gm_mem_journal    = 8,
+
+  // File names, sections and other text
+  gm_mem_other      = 9,
+
+  // Flat view of the path SGs
+  gm_mem_flat       = 10,
+
+  gm_mem_count
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Memory used by a group manager by category.
+*        Container sizes are estimated from their element counts, without
+*        the heap overhead. The arena and the groups shared with snapshots
+*        are counted by each group manager sharing them
+*/
+struct gm_mem_stats_t
+{
+  size_t bytes[gm_mem_count];
+
+  /**
+  * @brief Highest values seen. They are exact for the objects. The other
+  *        categories are sampled by initialize_lookups() and get_mem_stats()
+  */
+  size_t peak[gm_mem_count];
+
+  size_t total;
+  size_t peak_total;
+
+  /**
+  * @brief Count of live objects
+  */
+  size_t sg_count;
+  size_t ng_count;
+  size_t nd_count;
+
+  /**
+  * @brief Is the arena shared with snapshots?
+  */
+  bool shared;
+
+  gm_mem_stats_t()
+  {
+    clear();
+  }
+
+  void clear();
+
+  static const char *get_category_name(gm_mem_category_e cat);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Group management class
+*/
+class groupman_t
+{
+private:
+  /**
+  * @brief NodeId node location lookup table
+  */
+  nodeloc_table_t nid2loc;
+
+  /**
+  * @brief Path super groups definition
+  */
+  supergroup_listp_t path_sgl;
+
+  /**
+  * @brief Similar nodes super groups
+  */
+  supergroup_listp_t similar_sgl;
+
+  /**
+  * @brief A lookup table for all node definitions
+  */
+  nid2ndef_t all_nodes;
+
+  /**
+  * @brief Arena owning all the SGs, NGs and NDs of this group manager.
+  *        It is shared with the snapshots
+  */
+  gm_arena_t *arena;
+
+  /**
+  * @brief The lists and lookups shared with snapshots, not copied in yet
+  */
+  gm_frozen_t *frozen;
+
+  /**
+  * @brief The node definitions shared with snapshots, used instead of
+  *        all_nodes when not NULL
+  */
+  gm_shared_nodes_t *shared_nodes;
+
+  /**
+  * @brief Copy-on-write stamp: only the SGs carrying it are changed in place
+  */
+  uint32 cow_id;
+
+  /**
+  * @brief Address lookup index built from all_nodes
+  */
+  ndaddr_index_t addr_index;
+
+  /**
+  * @brief Tells whether the address index is out of sync with all_nodes
+  */
+  bool addr_index_dirty;
+
+  /**
+  * @brief Defer the NG moves of combine_ngl() (see set_lazy_merges())
+  */
+  bool lazy_merges;
+
+  /**
+  * @brief Tells whether merges are waiting to be materialized
+  */
+  bool merges_pending;
+
+  /**
+  * @brief Sections of the last parsed text source
+  */
+  gm_sections_t sections;
+
+  /**
+  * @brief Size of the source file when it was parsed
+  */
+  uint64 src_size;
+
+  /**
+  * @brief Skip the SIMILARINFO sections in parse() (see set_lazy_similar())
+  */
+  bool lazy_similar;
+
+  /**
+  * @brief Tells whether the similar SGs are still to be read from the source
+  */
+  bool similar_pending;
+
+  /**
+  * @brief Tells whether the source changed before the similar SGs were read
+  */
+  bool similar_lost;
+
+  /**
+  * @brief Undo/redo journal. The edits before journal_pos can be undone,
+  *        the ones after it redone
+  */
+  std::vector<gm_jentry_t *> journal;
+  size_t journal_pos;
+  size_t journal_bytes;
+  size_t journal_limit;
+  size_t journal_dropped;
+  bool journal_enabled;
+
+  /**
+  * @brief The edit being recorded and the nesting level of begin_edit()
+  */
+  gm_jentry_t *jr_cur;
+  int jr_depth;
+
+  /**
+  * @brief Peak values of the memory categories sampled so far
+  */
+  size_t mem_peak[gm_mem_count];
+
+  /**
+  * @brief Flat view of the path SGs and whether it must be rebuilt
+  */
+  gm_flat_t flat;
+  bool flat_dirty;
+
+  /**
+  * @brief Nodes moved by the edits since take_changes() was last called,
+  *        unless the grouping may have changed as a whole
+  */
+  std::vector<int> changed_nids;
+  bool changed_all;
+
+  /**
+  * @brief Record a node, the nodes of an NG or of an SG as changed
+  */
+  void note_changed(int nid);
+  void note_changed(pnodegroup_t ng);
+  void note_changed(psupergroup_t sg);
+
+  /**
+  * @brief Not copyable: use snapshot()
+  */
+  groupman_t(const groupman_t &);
+  groupman_t &operator=(const groupman_t &);
+
+  /**
+  * @brief Parse a nodeset string
+  * @param map_nodes - remember the node definitions (path SGs only)
+  */
+  bool parse_nodeset(
+      psupergroup_t sg, 
+      char *grpstr,
+      bool map_nodes);
+
+  /**
+  * @brief Parse a line
+  */
+  bool parse_line(
+      psupergroup_t sg,
+      char *line,
+      bool map_nodes);
+
+  /**
+  * @brief Scan a nodeset value in place
+  * @param map_nodes - remember the node definitions (path SGs only)
+  */
+  void scan_nodeset(
+      psupergroup_t sg,
+      const char *p,
+      const char *end,
+      bool map_nodes);
+
+  /**
+  * @brief Scan a line in place
+  */
+  void scan_line(
+      psupergroup_t sg,
+      const char *p,
+      const char *end,
+      bool map_nodes);
+
+  /**
+  * @brief Scan a text buffer in place
+  * @param defer_similar - only record the SIMILARINFO sections
+  * @param sects - if not NULL, receives the sections met
+  */
+  void scan_text(
+      const char *buf,
+      size_t size,
+      bool defer_similar,
+      gm_sections_t *sects);
+
+  /**
+  * @brief Free and clear a super group list
+  */
+  void clear_sgl(psupergroup_listp_t sgl);
+
+  /**
+  * @brief Return the address index (rebuilt if it went out of sync)
+  */
+  ndaddr_index_t *get_addr_index();
+
+  /**
+  * @brief Build a node location table by walking the path SGL
+  */
+  void build_lookups(nodeloc_table_t &tbl);
+
+  /**
+  * @brief Remember the new location of all the nodes in a node group
+  */
+  void relocate_ng(psupergroup_t sg, pnodegroup_t ng);
+
+  /**
+  * @brief Measure the memory in use, without the peaks
+  */
+  void measure_mem(gm_mem_stats_t *st);
+
+  /**
+  * @brief Measure the memory in use and record the new peaks
+  */
+  void sample_mem();
+
+  /**
+  * @brief Update the stats of the NGs and SGs nodes were moved between.
+  *        'from_sg' or 'to_sg' are NULL for detached NGs
+  */
+  void move_stats(
+      psupergroup_t from_sg,
+      pnodegroup_t from_ng,
+      psupergroup_t to_sg,
+      pnodegroup_t to_ng,
+      const gm_stats_t &st);
+
+  /**
+  * @brief Return the NG an NG was merged into
+  */
+  static pnodegroup_t uf_find(pnodegroup_t ng);
+
+  /**
+  * @brief Record that 'src' was merged into 'dest' (both being roots)
+  */
+  static void uf_union(pnodegroup_t dest, pnodegroup_t src);
+
+  /**
+  * @brief Combine NGs by only linking them in the disjoint set
+  */
+  pnodegroup_t combine_ngl_lazy(pnodegroup_list_t ngl);
+
+  /**
+  * @brief Move the nodes of the merged NGs to their root NG and drop the
+  *        merged NGs and the SGs left empty
+  */
+  void materialize_merges();
+
+  /**
+  * @brief Copy in (or take over) the lists and lookups shared with snapshots
+  */
+  void thaw();
+
+  /**
+  * @brief Drop the reference to the shared lists and lookups
+  */
+  void unfreeze();
+
+  /**
+  * @brief Copy in (or take over) the node definitions shared with snapshots
+  */
+  void own_nodes();
+
+  /**
+  * @brief Drop the reference to the shared node definitions
+  */
+  void unshare_nodes();
+
+  /**
+  * @brief Make the lists writable before they are changed: thaw them and
+  *        materialize the pending merges
+  */
+  inline void sync_groups()
+  {
+    if (frozen != NULL)
+      thaw();
+    if (merges_pending)
+      materialize_merges();
+  }
+
+  /**
+  * @brief Make the lists readable: materialize the pending merges.
+  *        Merges are only pending on thawed lists
+  */
+  inline void sync_reads()
+  {
+    if (merges_pending)
+      materialize_merges();
+  }
+
+  /**
+  * @brief The lists and lookups to read from: the ones shared with the
+  *        snapshots until the grouping is changed
+  */
+  inline supergroup_listp_t &rd_path_sgl()
+  {
+    return frozen != NULL ? frozen->path_sgl : path_sgl;
+  }
+  inline supergroup_listp_t &rd_similar_sgl()
+  {
+    return frozen != NULL ? frozen->similar_sgl : similar_sgl;
+  }
+  inline nodeloc_table_t &rd_nid2loc()
+  {
+    return frozen != NULL ? frozen->nid2loc : nid2loc;
+  }
+  inline qstring &rd_extra_sections()
+  {
+    return frozen != NULL ? frozen->extra_sections : extra_sections;
+  }
+  inline nid2ndef_t &rd_nodes()
+  {
+    return shared_nodes != NULL ? shared_nodes->nds : all_nodes;
+  }
+
+  /**
+  * @brief Return a list of this group manager that can be changed,
+  *        'sgl' being one of the lists returned by the getters
+  */
+  psupergroup_listp_t own_sgl(psupergroup_listp_t sgl);
+
+  /**
+  * @brief Return the location of a node, its SG being made writable
+  */
+  nodeloc_t *own_loc(int nid);
+
+  /**
+  * @brief Return the writable copy of a node group
+  */
+  pnodegroup_t own_ng(pnodegroup_t ng);
+
+  /**
+  * @brief Move the nodes [first, last) of an NG to the end of another NG
+  */
+  void jr_move_nodes(
+      psupergroup_t from_sg,
+      pnodegroup_t from_ng,
+      nodegroup_t::iterator first,
+      nodegroup_t::iterator last,
+      psupergroup_t to_sg,
+      pnodegroup_t to_ng);
+
+  /**
+  * @brief Move an NG to the end of the NG list of an SG
+  *        (or of the recorded edit when 'to_sg' is NULL)
+  */
+  void jr_move_ng(
+      psupergroup_t from_sg,
+      nodegroup_list_t::iterator it,
+      psupergroup_t to_sg);
+
+  /**
+  * @brief Move the SGs [first, last) to the end of another SG list
+  */
+  void jr_move_sgs(
+      psupergroup_listp_t from,
+      supergroup_listp_t::iterator first,
+      supergroup_listp_t::iterator last,
+      psupergroup_listp_t to);
+
+  /**
+  * @brief Add a new NG at the end of an SG
+  */
+  pnodegroup_t jr_add_ng(psupergroup_t sg);
+
+  /**
+  * @brief Remove an empty NG from its SG
+  * @return The NG following the removed one
+  */
+  nodegroup_list_t::iterator jr_remove_ng(
+      psupergroup_t sg,
+      nodegroup_list_t::iterator it);
+
+  /**
+  * @brief Add a new SG at the end of the path SGL
+  */
+  psupergroup_t jr_add_sg();
+
+  /**
+  * @brief Remove an empty SG from the path SGL
+  * @return The SG following the removed one
+  */
+  supergroup_listp_t::iterator jr_remove_sg(supergroup_listp_t::iterator it);
+
+  /**
+  * @brief Remember the attributes of an SG before they are changed
+  */
+  void jr_save_attrs(psupergroup_t sg);
+
+  /**
+  * @brief Replay the records of an edit forward (redo) or backward (undo)
+  */
+  void jr_replay(gm_jentry_t *e, bool redo);
+
+  /**
+  * @brief Free an edit and the groups it keeps detached
+  */
+  void jr_free_entry(gm_jentry_t *e);
+
+  /**
+  * @brief Drop the oldest edits until the journal fits in its limit
+  */
+  void jr_trim();
+
+public:
+
+  /**
+  * @brief File name that was last loaded
+  */
+  qstring src_filename;
+
+  /**
+  * @brief Text of the unknown sections met while parsing.
+  *        It is written back as is by emit()
+  */
+  qstring extra_sections;
+
+  /**
+  * @brief Method to initialize lookups
+  */
+  void initialize_lookups();
+
+  /**
+  * @brief Verify that the incrementally maintained lookups match a full rebuild
+  * @return True if the lookups are in sync
+  */
+  bool verify_lookups();
+
+  /**
+  * @brief Verify that the cached SG and NG statistics match a full rebuild
+  */
+  bool verify_stats();
+
+  /**
+  * @brief Verify that the flat view matches the path SGs
+  */
+  bool verify_flat();
+
+  /**
+  * @brief Bring everything that is maintained lazily up to date: merges,
+  *        similar SGs, address index, stats and flat view. Reading a settled group
+  *        manager changes nothing, so it can be shared with other threads
+  */
+  void settle();
+
+  /**
+  * @brief Return the memory used by category and the peak values
+  */
+  void get_mem_stats(gm_mem_stats_t *st);
+
+  /**
+  * @brief Return the arena used to allocate the groups
+  */
+  inline gm_arena_t *get_arena() { return arena; }
+
+  /**
+  * @brief Take a snapshot of the grouping in O(1).
+  *        The snapshot and this group manager share all the SGs, NGs and
+  *        nodes. Whichever changes an SG first works on its own copy of it
+  * @return A new group manager to be deleted by the caller
+  */
+  groupman_t *snapshot();
+
+  /**
+  * @brief Return a copy of an SG that can be changed in place.
+  *        SGs shared with a snapshot are copied first
+  * @param ng - if not NULL, an NG of the SG to translate to its copy
+  */
+  psupergroup_t own_sg(
+    psupergroup_t sg,
+    pnodegroup_t *ng = NULL);
+
+  /**
+  * @brief Return the path super groups.
+  *        The list may be shared with snapshots: change it through this
+  *        class (add_supergroup(), remove_supergroup()...), not directly
+  */
+  inline psupergroup_listp_t get_path_sgl() 
+  { 
+    sync_reads();
+    return &rd_path_sgl(); 
+  }
+
+  /**
+  * @brief Return the flat view of the path SGs, rebuilt if they changed.
+  *        Full walks of the grouping should use it rather than the lists
+  */
+  const gm_flat_t *get_flat();
+
+  /**
+  * @brief Have the flat view rebuilt: needed after changing the SGs or NGs
+  *        directly rather than through this class. initialize_lookups()
+  *        does it too
+  */
+  inline void invalidate_flat() { flat_dirty = true; }
+
+  /**
+  * @brief Take the nodes the grouping edits changed since the last call so
+  *        that views can patch the groups they display
+  * @param nids - receives the ids of the nodes that changed NG or SG
+  *               (including copies of shared groups) or whose SG was
+  *               renamed, possibly repeated. Can be NULL
+  * @return False if the grouping may have changed as a whole (loading,
+  *         clearing, lazy merges...). 'nids' is then left empty
+  */
+  bool take_changes(std::vector<int> *nids);
+
+  /**
+  * @brief Enable or disable the lazy merges.
+  *        When enabled, combine_ngl() only links the NGs in a disjoint set.
+  *        The nodes are moved and the SG/NG lists are updated in one pass
+  *        the next time the lists or the lookups are needed
+  */
+  void set_lazy_merges(bool lazy);
+
+  /**
+  * @brief Are the merges lazy?
+  */
+  inline bool get_lazy_merges() { return lazy_merges; }
+
+  /**
+  * @brief Return the similar nodes super groups, reading them from the
+  *        source file first if they were skipped by parse()
+  */
+  inline psupergroup_listp_t get_similar_sgl()
+  {
+    load_similar();
+    sync_reads();
+    return &rd_similar_sgl();
+  }
+
+  /**
+  * @brief Enable or disable the lazy loading of the similar nodes.
+  *        When enabled, parse() only records where the SIMILARINFO sections
+  *        of a text file are. They are read the first time they are needed
+  */
+  inline void set_lazy_similar(bool lazy) { lazy_similar = lazy; }
+
+  /**
+  * @brief Is the loading of the similar nodes lazy?
+  */
+  inline bool get_lazy_similar() { return lazy_similar; }
+
+  /**
+  * @brief Read the similar nodes skipped by parse() from the source file.
+  *        It is only tried once: if the source file changed, the similar
+  *        nodes stay pending and emitting the groups fails
+  * @return False if the source file changed since it was parsed
+  */
+  bool load_similar();
+
+  /**
+  * @brief Are the similar nodes still to be read?
+  */
+  inline bool is_similar_pending() { return similar_pending; }
+
+  /**
+  * @brief Return the sections of the last parsed text source
+  */
+  inline const gm_sections_t &get_sections() { return sections; }
+
+  /**
+  * @brief All the node defs. Read only: use map_nodedef() to add nodes
+  */
+  inline nid2ndef_t *get_nds() 
+  { 
+    sync_reads();
+    return &rd_nodes(); 
+  }
+
+  /**
+  * @ctor Default constructor
+  */
+  groupman_t();
+
+  /**
+  * @dtor Destructor
+  */
+  ~groupman_t();
+
+  /**
+  * @brief Clears the defined groups
+  */
+  void clear();
+
+  /**
+  * @brief Remember the node definition
+  */
+  inline void map_nodedef(int nid, pnodedef_t nd) 
+  { 
+    own_nodes();
+    all_nodes[nid] = nd; 
+    addr_index_dirty = true;
+  }
+
+  /**
+  * @brief Remember many node definitions at once
+  * @param nds - node definitions sorted by node id
+  */
+  void map_nodedefs(const nodedef_vec_t &nds);
+
+  /**
+  * @brief Add a new super group
+  */
+  psupergroup_t add_supergroup(
+    psupergroup_listp_t sgl = NULL,
+    psupergroup_t sg = NULL);
 
   /**
   * @brief Remove a super group
@@ -332,33 +1747,173 @@ public:
 
   /**
   * @brief Rewrites the structure from memory back to a file
+  *        The binary format is used if the file has the binary extension
   * @param filename - the output file name
+  * @param atomic - write to a temporary file then replace the output file
   */
   bool emit(
     const char *filename, 
+    const char *additional_sections = NULL,
+    bool atomic = false);
+
+  /**
+  * @brief Rewrites the structure to a text file through stdio.
+  *        This is the reference writer that emit() must agree with
+  */
+  bool emit_stdio(
+    const char *filename, 
+    const char *additional_sections = NULL);
+
+  /**
+  * @brief Write the structure to a file in the binary format
+  */
+  bool emit_bin(
+    const char *filename, 
+    const char *additional_sections = NULL,
+    bool atomic = false);
+
+  /**
+  * @brief Serialize the structure in the binary format to a memory buffer
+  */
+  bool emit_bin_buffer(
+    std::vector<char> *out,
     const char *additional_sections = NULL);
 
   /**
-  * @brief Parse groups definition file
+  * @brief Load groups definitions from a binary format memory buffer
+  */
+  bool parse_bin_buffer(
+    const char *buf,
+    size_t size,
+    bool init_cache = true);
+
+  /**
+  * @brief Checks whether a file name has the binary format extension
+  */
+  static bool is_bin_filename(const char *filename);
+
+  /**
+  * @brief Convert a groups definition file between the text and the binary formats
+  *        The source format is detected, the destination one comes from its extension
+  */
+  static bool convert(
+    const char *src_filename,
+    const char *dst_filename);
+
+  /**
+  * @brief Parse groups definition file.
+  *        The file is mapped in memory and scanned in place.
+  *        Both the text and the binary formats are recognized.
+  *        The SIMILARINFO sections of text files are skipped until
+  *        needed unless the lazy loading is disabled
   */
   bool parse(
     const char *filename, 
     bool init_cache = true);
 
+  /**
+  * @brief Parse groups definitions from a memory buffer
+  */
+  bool parse_buffer(
+    const char *buf,
+    size_t size,
+    bool init_cache = true);
+
+  /**
+  * @brief Parse groups definition file line by line through a stream.
+  *        This is the reference parser that parse() must agree with
+  */
+  bool parse_getline(
+    const char *filename, 
+    bool init_cache = true);
+
   
   /**
   * @brief A group manager is considered empty if it has no path information
   */
-  inline bool empty() { return path_sgl.empty(); }
+  inline bool empty() 
+  { 
+    sync_reads();
+    return rd_path_sgl().empty(); 
+  }
+
+  /**
+  * @brief Enable or disable the undo/redo journal.
+  *        When enabled, the grouping edits record the nodes, NGs and SGs they
+  *        move so that undo() and redo() cost as much as the edit itself.
+  *        The NGs and SGs an edit removes are kept aside until the edit is
+  *        dropped from the journal. Lazy merges are not used while journaling
+  */
+  void set_journal(bool enable);
+
+  /**
+  * @brief Is the undo/redo journal enabled?
+  */
+  inline bool get_journal() { return journal_enabled; }
+
+  /**
+  * @brief Set the memory limit of the journal. The oldest edits are dropped
+  *        when it is exceeded
+  */
+  void set_journal_limit(size_t bytes);
+
+  /**
+  * @brief Drop all the recorded edits
+  */
+  void clear_journal();
+
+  /**
+  * @brief Return the journal statistics
+  */
+  void get_journal_stats(gm_journal_stats_t *st);
+
+  /**
+  * @brief Start recording an edit. All the changes made until the matching
+  *        end_edit() are undone and redone together. Calls can be nested
+  * @param desc - description of the edit
+  */
+  void begin_edit(const char *desc);
+
+  /**
+  * @brief Finish recording an edit
+  */
+  void end_edit();
+
+  /**
+  * @brief Undo the last edit
+  */
+  bool undo();
+
+  /**
+  * @brief Redo the last undone edit
+  */
+  bool redo();
+
+  /**
+  * @brief Return the description of the edit undo() or redo() would replay
+  *        or NULL if there is none
+  */
+  const char *get_undo_desc();
+  const char *get_redo_desc();
+
+  /**
+  * @brief Rename a super group
+  * @return The SG that was renamed (a copy if it was shared with a snapshot)
+  */
+  psupergroup_t set_sg_name(
+    psupergroup_t sg,
+    const char *name);
 
   /**
   * @brief Combine the list of NGL into a single NG
+  * @return The combined NG or NULL if the groups are not in this grouping
   */
   pnodegroup_t combine_ngl(pnodegroup_list_t ngl);
 
   /**
   * @brief Move nodes coming from various NGs to a single NG
   *        The new NG will reside in the first node's SG
+  * @return The new NG or NULL if none of the nodes is in this grouping
   */
   pnodegroup_t move_nodes_to_ng(pnodegroup_t ng);
 
@@ -367,6 +1922,26 @@ public:
   */
   void reset_groupping();
 
+  /**
+  * @brief Move a node group out of its SG into a new SG
+  * @return The new SG or NULL if the NG is the only one in its SG
+  */
+  psupergroup_t promote_nodegroup(
+    psupergroup_t sg,
+    pnodegroup_t ng);
+
+  /**
+  * @brief Move a node out of its NG into a new NG in the same SG
+  * @return The new NG or NULL if the node is alone in its NG
+  */
+  pnodegroup_t move_node_to_own_ng(pnodedef_t nd);
+
+  /**
+  * @brief Put all but the first node of an NG into their own NGs in the same SG
+  * @return The last node that was moved out or NULL
+  */
+  pnodedef_t split_nodegroup(pnodegroup_t ng);
+
   /**
   * @brief Find a node location by ID
   */
@@ -377,6 +1952,15 @@ public:
   */
   nodeloc_t *find_node_loc(ea_t ea);
 
+  /**
+  * @brief Find the locations of all the nodes overlapping [start, end)
+  * @return Count of found nodes
+  */
+  size_t find_node_locs(
+    ea_t start,
+    ea_t end,
+    nodeloc_vec_t *out);
+
   /**
   * @brief Returns one node definition from the data structure
   */
@@ -385,5 +1969,13 @@ public:
   void emit_sgl(
     FILE *fp,
     supergroup_listp_t* path_sgl);
+
+  void emit_sgl(
+    bufwriter_t *w,
+    supergroup_listp_t* path_sgl);
+
+  void emit_sgl(
+    bufwriter_t *w,
+    const gm_flat_t &view);
 };
 #endif
\ No newline at end of file
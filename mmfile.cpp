@@ -0,0 +1,133 @@
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Memory mapped file module
+
+--------------------------------------------------------------------------*/
+
+#ifdef __NT__
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+#include "mmfile.h"
+
+//--------------------------------------------------------------------------
+// Empty files cannot be mapped, they are served from this buffer
+static const char empty_file[1] = { 0 };
+
+//--------------------------------------------------------------------------
+mmfile_t::mmfile_t(): base(NULL), sz(0)
+{
+#ifdef __NT__
+  hfile = INVALID_HANDLE_VALUE;
+  hmap = NULL;
+#else
+  fd = -1;
+#endif
+}
+
+//--------------------------------------------------------------------------
+mmfile_t::~mmfile_t()
+{
+  close();
+}
+
+//--------------------------------------------------------------------------
+bool mmfile_t::open(const char *filename)
+{
+  close();
+
+#ifdef __NT__
+  hfile = CreateFileA(
+    filename,
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    NULL,
+    OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN,
+    NULL);
+  if (hfile == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fsize;
+  if (!GetFileSizeEx(hfile, &fsize) || uint64(fsize.QuadPart) > uint64(size_t(-1)))
+  {
+    close();
+    return false;
+  }
+  sz = size_t(fsize.QuadPart);
+  if (sz == 0)
+  {
+    base = empty_file;
+    return true;
+  }
+
+  hmap = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (hmap != NULL)
+    base = (const char *)MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0);
+#else
+  fd = ::open(filename, O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close();
+    return false;
+  }
+  sz = size_t(st.st_size);
+  if (sz == 0)
+  {
+    base = empty_file;
+    return true;
+  }
+
+  void *p = mmap(NULL, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p != MAP_FAILED)
+  {
+    base = (const char *)p;
+    madvise(p, sz, MADV_SEQUENTIAL);
+  }
+#endif
+
+  if (base == NULL)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+void mmfile_t::close()
+{
+#ifdef __NT__
+  if (base != NULL && base != empty_file)
+    UnmapViewOfFile(base);
+
+  if (hmap != NULL)
+    CloseHandle(hmap);
+
+  if (hfile != INVALID_HANDLE_VALUE)
+    CloseHandle(hfile);
+
+  hmap = NULL;
+  hfile = INVALID_HANDLE_VALUE;
+#else
+  if (base != NULL && base != empty_file)
+    munmap((void *)base, sz);
+
+  if (fd != -1)
+    ::close(fd);
+
+  fd = -1;
+#endif
+  base = NULL;
+  sz = 0;
+}
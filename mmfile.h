@@ -0,0 +1,68 @@
+#ifndef __MMFILE__
+#define __MMFILE__
+
+/*--------------------------------------------------------------------------
+GraphSlick (c) Elias Bachaalany
+-------------------------------------
+
+Memory mapped file module
+
+This module maps a whole file read-only in memory so it can be scanned
+in place without reading it through a stream
+
+--------------------------------------------------------------------------*/
+
+//--------------------------------------------------------------------------
+#include <pro.h>
+
+//--------------------------------------------------------------------------
+/**
+* @brief Read-only memory mapped file
+*/
+class mmfile_t
+{
+  const char *base;
+  size_t sz;
+
+#ifdef __NT__
+  void *hfile;
+  void *hmap;
+#else
+  int fd;
+#endif
+
+  // Not copyable
+  mmfile_t(const mmfile_t &);
+  mmfile_t &operator=(const mmfile_t &);
+
+public:
+  mmfile_t();
+  ~mmfile_t();
+
+  /**
+  * @brief Map the whole file
+  */
+  bool open(const char *filename);
+
+  /**
+  * @brief Unmap the file
+  */
+  void close();
+
+  /**
+  * @brief Is the file mapped?
+  */
+  inline bool is_open() const { return base != NULL; }
+
+  /**
+  * @brief Return the file contents (not NUL terminated)
+  */
+  inline const char *data() const { return base; }
+
+  /**
+  * @brief Return the file size
+  */
+  inline size_t size() const { return sz; }
+};
+
+#endif
@@ -104,6 +104,8 @@ TODO
 #include <prodir.h>
 
 #include "groupman.h"
+#include "bbgdb.h"
+#include "gmpub.h"
 #include "util.h"
 #include "algo.hpp"
 #include "colorgen.h"
@@ -143,6 +145,7 @@ enum gvrefresh_modes_e
   gvrfm_soft,
   gvrfm_single_mode,
   gvrfm_combined_mode,
+  gvrfm_hier_mode,
 };
 
 //--------------------------------------------------------------------------
@@ -300,6 +303,12 @@ public:
   */
   groupman_t *gm;
 
+  /**
+  * @brief Publisher of the groupings and the reader slot pinning 'gm'
+  */
+  gm_publisher_t *gm_pub;
+  int gm_slot;
+
   /**
   * @brief GraphSlick options
   */
@@ -316,6 +325,35 @@ private:
 
   gnodemap_t node_map;
   ng2nid_t ng2id;
+
+  /**
+  * @brief Weights of the combined graph edges
+  */
+  gedgemap_t edge_map;
+
+  /**
+  * @brief Combined node id of each flowchart node
+  */
+  std::vector<int> nid2gid;
+
+  /**
+  * @brief Level of each node of the hierarchical view and the groups
+  *        expanded in it
+  */
+  hier_nodes_t hier_nodes;
+  hier_expand_t hier_expand;
+
+  /**
+  * @brief Patch the combined graph with the last grouping edits on the
+  *        next refresh rather than rebuilding it
+  */
+  bool patch_pending;
+
+  /**
+  * @brief Disassembly text of the function blocks, kept across view modes
+  */
+  disasm_cache_t disasm_cache;
+
   qflow_chart_t *func_fc;
   gvrefresh_modes_e refresh_mode, cur_view_mode;
 
@@ -324,7 +362,8 @@ private:
   /**
   * @brief Menu item IDs
   */
-  int idm_single_view_mode, idm_combined_view_mode;
+  int idm_single_view_mode, idm_combined_view_mode, idm_hier_view_mode;
+  int idm_expand_node, idm_collapse_node;
 
   int idm_clear_sel, idm_clear_highlight, idm_select_all;
   int idm_merge_highlight_with_selection;
@@ -343,6 +382,8 @@ private:
 
   int idm_combine_ngs;
 
+  int idm_undo, idm_redo;
+
   int idm_show_options;
 
   bool in_sel_mode;
@@ -392,11 +433,53 @@ private:
       msg(STR_GS_MSG "Unknown mode\n");
   }
 
+  /**
+  * @brief Check that the grouping can be edited from the current view
+  */
+  bool check_edit_view_mode()
+  {
+    if (cur_view_mode == gvrfm_hier_mode)
+    {
+      msg(STR_GS_MSG "Only the single and combined view modes are supported\n");
+      return false;
+    }
+    return true;
+  }
+
+  /**
+  * @brief Check that the pinned grouping can be changed in place: it must
+  *        still be the published one (see gm_publisher_t::can_edit())
+  */
+  bool check_edit_grouping()
+  {
+    if (!gm_pub->can_edit(gm))
+    {
+      msg(STR_GS_MSG "The grouping was replaced, refresh the view before editing it\n");
+      return false;
+    }
+    return true;
+  }
+
   /**
   * @brief Menu items handler
   */
   void on_menu(int menu_id)
   {
+    //
+    // Edits change the pinned grouping in place
+    //
+    if (   (   menu_id == idm_edit_sg_desc
+            || menu_id == idm_combine_ngs
+            || menu_id == idm_remove_nodes_from_group
+            || menu_id == idm_promote_node_groups
+            || menu_id == idm_reset_groupping
+            || menu_id == idm_undo
+            || menu_id == idm_redo)
+        && !check_edit_grouping())
+    {
+      return;
+    }
+
     //
     // Clear selection
     //
@@ -441,6 +524,20 @@ private:
       redo_layout(gvrfm_combined_mode);
     }
     //
+    // Switch to hierarchical view mode
+    //
+    else if (menu_id == idm_hier_view_mode)
+    {
+      redo_layout(gvrfm_hier_mode);
+    }
+    //
+    // Expand / collapse the current node of the hierarchical view
+    //
+    else if (menu_id == idm_expand_node || menu_id == idm_collapse_node)
+    {
+      expand_hier_node(cur_node, menu_id == idm_expand_node);
+    }
+    //
     // Show the options dialog
     //
     else if (menu_id == idm_show_options)
@@ -519,7 +616,8 @@ private:
         msg(STR_GS_MSG "Not enough selected nodes\n");
         return;
       }
-      combine_node_groups();
+      if (check_edit_view_mode())
+        combine_node_groups();
     }
     //
     // Jump to next selected node
@@ -540,7 +638,8 @@ private:
     //
     else if (menu_id == idm_remove_nodes_from_group)
     {
-      move_nodes_to_own_ng();
+      if (check_edit_view_mode())
+        move_nodes_to_own_ng();
     }
     //
     // Merge highlight with selection
@@ -554,7 +653,8 @@ private:
     //
     else if (menu_id == idm_promote_node_groups)
     {
-      promote_node_groups_to_sgs();
+      if (check_edit_view_mode())
+        promote_node_groups_to_sgs();
     }
     //
     // Reset groupping
@@ -562,6 +662,7 @@ private:
     else if (menu_id == idm_reset_groupping)
     {
       gm->reset_groupping();
+      report_journal("Reset groupping");
 
       // Refresh the chooser
       actions->notify_refresh(true);
@@ -570,6 +671,13 @@ private:
       redo_current_layout();
     }
     //
+    // Undo / redo the last groupping edit
+    //
+    else if (menu_id == idm_undo || menu_id == idm_redo)
+    {
+      undo_redo(menu_id == idm_redo);
+    }
+    //
     // Test: interactive groupping
     //
     else if (menu_id == idm_test)
@@ -655,6 +763,28 @@ private:
         break;
       }
 
+      //
+      // A graph item was double clicked
+      //
+      case grcode_dblclicked:
+      {
+        va_arg(va, graph_viewer_t *);
+        selection_item_t *item = va_arg(va, selection_item_t *);
+
+        // Expand the groups of the hierarchical view in place
+        if (    cur_view_mode == gvrfm_hier_mode
+             && item != NULL 
+             && item->is_node
+             && expand_hier_node(item->node, true) )
+        {
+          // Ignore the click
+          result = 1;
+          break;
+        }
+        result = 0;
+        break;
+      }
+
       //
       // A group is being created
       //
@@ -705,7 +835,22 @@ private:
       case grcode_user_refresh:
       {
         mutable_graph_t *mg = va_arg(va, mutable_graph_t *);
-        if (node_map.empty() || refresh_mode != gvrfm_soft)
+
+        // Pick up a grouping published since the last refresh
+        bool repinned = pin_grouping();
+        if (repinned && refresh_mode == gvrfm_soft)
+          refresh_mode = cur_view_mode;
+
+        // Only patch the nodes the grouping edits changed
+        bool patched =    patch_pending
+                       && !repinned
+                       && !node_map.empty()
+                       && refresh_mode == gvrfm_combined_mode
+                       && cur_view_mode == gvrfm_combined_mode
+                       && patch_combined_view(mg);
+        patch_pending = false;
+
+        if (!patched && (node_map.empty() || refresh_mode != gvrfm_soft))
         {
           // Clear previous graph node data
           mg->clear();
@@ -725,10 +870,20 @@ private:
             switch_to_single_view_mode(mg);
           else if (refresh_mode == gvrfm_combined_mode)
             switch_to_combined_view_mode(mg);
+          else if (refresh_mode == gvrfm_hier_mode)
+            switch_to_hier_view_mode(mg);
           else
             msg_unk_mode();
         }
+
+        uint64 t0 = get_nsec_stamp();
         mg->redo_layout();
+        if (options->debug)
+        {
+          msg(STR_GS_MSG "Layout of %d nodes: %u ms\n",
+            mg->size(),
+            uint32((get_nsec_stamp() - t0) / 1000000));
+        }
         result = 1;
         break;
       }
@@ -751,7 +906,7 @@ private:
           break;
         }
 
-        *text = gnode->text.c_str();
+        *text = get_gnode_text(gnode, &disasm_cache).c_str();
 
         // Caller requested a bgcolor?
         if (bgcolor != NULL) do
@@ -779,18 +934,31 @@ private:
       {
         va_arg(va, mutable_graph_t *);
         int mousenode = va_arg(va, int);
-        va_arg(va, int); // mouseedge_src
-        va_arg(va, int); // mouseedge_dst
+        int mouseedge_src = va_arg(va, int);
+        int mouseedge_dst = va_arg(va, int);
         char **hint = va_arg(va, char **);
 
+        // Tell how many flowchart edges a combined edge stands for
+        int weight;
+        if (    mousenode == -1
+             && cur_view_mode != gvrfm_single_mode
+             && (weight = edge_map.get_weight(mouseedge_src, mouseedge_dst)) > 1 )
+        {
+          qstring s;
+          s.sprnt("%d edges", weight);
+          *hint = qstrdup(s.c_str());
+          result = 1;
+          break;
+        }
+
         // Get node data, aim for 'hint' field then 'text'
         gnode_t *node_data;
         if (     mousenode != -1
              && (node_data = get_node(mousenode)) != NULL )
         {
-          qstring *s = &node_data->hint;
+          const qstring *s = &get_gnode_hint(node_data, &disasm_cache);
           if (s->empty())
-            s = &node_data->text;
+            s = &get_gnode_text(node_data, &disasm_cache);
 
           // 'hint' must be allocated by qalloc() or qstrdup()
           *hint = qstrdup(s->c_str());
@@ -811,6 +979,9 @@ private:
 
         actions->notify_close();
 
+        // Let the publisher delete the grouping
+        gm_pub->unregister_reader(gm_slot);
+
         delete this;
         break;
       }
@@ -826,7 +997,18 @@ private:
     // Clear node information
     node_map.clear();
     ng2id.clear();
+    edge_map.clear();
+    nid2gid.clear();
+    hier_nodes.clear();
 
+    reset_marks();
+  }
+
+  /**
+  * @brief Clear the selected and highlighted nodes
+  */
+  void reset_marks()
+  {
     // Clear highlight / selected
     highlighted_nodes.clear();
     selected_nodes.clear();
@@ -874,6 +1056,10 @@ public:
     if (cur_view_mode == gvrfm_single_mode)
       return nid;
 
+    // The node is shown by its SG, its NG or itself
+    if (cur_view_mode == gvrfm_hier_mode)
+      return nid >= 0 && nid < int(nid2gid.size()) ? nid2gid[nid] : -1;
+
     nodeloc_t *loc = gm->find_nodeid_loc(nid);
     // Get the other selected NG
     if (loc == NULL)
@@ -939,6 +1125,12 @@ public:
         pnodedef_t nd = ng->get_first_node();
         return nd == NULL ? -1 : nd->nid;
       }
+      else if (cur_view_mode == gvrfm_hier_mode)
+      {
+        // The node showing the first node definition
+        pnodedef_t nd = ng->get_first_node();
+        return nd == NULL ? -1 : get_gvnid_from_nid(nd->nid);
+      }
     }
     if (options->debug)
       msg(STR_GS_MSG "Could not find gr_nid for %p\n", ng);
@@ -1020,6 +1212,23 @@ public:
         highlighted_nodes[nid] = clr;
       }
     }
+    // Hierarchical mode? Highlight the nodes showing the NG's nodes
+    else if (cur_view_mode == gvrfm_hier_mode)
+    {
+      for (nodegroup_t::iterator it = ng->begin();
+           it != ng->end();
+           ++it)
+      {
+        int gr_nid = get_gvnid_from_nid((*it)->nid);
+        if (gr_nid == -1)
+          continue;
+
+        if (delay_refresh)
+          newly_colored.insert(gr_nid);
+
+        highlighted_nodes[gr_nid] = clr;
+      }
+    }
     // Unknown mode
     else
     {
@@ -1099,20 +1308,18 @@ public:
   }
 
   /**
-  * @brief Selects all set of super groups
+  * @brief Selects all the super groups of a flat view
   */
   void highlight_nodes(
-    psupergroup_listp_t groups,
+    const gm_flat_t *flat,
     colorgen_t &cg,
     bool delay_refresh)
   {
     colorvargen_t cv;
-    for (supergroup_listp_t::iterator it=groups->begin();
-         it != groups->end();
-         ++it)
+    for (size_t i=0; i < flat->sg_count(); i++)
     {
       // Get the super group
-      psupergroup_t sg = *it;
+      psupergroup_t sg = flat->sgs[i];
 
       // - Super group is synthetic?
       // - User does not want us to color such sgs?
@@ -1125,19 +1332,25 @@ public:
 
       // Assign a new color variant for each group
       cg.get_colorvar(cv);
-      for (nodegroup_list_t::iterator it=sg->groups.begin();
-           it != sg->groups.end();
-           ++it)
+      for (uint32 j=flat->ng_begin(i); j < flat->ng_end(i); j++)
       {
         // Use a new color variant for each group
         bgcolor_t clr = cg.get_color_anyway(cv);
-        pnodegroup_t ng = *it;
 
-        // Always call with lazy mode in the inner loop
-        highlight_nodes(
-            ng,
-            clr,
-            true);
+        // Combined mode (one node per group) or debug output
+        if (cur_view_mode != gvrfm_single_mode || options->debug)
+        {
+          // Always call with lazy mode in the inner loop
+          highlight_nodes(
+              flat->ngs[j],
+              clr,
+              true);
+          continue;
+        }
+
+        // Single mode: take the node ids from the view
+        for (uint32 k=flat->nd_begin(j); k < flat->nd_end(j); k++)
+          highlighted_nodes[flat->nids[k]] = clr;
       }
     }
 
@@ -1313,11 +1526,59 @@ public:
     ++it;
   }
 
+  /**
+  * @brief Report an edit and the memory used by the undo journal
+  */
+  void report_journal(const char *what)
+  {
+    if (!options->debug)
+      return;
+
+    gm_journal_stats_t st;
+    gm->get_journal_stats(&st);
+    msg(STR_GS_MSG "%s. Journal: %u undo, %u redo, %u/%u KB, %u dropped\n",
+      what,
+      uint32(st.undo_count),
+      uint32(st.redo_count),
+      uint32(st.bytes / 1024),
+      uint32(st.limit / 1024),
+      uint32(st.dropped));
+  }
+
+  /**
+  * @brief Undo or redo the last groupping edit
+  */
+  void undo_redo(bool redo)
+  {
+    const char *desc = redo ? gm->get_redo_desc() : gm->get_undo_desc();
+    if (desc == NULL)
+    {
+      msg(STR_GS_MSG "Nothing to %s\n", redo ? "redo" : "undo");
+      return;
+    }
+
+    qstring what;
+    what.sprnt("%s '%s'", redo ? "Redo" : "Undo", desc);
+    if (redo ? !gm->redo() : !gm->undo())
+      return;
+
+    report_journal(what.c_str());
+
+    // Refresh the chooser
+    actions->notify_refresh(true);
+
+    // Re-layout
+    update_current_layout();
+  }
+
   /**
   * @brief Combine node groups
   */
   void combine_node_groups()
   {
+    // Undo the combination and the naming at once
+    gm->begin_edit("Combine nodes");
+
     pnodegroup_t new_ng = NULL;
     if (cur_view_mode == gvrfm_combined_mode)
     {
@@ -1336,6 +1597,8 @@ public:
 
       // Combine the selected NGLs
       new_ng = gm->combine_ngl(&ngl);
+      if (new_ng == NULL)
+        msg(STR_GS_MSG "Failed to combine the selected groups!\n");
     }
     else if (cur_view_mode == gvrfm_single_mode)
     {
@@ -1368,11 +1631,14 @@ public:
         focus_node = nd->nid;
     }
 
+    gm->end_edit();
+    report_journal("Combine nodes");
+
     // Refresh the chooser
     actions->notify_refresh(true);
 
     // Re-layout
-    redo_current_layout();
+    update_current_layout();
   }
 
   /**
@@ -1415,6 +1681,7 @@ public:
     }
 
     // Now we have the NGs and their corresponding SGs
+    gm->begin_edit("Promote node groups");
     while (!found_ng.empty())
     {
       // Take the first value set
@@ -1424,30 +1691,22 @@ public:
       // Remove first element
       found_ng.erase(found_ng.begin());
 
-      // SG has one NG? Most likely this is the same SG and NG, leave alone
-      if (sg->gcount() == 1)
+      // Move the NG to a new SG
+      psupergroup_t new_sg = gm->promote_nodegroup(sg, ng);
+      if (new_sg == NULL)
         continue;
 
-      // Remove NG from the current SG
-      sg->remove_nodegroup(ng, false);
-
-      // Make a new SG
-      psupergroup_t new_sg = gm->add_supergroup(gm->get_path_sgl());
-      new_sg->copy_attr_from(sg);
-      new_sg->add_nodegroup(ng);
-
       // Allow the user to edit the new SG
       edit_sg_description(new_sg);
     }
-
-    // Reinitialize lookup tables
-    gm->initialize_lookups();
+    gm->end_edit();
+    report_journal("Promote node groups");
 
     // Refresh the chooser; no need to re-do layout though
     actions->notify_refresh(true);
 
     // Re-layout
-    redo_current_layout();
+    update_current_layout();
   }
 
   /**
@@ -1464,6 +1723,7 @@ public:
 
     //TODO: VERIFY: When find similar is applied, then this should work too
 
+    gm->begin_edit("Move nodes to their own group");
     if (cur_view_mode == gvrfm_single_mode)
     {
       // For each ND, directly take it out from its parent NG and put it in its own NG in the same SG
@@ -1476,20 +1736,16 @@ public:
         if (loc == NULL)
         {
           msg_err_node_not_found();
+          gm->end_edit();
           return;
         }
-        // This node is the only one in the NG
-        if (loc->ng->size() == 1)
+        // Now move the node out to a new node group in the same SG
+        pnodedef_t nd = loc->nd;
+        if (gm->move_node_to_own_ng(nd) == NULL)
           continue;
 
-        // Now move the node out
-        loc->ng->remove(loc->nd);
-
-        // Create a new node group in the SG and add the node to it
-        loc->sg->add_nodegroup()->add_node(loc->nd);
-
         // Remember a focus node
-        focus_node = loc->nd->nid;
+        focus_node = nd->nid;
       }
     }
     else if (cur_view_mode == gvrfm_combined_mode)
@@ -1505,39 +1761,22 @@ public:
         if (ng == NULL || ng->size() == 1)
           continue;
 
-        // Get any first node (to determine SG)
-        pnodedef_t nd = ng->get_first_node();
-        if (nd == NULL)
-          continue;
-
-        // Get the loc -> SG
-        nodeloc_t *loc = gm->find_nodeid_loc(nd->nid);
-        psupergroup_t sg = loc->sg;
-        if (sg == NULL)
-          continue;
-
         // Take out each ND in this NG
-        while (ng->size() > 1)
-        {
-          nd = ng->back();
-          ng->pop_back();
-
-          sg->add_nodegroup()->add_node(nd);
+        pnodedef_t nd = gm->split_nodegroup(ng);
 
-          // Remember a focus node
+        // Remember a focus node
+        if (nd != NULL)
           focus_node = nd->nid;
-        }
       }
     }
-
-    // Reinitialize lookup tables
-    gm->initialize_lookups();
+    gm->end_edit();
+    report_journal("Move nodes to their own group");
 
     // Refresh the chooser; no need to re-do layout though
     actions->notify_refresh(true);
 
     // Re-layout
-    redo_current_layout();
+    update_current_layout();
   }
 
   /**
@@ -1568,8 +1807,8 @@ public:
       break;
     }
 
-    // Adjust the name
-    sg->name = desc;
+    // Adjust the name (it can be undone)
+    sg = gm->set_sg_name(sg, desc);
 
     // From the super group, get all individual node groups
     for (nodegroup_list_t::iterator it=sg->groups.begin();
@@ -1590,6 +1829,8 @@ public:
       // TODO: PERFORMANCE: can you have gnode link to a groupman related structure and pull its
       //                    text dynamically?
       gnode->text = sg->get_display_name();
+      gnode->text_pending = false;
+      gnode->text_gen = 0;
     }
 
     if (!options->manual_refresh_mode)
@@ -1619,15 +1860,118 @@ public:
   void switch_to_combined_view_mode(mutable_graph_t *mg)
   {
     msg(STR_GS_MSG "Switching to combined mode view...");
+
+    // The graph is built from the whole grouping
+    gm->take_changes(NULL);
+
     fc_to_combined_mg(
       BADADDR,
       gm,
       node_map,
       ng2id,
       mg,
-      func_fc);
+      func_fc,
+      &edge_map,
+      &nid2gid);
 
-    msg("done\n");
+    msg("done: %u edges, %u parallel edges merged\n",
+      uint32(edge_map.size()),
+      uint32(edge_map.get_merged_count()));
+  }
+
+  /**
+  * @brief Switch to the hierarchical view mode
+  */
+  void switch_to_hier_view_mode(mutable_graph_t *mg)
+  {
+    msg(STR_GS_MSG "Switching to hierarchical mode view...");
+
+    // Edits made in the other modes are covered by the rebuild
+    gm->take_changes(NULL);
+
+    if (!fc_to_hier_mg(
+          gm,
+          hier_expand,
+          node_map,
+          hier_nodes,
+          edge_map,
+          nid2gid,
+          mg,
+          func_fc))
+    {
+      msg("failed: the groupping does not cover the function\n");
+      return;
+    }
+
+    msg("done: %u nodes, %u edges\n",
+      uint32(hier_nodes.size()),
+      uint32(edge_map.size()));
+  }
+
+  /**
+  * @brief Expand or collapse a node of the hierarchical view in place
+  * @return False if the node could not be changed
+  */
+  bool expand_hier_node(int gid, bool expand)
+  {
+    if (cur_view_mode != gvrfm_hier_mode)
+    {
+      msg(STR_GS_MSG "Only supported in the hierarchical view mode\n");
+      return false;
+    }
+    if (gid < 0 || gid >= int(hier_nodes.size()))
+    {
+      msg(STR_GS_MSG "No node is selected\n");
+      return false;
+    }
+
+    const hier_node_t &hn = hier_nodes[gid];
+    bool ok = expand ? hier_expand.expand(hn) : hier_expand.collapse(gm, hn);
+    if (!ok)
+      return false;
+
+    // Keep the node's region in view once rebuilt
+    focus_node = hn.nid;
+    redo_current_layout();
+
+    return true;
+  }
+
+  /**
+  * @brief Patch the combined graph with the last grouping edits
+  * @return False if it must be rebuilt instead
+  */
+  bool patch_combined_view(mutable_graph_t *mg)
+  {
+    std::vector<int> changed;
+    if (!gm->take_changes(&changed))
+      return false;
+
+    uint64 t0 = get_nsec_stamp();
+    if (!update_combined_mg(
+          gm,
+          changed,
+          node_map,
+          ng2id,
+          edge_map,
+          nid2gid,
+          mg,
+          func_fc))
+    {
+      return false;
+    }
+
+    // The ids of the marked nodes may have been given to other nodes
+    reset_marks();
+
+    if (options->debug)
+    {
+      msg(STR_GS_MSG "Patched %u changed nodes: %d combined nodes, %u ms\n",
+        uint32(changed.size()),
+        mg->size(),
+        uint32((get_nsec_stamp() - t0) / 1000000));
+    }
+    return true;
   }
 
   /**
@@ -1727,6 +2071,16 @@ public:
     redo_layout(cur_view_mode);
   }
 
+  /**
+  * @brief Redo the current layout after grouping edits, patching the
+  *        combined graph rather than rebuilding it
+  */
+  inline void update_current_layout()
+  {
+    patch_pending = true;
+    redo_current_layout();
+  }
+
   /**
   * @brief Set the actions variable
   */
@@ -1740,9 +2094,13 @@ public:
   */
   static gsgraphview_t *show_graph(
     qflow_chart_t *func_fc,
-    groupman_t *gm,
+    gm_publisher_t *gm_pub,
     gsoptions_t *options)
   {
+    int gm_slot = gm_pub->register_reader();
+    if (gm_slot == -1)
+      return NULL;
+
     // Loop twice:
     // - (1) Create the graph and exit or close it if it was there
     // - (2) Re create graph due to last step
@@ -1761,8 +2119,10 @@ public:
         // Create a graph object
         gsgraphview_t *gsgv = new gsgraphview_t(func_fc, options);
 
-        // Assign the groupmanager instance
-        gsgv->gm = gm;
+        // Render the current grouping until a new one is published
+        gsgv->gm_pub = gm_pub;
+        gsgv->gm_slot = gm_slot;
+        gsgv->pin_grouping();
 
         // Create the graph control
         graph_viewer_t *gv = create_graph_viewer(
@@ -1783,9 +2143,25 @@ public:
         close_tform(form, 0);
       }
     }
+    gm_pub->unregister_reader(gm_slot);
     return NULL;
   }
 
+  /**
+  * @brief Pin the current published grouping, releasing the previous one
+  * @return True if the grouping changed
+  */
+  bool pin_grouping()
+  {
+    if (gm_pub->peek() == gm)
+      return false;
+
+    if (gm != NULL)
+      gm_pub->read_unlock(gm_slot);
+    gm = gm_pub->read_lock(gm_slot);
+    return true;
+  }
+
   /**
   * @brief Initialize the graph view
   */
@@ -1820,6 +2196,9 @@ public:
     idm_change_graph_layout           = add_menu("Change graph layout");
     idm_single_view_mode              = add_menu("Switch to ungroupped view",       "U");
     idm_combined_view_mode            = add_menu("Switch to groupped view",         "G");
+    idm_hier_view_mode                = add_menu("Switch to hierarchical view",     "L");
+    idm_expand_node                   = add_menu("Expand group",                    "X");
+    idm_collapse_node                 = add_menu("Collapse group",                  "W");
 
     // Experimental actions
 #ifndef PUBLIC
@@ -1834,6 +2213,8 @@ public:
     //
     // Groupping actions
     idm_combine_ngs                   = add_menu("Combine nodes",                   "C");
+    idm_undo                          = add_menu("Undo groupping edit",             "Z");
+    idm_redo                          = add_menu("Redo groupping edit",             "Y");
 #ifndef PUBLIC
     idm_remove_nodes_from_group       = add_menu("Move node(s) to their own group", "R");
     idm_promote_node_groups           = add_menu("Promote node group",              "P");
@@ -1859,6 +2240,9 @@ public:
       options(options),
       idm_single_view_mode(-1),
       idm_combined_view_mode(-1),
+      idm_hier_view_mode(-1),
+      idm_expand_node(-1),
+      idm_collapse_node(-1),
       idm_clear_sel(-1),
       idm_clear_highlight(-1),
       idm_select_all(-1),
@@ -1875,16 +2259,22 @@ public:
       idm_highlight_similar(-1),
       idm_find_highlight(-1),
       idm_combine_ngs(-1),
+      idm_undo(-1),
+      idm_redo(-1),
       idm_show_options(-1)
   {
     gv = NULL;
     form = NULL;
+    gm = NULL;
+    gm_pub = NULL;
+    gm_slot = -1;
     refresh_mode = options->start_view_mode;
     set_callback(NULL);
 
     focus_node = -1;
     in_sel_mode = false;
     cur_node = -1;
+    patch_pending = false;
     idm_set_sel_mode = -1;
     idm_edit_sg_desc = -1;
   }
@@ -1916,6 +2306,12 @@ public:
   pnodegroup_t ng;
   pnodegroup_list_t ngl;
 
+  /**
+  * @brief Cached text of the columns
+  */
+  qstring desc[2];
+  bool has_desc;
+
   /**
   * @brief Constructor
   */
@@ -1925,6 +2321,7 @@ public:
     sg = NULL;
     ng = NULL;
     ngl = NULL;
+    has_desc = false;
   }
 };
 typedef qvector<gschooser_line_t> chooser_lines_vec_t;
@@ -1944,6 +2341,13 @@ private:
   groupman_t *gm;
   qstring last_loaded_file;
 
+  /**
+  * @brief Publisher of the groupings. The chooser pins the current one
+  *        with its reader slot and changes it in place from the UI thread
+  */
+  gm_publisher_t gm_pub;
+  int gm_slot;
+
   qflow_chart_t func_fc;
   gsoptions_t options;
 
@@ -2023,6 +2427,43 @@ private:
     return n;
   }
 
+  static uint32 idaapi s_onmenu_show_mem(void *obj, uint32 n)
+  {
+    ((gschooser_t *)obj)->onmenu_show_mem();
+    return n;
+  }
+
+  /**
+  * @brief Handle the memory usage menu command
+  */
+  void onmenu_show_mem()
+  {
+    if (gm == NULL)
+      return;
+
+    gm_mem_stats_t st;
+    gm->get_mem_stats(&st);
+
+    msg(STR_GS_MSG "Memory usage: SGs=%u NGs=%u NDs=%u retired versions=%u%s\n",
+      uint32(st.sg_count),
+      uint32(st.ng_count),
+      uint32(st.nd_count),
+      uint32(gm_pub.get_retired_count()),
+      st.shared ? " (arena shared with snapshots)" : "");
+
+    for (int i=0; i < gm_mem_count; i++)
+    {
+      msg("  %-14s %10" FMT_64 "u bytes, peak %10" FMT_64 "u\n",
+        gm_mem_stats_t::get_category_name(gm_mem_category_e(i)),
+        uint64(st.bytes[i]),
+        uint64(st.peak[i]));
+    }
+    msg("  %-14s %10" FMT_64 "u bytes, peak %10" FMT_64 "u\n",
+      "total",
+      uint64(st.total),
+      uint64(st.peak_total));
+  }
+
   /**
   * @brief Handle the save bbgroup menu command
   */
@@ -2036,7 +2477,7 @@ private:
     if (filename == NULL || gm == NULL)
       return;
 
-    gm->emit(filename);
+    save_file(filename);
   }
 
   /**
@@ -2154,12 +2595,19 @@ private:
       // Handle super groups
       case chlt_sg:
       {
+        const gm_stats_t &st = node->sg->get_stats();
         if (col == 1)
         {
-          out->sprnt(MY_TABSTR "%s (%s) C(%d)",
+          out->sprnt(MY_TABSTR "%s (%s) C(%d) N(%d) B(%" FMT_64 "u)",
             node->sg->name.c_str(),
             node->sg->id.c_str(),
-            node->sg->gcount());
+            node->sg->gcount(),
+            int(st.node_count),
+            st.bytes);
+        }
+        else if (col == 2 && st.node_count != 0)
+        {
+          out->sprnt("%a-%a", st.min_ea, st.max_ea);
         }
         break;
       }
@@ -2170,8 +2618,8 @@ private:
 
         if (col == 1)
         {
-          size_t sz = groups->size();
-          out->sprnt(MY_TABSTR MY_TABSTR "C(%d):(", sz);
+          size_t sz = groups->get_stats().node_count;
+          out->sprnt(MY_TABSTR MY_TABSTR "C(%d):(", int(sz));
           for (nodegroup_t::iterator it=groups->begin();
                 it != groups->end();
                 ++it)
@@ -2236,13 +2684,15 @@ private:
 
       gschooser_line_t &cn = ch_nodes[n];
 
-      qstring desc;
-      get_node_desc(&cn, &desc, 1);
-      qstrncpy(arrptr[0], desc.c_str(), MAXSTR);
-
-      desc.qclear();
-      get_node_desc(&cn, &desc, 2);
-      qstrncpy(arrptr[1], desc.c_str(), MAXSTR);
+      // The chooser asks for the visible lines on each repaint
+      if (!cn.has_desc)
+      {
+        get_node_desc(&cn, &cn.desc[0], 1);
+        get_node_desc(&cn, &cn.desc[1], 2);
+        cn.has_desc = true;
+      }
+      qstrncpy(arrptr[0], cn.desc[0].c_str(), MAXSTR);
+      qstrncpy(arrptr[1], cn.desc[1].c_str(), MAXSTR);
     }
   }
 
@@ -2335,12 +2785,9 @@ private:
       //
       case chlt_gm:
       {
-        // Get all super groups
-        psupergroup_listp_t sgroups = gm->get_path_sgl();
-
-        // Mark them for selection
+        // Mark all the super groups for selection
         gsgv->highlight_nodes(
-            sgroups,
+            gm->get_flat(),
             cg,
             true);
 
@@ -2395,8 +2842,8 @@ private:
     // Close the associated graph
     close_graph();
 
-    // Delete the group manager
-    delete gm;
+    // The group managers are deleted with the publisher
+    gm_pub.unregister_reader(gm_slot);
     gm = NULL;
 
     delete_singleton();
@@ -2408,7 +2855,20 @@ private:
   void refresh(bool populate_lines)
   {
     if (populate_lines)
+    {
       populate_chooser_lines();
+    }
+    else
+    {
+      // Names or groupings may have changed
+      for (size_t i=0; i < ch_nodes.size(); i++)
+      {
+        gschooser_line_t &cn = ch_nodes[i];
+        cn.has_desc = false;
+        cn.desc[0].qclear();
+        cn.desc[1].qclear();
+      }
+    }
 
     refresh_chooser(TITLE_GS_PANEL);
   }
@@ -2432,7 +2892,7 @@ private:
     // Show the graph
     gsgv = gsgraphview_t::show_graph(
       &func_fc,
-      gm,
+      &gm_pub,
       &options);
     if (gsgv == NULL)
       return false;
@@ -2532,39 +2992,37 @@ private:
 	// TODO: add option to show similar_sgs
     ch_nodes.clear();
 
+    // Walk the flat view rather than the lists
+    const gm_flat_t *flat = gm->get_flat();
+    ch_nodes.reserve(1 + flat->sg_count() + flat->ng_count());
+
     // Add the first-level node = bbgroup file
     gschooser_line_t *line = &ch_nodes.push_back();
     line->type = chlt_gm;
     line->gm = gm;
 
-    psupergroup_listp_t sgroups = gm->get_path_sgl();
-    for (supergroup_listp_t::iterator it=sgroups->begin();
-         it != sgroups->end();
-         ++it)
+    for (size_t i=0; i < flat->sg_count(); i++)
     {
-      supergroup_t &sg = **it;
+      psupergroup_t sg = flat->sgs[i];
 
       // Add the second-level node = a set of group defs
       line = &ch_nodes.push_back();
-      nodegroup_list_t &ngl = sg.groups;
+      nodegroup_list_t &ngl = sg->groups;
       line->type = chlt_sg;
       line->gm   = gm;
-      line->sg   = &sg;
+      line->sg   = sg;
       line->ngl  = &ngl;
 
       // Add each nodedef list within each node group
-      for (nodegroup_list_t::iterator it = ngl.begin();
-           it != ngl.end();
-           ++it)
+      for (uint32 j=flat->ng_begin(i); j < flat->ng_end(i); j++)
       {
-        pnodegroup_t ng = *it;
         // Add the third-level node = nodedef
         line = &ch_nodes.push_back();
         line->type = chlt_ng;
         line->gm   = gm;
-        line->sg   = &sg;
+        line->sg   = sg;
         line->ngl  = &ngl;
-        line->ng   = ng;
+        line->ng   = flat->ngs[j];
       }
     }
   }
@@ -2627,6 +3085,9 @@ private:
     add_menu("Show graph", s_onmenu_show_graph);
     add_menu("Analyze", s_onmenu_analyze);
     add_menu("Automatically find path", s_onmenu_auto_find_path);
+
+    if (options.debug)
+      add_menu("Show memory usage", s_onmenu_show_mem);
   }
 
   /**
@@ -2683,7 +3144,23 @@ public:
     gsgv = NULL;
     gm = NULL;
     py_matcher = NULL;
-    gm = new groupman_t();
+
+    // The views, the chooser and the loader all run in the UI thread:
+    // this lets the UI edit the published grouping in place
+    gm_pub.set_owner_thread();
+    gm_slot = gm_pub.register_reader();
+    gm_pub.publish(new groupman_t());
+    adopt_grouping();
+  }
+
+  /**
+  * @brief Pin the current published grouping, releasing the previous one
+  */
+  void adopt_grouping()
+  {
+    if (gm != NULL)
+      gm_pub.read_unlock(gm_slot);
+    gm = gm_pub.read_lock(gm_slot);
   }
 
   /**
@@ -2725,6 +3202,83 @@ public:
     close_tform(gsgv->form, 0);
   }
 
+  /**
+  * @brief Load the screen function's groups from a bbgroup database
+  */
+  bool load_db_function(
+      const char *filename, 
+      groupman_t *ngm)
+  {
+    func_t *f = get_func(get_screen_ea());
+    if (f == NULL)
+      return false;
+
+    bbgroup_db_t db;
+    if (!db.open(filename))
+      return false;
+
+    if (!db.load(f->startEA, ngm, false))
+    {
+      msg(STR_GS_MSG "No groups for function %a in '%s'\n", f->startEA, filename);
+      return false;
+    }
+
+    ngm->src_filename = filename;
+    return true;
+  }
+
+  /**
+  * @brief Show the inconsistencies found between a loaded file and the flowchart
+  */
+  void show_sanitize_report(sanitize_report_t &report)
+  {
+    if (report.empty())
+      return;
+
+    msg(STR_GS_MSG "The input file does not match the function's flowchart:");
+    for (int k=0; k < sanitize_issue_count; k++)
+    {
+      sanitize_issue_e kind = sanitize_issue_e(k);
+      if (report.counts[kind] != 0)
+        msg(" %s=%u", sanitize_report_t::get_kind_name(kind), uint32(report.counts[kind]));
+    }
+    msg("\n");
+
+    if (!options.debug)
+      return;
+
+    for (sanitize_issues_t::iterator it=report.issues.begin();
+         it != report.issues.end();
+         ++it)
+    {
+      sanitize_issue_t &issue = *it;
+      msg(STR_GS_MSG "  %s: node %d (%a-%a) in '%s', flowchart block %a-%a\n",
+        sanitize_report_t::get_kind_name(issue.kind),
+        issue.nid,
+        issue.nd->start,
+        issue.nd->end,
+        issue.sg->get_display_name(""),
+        issue.fc_start,
+        issue.fc_end);
+    }
+  }
+
+  /**
+  * @brief Show how a loaded file was carried over to the function's flowchart
+  */
+  void show_remap_report(gm_remap_report_t &report)
+  {
+    msg(STR_GS_MSG "The function changed since the file was saved. Nodes remapped:"
+      " kept=%u renumbered=%u resized=%u split=%u merged=%u dropped=%u new=%u\n",
+      uint32(report.kept),
+      uint32(report.renumbered),
+      uint32(report.resized),
+      uint32(report.split),
+      uint32(report.merged),
+      uint32(report.dropped),
+      uint32(report.added));
+  }
+
   /**
   * @brief Load the file bbgroup file into the chooser
   */
@@ -2736,7 +3290,11 @@ public:
       {
           // Load a file and parse it
           // (don't init cache yet because file may be optimized)
-          if (!ngm->parse(filename, false))
+          bool loaded = bbgroup_db_t::is_db_filename(filename) 
+            ? load_db_function(filename, ngm)
+            : ngm->parse(filename, false);
+
+          if (!loaded)
           {
               msg(STR_GS_MSG "Error: failed to parse group file '%s'\n", filename);
               break;
@@ -2761,18 +3319,38 @@ public:
           if (!get_flowchart(f->startEA))
               break;
 
+          // Follow the blocks if the function was analyzed again since
+          // the file was saved
+          groupman_t *rgm = new groupman_t();
+          gm_remap_report_t remap;
+          if (remap_groupman(BADADDR, ngm, rgm, &func_fc, &remap))
+          {
+              show_remap_report(remap);
+              delete ngm;
+              ngm = rgm;
+          }
+          else
+          {
+              delete rgm;
+          }
+
           // De-optimize the input file
-          if (sanitize_groupman(BADADDR, ngm, &func_fc))
+          sanitize_report_t report;
+          if (sanitize_groupman(BADADDR, ngm, &func_fc, &report))
           {
               // Now initialize the cache
               ngm->initialize_lookups();
           }
+          show_sanitize_report(report);
 
-          // Delete the previous group manager
-          delete gm;
+          // Record the groupping edits so they can be undone
+          ngm->set_journal(true);
 
-          // Assign new group manager
-          gm = ngm;
+          // Publish the new group manager. The previous one is deleted
+          // once the graph view stops rendering it
+          if (!gm_pub.publish(ngm))
+              break;
+          adopt_grouping();
 
           populate_chooser_lines();
 
@@ -2788,7 +3366,18 @@ public:
   */
   bool save_file(const char *filename)
   {
-    return gm->emit(filename);
+    // Do not leave a truncated file behind if the save fails
+    if (!bbgroup_db_t::is_db_filename(filename))
+      return gm->emit(filename, NULL, true);
+
+    // Store the groups of this function in the database
+    nodedef_t *nd = gm->get_first_nd();
+    func_t *f = nd == NULL ? NULL : get_func(nd->start);
+    if (f == NULL)
+      return false;
+
+    bbgroup_db_t db;
+    return db.open(filename, true) && db.store(f->startEA, gm);
   }
 
   /**
@@ -2855,12 +3444,18 @@ void idaapi run(int /*arg*/)
 //--------------------------------------------------------------------------
 int idaapi init(void)
 {
-  return is_ida_gui() ? PLUGIN_OK : PLUGIN_SKIP;
+  if (!is_ida_gui())
+    return PLUGIN_SKIP;
+
+  // Outdate the cached disassembly text when the database changes
+  hook_idb_changes();
+  return PLUGIN_OK;
 }
 
 //--------------------------------------------------------------------------
 void idaapi term(void)
 {
+  unhook_idb_changes();
 }
 
 //--------------------------------------------------------------------------
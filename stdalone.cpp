@@ -1,8 +1,3089 @@
+#include <time.h>
 #include "groupman.h"
+#include "bbgdb.h"
+#include "gmdiff.h"
+#include "gmhier.h"
+#include "gmpub.h"
+#include <thread>
+#include <set>
 
 //--------------------------------------------------------------------------
-int main()
+/**
+* @brief Returns a time stamp in milliseconds
+*/
+static double get_time_ms()
 {
+  return clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Deterministic pseudo random numbers for the benchmarks
+*/
+static uint32 bench_rand()
+{
+  static uint32 seed = 0x1234567;
+  seed = seed * 1103515245 + 12345;
+  return seed >> 1;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Build a synthetic groupman with 'count' adjacent nodes
+*/
+static void build_synthetic_gm(
+    groupman_t *gm,
+    int count,
+    int ng_size)
+{
+  gm->clear();
+
+  ea_t ea = 0x401000;
+  psupergroup_t sg = NULL;
+  pnodegroup_t ng = NULL;
+  for (int nid=0; nid < count; nid++)
+  {
+    if (nid % ng_size == 0)
+    {
+      sg = gm->add_supergroup();
+      sg->id.sprnt("ID_%d", nid);
+      ng = sg->add_nodegroup();
+    }
+    pnodedef_t nd = ng->add_node();
+    nd->nid = nid;
+    nd->start = ea;
+    nd->end = ea + 0x10 + (nid % 7) * 4;
+    ea = nd->end;
+
+    gm->map_nodedef(nid, nd);
+  }
+  gm->initialize_lookups();
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark address to node lookups: linear scan vs. address index
+*/
+static void bench_addr_lookup(int count)
+{
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 4);
+
+  nid2ndef_t *nds = gm.get_nds();
+  ea_t lo = nds->begin()->second->start;
+  ea_t hi = nds->rbegin()->second->end;
+
+  std::vector<ea_t> queries;
+  for (int i=0; i < 20000; i++)
+    queries.push_back(lo + bench_rand() % (hi - lo));
+
+  // Linear scan, as the lookup used to be done
+  double t0 = get_time_ms();
+  int linear_sum = 0;
+  for (size_t i=0; i < queries.size(); i++)
+  {
+    ea_t ea = queries[i];
+    for (nid2ndef_t::iterator it=nds->begin(); it != nds->end(); ++it)
+    {
+      pnodedef_t nd = it->second;
+      if (ea >= nd->start && ea < nd->end)
+      {
+        linear_sum += nd->nid;
+        break;
+      }
+    }
+  }
+  double t_linear = get_time_ms() - t0;
+
+  // Address index
+  t0 = get_time_ms();
+  int index_sum = 0;
+  for (size_t i=0; i < queries.size(); i++)
+  {
+    nodeloc_t *loc = gm.find_node_loc(queries[i]);
+    if (loc != NULL)
+      index_sum += loc->nd->nid;
+  }
+  double t_index = get_time_ms() - t0;
+
+  // Range queries
+  t0 = get_time_ms();
+  size_t range_hits = 0;
+  nodeloc_vec_t locs;
+  for (size_t i=0; i < queries.size(); i++)
+  {
+    locs.clear();
+    range_hits += gm.find_node_locs(queries[i], queries[i] + 0x100, &locs);
+  }
+  double t_range = get_time_ms() - t0;
+
+  printf("addr_lookup: nodes=%d queries=%d linear=%.2fms index=%.2fms range=%.2fms (%d hits) %s\n",
+    count,
+    int(queries.size()),
+    t_linear,
+    t_index,
+    t_range,
+    int(range_hits),
+    linear_sum == index_sum ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Add a node of its own SG to a groupman
+*/
+static void add_addr_node(groupman_t *gm, int nid, ea_t start, ea_t end)
+{
+  psupergroup_t sg = gm->add_supergroup();
+  sg->id.sprnt("ID_%d", nid);
+  pnodedef_t nd = sg->add_nodegroup()->add_node();
+  nd->nid = nid;
+  nd->start = start;
+  nd->end = end;
+  gm->map_nodedef(nid, nd);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Return the node found at an address, -1 if none
+*/
+static int find_addr_nid(groupman_t *gm, ea_t ea)
+{
+  nodeloc_t *loc = gm->find_node_loc(ea);
+  return loc == NULL ? -1 : loc->nd->nid;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the nodes found in a range are the expected ones, in order
+*/
+static bool check_addr_range(
+    groupman_t *gm,
+    ea_t start,
+    ea_t end,
+    const int *nids,
+    size_t count)
+{
+  nodeloc_vec_t locs;
+  if (gm->find_node_locs(start, end, &locs) != count || locs.size() != count)
+    return false;
+
+  for (size_t i=0; i < count; i++)
+  {
+    if (locs[i]->nd->nid != nids[i])
+      return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check the node address lookups: exclusive ends, gaps, overlapping,
+*        duplicate and empty nodes
+*/
+static bool test_addr_index()
+{
+  groupman_t gm;
+  add_addr_node(&gm, 0, 0x1000, 0x1010);
+  add_addr_node(&gm, 1, 0x1010, 0x1020);
+  add_addr_node(&gm, 2, 0x1030, 0x1040);
+  add_addr_node(&gm, 3, 0x0FF0, 0x2000); // Stale node over the others
+  add_addr_node(&gm, 4, 0x1030, 0x1040); // Duplicate of node 2
+  add_addr_node(&gm, 5, 0x2100, 0x2110);
+  add_addr_node(&gm, 6, 0x3000, 0x3000); // Empty node
+  gm.initialize_lookups();
+
+  // The node starting last wins, then the last node id
+  bool ok = true;
+  ok &= find_addr_nid(&gm, 0x0FEF) == -1;
+  ok &= find_addr_nid(&gm, 0x0FF0) == 3;
+  ok &= find_addr_nid(&gm, 0x1000) == 0;
+  ok &= find_addr_nid(&gm, 0x100F) == 0;
+  ok &= find_addr_nid(&gm, 0x1010) == 1;
+  ok &= find_addr_nid(&gm, 0x1025) == 3;
+  ok &= find_addr_nid(&gm, 0x1035) == 4;
+  ok &= find_addr_nid(&gm, 0x1FFF) == 3;
+  ok &= find_addr_nid(&gm, 0x2000) == -1;
+  ok &= find_addr_nid(&gm, 0x20FF) == -1;
+  ok &= find_addr_nid(&gm, 0x2100) == 5;
+  ok &= find_addr_nid(&gm, 0x2110) == -1;
+  ok &= find_addr_nid(&gm, 0x3000) == -1;
+
+  static const int partial[] = {3, 0, 1, 2, 4};
+  ok &= check_addr_range(&gm, 0x100C, 0x1034, partial, qnumber(partial));
+
+  static const int between[] = {3, 1};
+  ok &= check_addr_range(&gm, 0x1010, 0x1030, between, qnumber(between));
+
+  static const int across_gap[] = {3, 5};
+  ok &= check_addr_range(&gm, 0x1FFF, 0x2101, across_gap, qnumber(across_gap));
+
+  ok &= check_addr_range(&gm, 0x2000, 0x2100, NULL, 0);
+  ok &= check_addr_range(&gm, 0x2FF0, 0x3010, NULL, 0);
+  ok &= check_addr_range(&gm, 0x1035, 0x1035, NULL, 0);
+
+  // One long node only adds a layer to the index of many blocks
+  groupman_t big;
+  build_synthetic_gm(&big, 20000, 4);
+  nid2ndef_t *nds = big.get_nds();
+  ea_t lo = nds->begin()->second->start;
+  ea_t hi = nds->rbegin()->second->end;
+  psupergroup_t sg = big.add_supergroup();
+  sg->id = "ID_long";
+  pnodedef_t nd = sg->add_nodegroup()->add_node();
+  nd->nid = 20000;
+  nd->start = lo - 0x10;
+  nd->end = hi;
+  big.map_nodedef(nd->nid, nd);
+  big.initialize_lookups();
+
+  ndaddr_index_t index;
+  index.build(*big.get_nds());
+  ok &= index.layer_count() == 2 && index.size() == 20001;
+
+  for (int i=0; i < 1000; i++)
+  {
+    ea_t ea = lo + bench_rand() % (hi - lo);
+    pnodedef_t expected = NULL;
+    for (nid2ndef_t::iterator it=nds->begin(); it != nds->end(); ++it)
+    {
+      if (ea >= it->second->start && ea < it->second->end && it->second->nid != 20000)
+        expected = it->second;
+    }
+    ok &= index.find(ea) == expected;
+  }
+
+  printf("test_addr_index: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark node id to location lookups: std::map vs. node location table
+*/
+static void bench_nodeloc_lookup(int count)
+{
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 4);
+
+  // Build the map based lookup, as it used to be done
+  typedef std::map<int, nodeloc_t> nid2nloc_map_t;
+  nid2nloc_map_t nid2loc;
+  for (int nid=0; nid < count; nid++)
+    nid2loc[nid] = *gm.find_nodeid_loc(nid);
+
+  std::vector<int> queries;
+  for (int i=0; i < 1000000; i++)
+    queries.push_back(bench_rand() % count);
+
+  // Sequential walk (as when building the combined graph), then random walk
+  double t_map[2], t_table[2];
+  size_t map_sum = 0, table_sum = 0;
+  for (int pass=0; pass < 2; pass++)
+  {
+    double t0 = get_time_ms();
+    for (size_t i=0; i < queries.size(); i++)
+    {
+      int nid = pass == 0 ? int(i % count) : queries[i];
+      nid2nloc_map_t::iterator it = nid2loc.find(nid);
+      if (it != nid2loc.end())
+        map_sum += size_t(it->second.ng);
+    }
+    t_map[pass] = get_time_ms() - t0;
+
+    t0 = get_time_ms();
+    for (size_t i=0; i < queries.size(); i++)
+    {
+      int nid = pass == 0 ? int(i % count) : queries[i];
+      nodeloc_t *loc = gm.find_nodeid_loc(nid);
+      if (loc != NULL)
+        table_sum += size_t(loc->ng);
+    }
+    t_table[pass] = get_time_ms() - t0;
+  }
+
+  printf("nodeloc_lookup: nodes=%d queries=%d seq: map=%.2fms table=%.2fms, random: map=%.2fms table=%.2fms %s\n",
+    count,
+    int(queries.size()),
+    t_map[0],
+    t_table[0],
+    t_map[1],
+    t_table[1],
+    map_sum == table_sum ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Report the heap allocations needed to build and free the groups of
+*        a grouping, as counted by its arena
+*/
+static void bench_arena(int count)
+{
+  groupman_t *gm = new groupman_t();
+
+  double t0 = get_time_ms();
+  build_synthetic_gm(gm, count, 4);
+  double t_build = get_time_ms() - t0;
+
+  gm_arena_t *arena = gm->get_arena();
+  const gm_pool_stats_t *pools[] =
+  {
+    &arena->get_nd_stats(),
+    &arena->get_ng_stats(),
+    &arena->get_sg_stats()
+  };
+
+  size_t objects = 0, chunks = 0;
+  for (size_t i=0; i < qnumber(pools); i++)
+  {
+    objects += pools[i]->allocs;
+    chunks += pools[i]->chunks;
+  }
+
+  t0 = get_time_ms();
+  gm->clear();
+  double t_clear = get_time_ms() - t0;
+
+  printf("arena: nodes=%d group objects=%d (heap allocations before) arena chunks=%d (after) "
+         "build=%.2fms clear=%.2fms\n",
+    count,
+    int(objects),
+    int(chunks),
+    t_build,
+    t_clear);
+
+  delete gm;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Read a whole file into a string
+*/
+static bool read_file(const char *filename, qstring *out)
+{
+  FILE *fp = qfopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+
+  out->qclear();
+  char buf[16 * 1024];
+  for (ssize_t n; (n = qfread(fp, buf, sizeof(buf))) > 0; )
+    out->append(buf, n);
+
+  qfclose(fp);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark the bbgroup parsers: stream/getline vs. in place scanner
+*/
+static void bench_parse(int count)
+{
+  static const char src_file[] = "bench_parse.bbgroup";
+  static const char ref_file[] = "bench_parse_ref.bbgroup";
+  static const char new_file[] = "bench_parse_new.bbgroup";
+  static const char bin_file[] = "bench_parse.bbgbin";
+
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 4);
+  gm.emit(src_file);
+
+  qstring src;
+  read_file(src_file, &src);
+  double mb = src.length() / (1024.0 * 1024.0);
+
+  const int rounds = 5;
+  double t0 = get_time_ms();
+  for (int i=0; i < rounds; i++)
+    gm.parse_getline(src_file);
+  double t_getline = get_time_ms() - t0;
+  gm.emit(ref_file);
+
+  t0 = get_time_ms();
+  for (int i=0; i < rounds; i++)
+    gm.parse(src_file);
+  double t_mapped = get_time_ms() - t0;
+  gm.emit(new_file);
+
+  // Both parsers should yield the same groupings
+  qstring ref, out;
+  read_file(ref_file, &ref);
+  read_file(new_file, &out);
+  bool text_ok = ref == out && ref == src;
+
+  // Binary format: write, load and convert back to text
+  t0 = get_time_ms();
+  gm.emit(bin_file);
+  double t_bin_emit = get_time_ms() - t0;
+
+  qstring bin;
+  read_file(bin_file, &bin);
+
+  t0 = get_time_ms();
+  for (int i=0; i < rounds; i++)
+    gm.parse(bin_file);
+  double t_bin = get_time_ms() - t0;
+
+  groupman_t::convert(bin_file, new_file);
+  read_file(new_file, &out);
+  bool bin_ok = out == src;
+
+  printf("parse: nodes=%d size=%.2fMB getline=%.2fms (%.1f MB/s) mapped=%.2fms (%.1f MB/s) %s\n",
+    count,
+    mb,
+    t_getline / rounds,
+    t_getline > 0 ? mb * rounds * 1000.0 / t_getline : 0.0,
+    t_mapped / rounds,
+    t_mapped > 0 ? mb * rounds * 1000.0 / t_mapped : 0.0,
+    text_ok ? "OK" : "MISMATCH");
+
+  printf("parse_bin: nodes=%d size=%.2fMB emit=%.2fms load=%.2fms %s\n",
+    count,
+    bin.length() / (1024.0 * 1024.0),
+    t_bin_emit,
+    t_bin / rounds,
+    bin_ok ? "OK" : "MISMATCH");
+
+  qunlink(src_file);
+  qunlink(ref_file);
+  qunlink(new_file);
+  qunlink(bin_file);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark many small functions: one file each vs. a single database
+*/
+static void bench_bbgdb(int func_count)
+{
+  static const char db_file[] = "bench.bbgdb";
+  const ea_t func_base = 0x401000;
+
+  groupman_t gm;
+  build_synthetic_gm(&gm, 12, 4);
+
+  // One file per function, the way the plugin names them
+  double t0 = get_time_ms();
+  qstring fn;
+  for (int i=0; i < func_count; i++)
+  {
+    fn.sprnt("bench-%08X.bbgroup", uint32(func_base + i * 0x100));
+    gm.emit(fn.c_str());
+  }
+  double t_files_write = get_time_ms() - t0;
+
+  // A single database
+  qunlink(db_file);
+  t0 = get_time_ms();
+  {
+    bbgroup_db_t db;
+    db.open(db_file, true);
+    db.begin_batch();
+    for (int i=0; i < func_count; i++)
+      db.store(func_base + i * 0x100, &gm);
+    db.end_batch();
+  }
+  double t_db_write = get_time_ms() - t0;
+
+  // Load a random subset of the functions
+  std::vector<int> queries;
+  for (int i=0; i < 1000; i++)
+    queries.push_back(bench_rand() % func_count);
+
+  t0 = get_time_ms();
+  for (size_t i=0; i < queries.size(); i++)
+  {
+    fn.sprnt("bench-%08X.bbgroup", uint32(func_base + queries[i] * 0x100));
+    gm.parse(fn.c_str());
+  }
+  double t_files_load = get_time_ms() - t0;
+
+  t0 = get_time_ms();
+  bbgroup_db_t db;
+  db.open(db_file);
+  double t_db_open = get_time_ms() - t0;
+  bool ok = db.get_index().size() == size_t(func_count);
+  for (size_t i=0; i < queries.size(); i++)
+    ok &= db.load(func_base + queries[i] * 0x100, &gm);
+  double t_db_load = get_time_ms() - t0;
+
+  // Rewrite one function by appending, then reclaim the space
+  build_synthetic_gm(&gm, 20, 5);
+  ok &= db.store(func_base, &gm);
+  uint64 dead = db.get_dead_bytes();
+  ok &= db.compact() && db.get_dead_bytes() == 0;
+
+  groupman_t gm2;
+  ok &= db.load(func_base, &gm2) && gm2.get_nds()->size() == 20;
+  db.close();
+
+  printf("bbgdb: functions=%d files: write=%.2fms load=%.2fms, db: write=%.2fms open+load=%.2fms (open=%.2fms) dead=%d %s\n",
+    func_count,
+    t_files_write,
+    t_files_load,
+    t_db_write,
+    t_db_load,
+    t_db_open,
+    int(dead),
+    ok ? "OK" : "MISMATCH");
+
+  for (int i=0; i < func_count; i++)
+  {
+    fn.sprnt("bench-%08X.bbgroup", uint32(func_base + i * 0x100));
+    qunlink(fn.c_str());
+  }
+  qunlink(db_file);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark the text writers: stdio vs. buffered emitter
+*/
+static void bench_emit(int count)
+{
+  static const char ref_file[] = "bench_emit_ref.bbgroup";
+  static const char new_file[] = "bench_emit_new.bbgroup";
+
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 4);
+
+  double t0 = get_time_ms();
+  gm.emit_stdio(ref_file);
+  double t_stdio = get_time_ms() - t0;
+
+  t0 = get_time_ms();
+  gm.emit(new_file);
+  double t_buffered = get_time_ms() - t0;
+
+  qstring ref, out;
+  read_file(ref_file, &ref);
+  read_file(new_file, &out);
+
+  printf("emit: nodes=%d size=%.2fMB stdio=%.2fms buffered=%.2fms %s\n",
+    count,
+    ref.length() / (1024.0 * 1024.0),
+    t_stdio,
+    t_buffered,
+    ref == out ? "OK" : "MISMATCH");
+
+  qunlink(ref_file);
+  qunlink(new_file);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark bulk merges: eager list splicing vs. lazy disjoint set
+*/
+static void bench_merges(int count, int merge_size)
+{
+  double t[2];
+  qstring out[2];
+  for (int lazy=0; lazy < 2; lazy++)
+  {
+    // A single SG with one NG per node: the worst case for NG removals
+    groupman_t gm;
+    psupergroup_t sg = gm.add_supergroup();
+    std::vector<pnodegroup_t> ngs;
+    for (int nid=0; nid < count; nid++)
+    {
+      pnodegroup_t ng = sg->add_nodegroup();
+      pnodedef_t nd = ng->add_node();
+      nd->nid = nid;
+      nd->start = 0x401000 + nid * 0x10;
+      nd->end = nd->start + 0x10;
+      gm.map_nodedef(nid, nd);
+      ngs.push_back(ng);
+    }
+    gm.initialize_lookups();
+    gm.set_lazy_merges(lazy != 0);
+
+    // Merge consecutive runs of NGs. The NGs of the lazy groupman stay
+    // valid until the lists are materialized by get_path_sgl()
+    double t0 = get_time_ms();
+    for (int i=0; i + merge_size <= count; i += merge_size)
+    {
+      nodegroup_list_t ngl;
+      for (int j=0; j < merge_size; j++)
+        ngl.push_back(ngs[i + j]);
+      gm.combine_ngl(&ngl);
+    }
+    gm.get_path_sgl();
+    t[lazy] = get_time_ms() - t0;
+
+    gm.emit("bench_merges.bbgroup");
+    read_file("bench_merges.bbgroup", &out[lazy]);
+  }
+  qunlink("bench_merges.bbgroup");
+
+  printf("merges: nodes=%d merge_size=%d eager=%.2fms lazy=%.2fms %s\n",
+    count,
+    merge_size,
+    t[0],
+    t[1],
+    out[0] == out[1] ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Emit a groupman to a string
+*/
+static bool emit_to_string(groupman_t *gm, qstring *out)
+{
+  static const char tmp_file[] = "emit_to_string.bbgroup";
+  bool ok = gm->emit(tmp_file) && read_file(tmp_file, out);
+  qunlink(tmp_file);
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Apply a deterministic series of edits to a synthetic groupman
+*/
+static void edit_synthetic_gm(
+    groupman_t *gm,
+    int count,
+    int step)
+{
+  for (int nid=0; nid + 7 < count; nid += step)
+  {
+    // Combine the NGs of two nodes
+    nodegroup_list_t ngl;
+    ngl.push_back(gm->find_nodeid_loc(nid)->ng);
+    ngl.push_back(gm->find_nodeid_loc(nid + 4)->ng);
+    gm->combine_ngl(&ngl);
+
+    // Move two nodes to a new NG
+    nodegroup_t ng;
+    ng.add_node(gm->find_nodeid_loc(nid + 6)->nd);
+    ng.add_node(gm->find_nodeid_loc(nid + 7)->nd);
+    gm->move_nodes_to_ng(&ng);
+
+    // Take a node out of its NG
+    gm->move_node_to_own_ng(gm->find_nodeid_loc(nid + 1)->nd);
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark snapshots against a copy through the binary format and 
+*        check that editing a snapshot leaves its source untouched
+*/
+static void bench_snapshot(int count, int edit_step)
+{
+  groupman_t *gm = new groupman_t();
+  build_synthetic_gm(gm, count, 3);
+
+  qstring src_ref;
+  emit_to_string(gm, &src_ref);
+
+  // Deep copy baseline
+  double t0 = get_time_ms();
+  std::vector<char> bin;
+  gm->emit_bin_buffer(&bin);
+  groupman_t copy;
+  copy.parse_bin_buffer(&bin[0], bin.size());
+  double t_copy = get_time_ms() - t0;
+
+  t0 = get_time_ms();
+  groupman_t *snap = gm->snapshot();
+  double t_snap = get_time_ms() - t0;
+
+  // Lookups read the shared lists and lookups in place
+  t0 = get_time_ms();
+  bool ok = snap->find_nodeid_loc(count / 2) != NULL && !snap->empty();
+  double t_lookup = get_time_ms() - t0;
+
+  // The first edit copies the SG list and the node locations, not the nodes
+  t0 = get_time_ms();
+  edit_synthetic_gm(snap, 8, 1);
+  double t_first = get_time_ms() - t0;
+
+  t0 = get_time_ms();
+  edit_synthetic_gm(snap, count, edit_step);
+  double t_edit = get_time_ms() - t0;
+
+  edit_synthetic_gm(&copy, 8, 1);
+  edit_synthetic_gm(&copy, count, edit_step);
+
+  qstring src_out, snap_out, copy_out;
+  emit_to_string(gm, &src_out);
+  emit_to_string(snap, &snap_out);
+  emit_to_string(&copy, &copy_out);
+
+  ok =    ok
+       && src_out == src_ref 
+       && snap_out == copy_out 
+       && gm->verify_lookups() 
+       && snap->verify_lookups();
+
+  // The snapshot outlives its source
+  delete gm;
+  emit_to_string(snap, &snap_out);
+  ok = ok && snap_out == copy_out;
+  delete snap;
+
+  printf("snapshot: nodes=%d edits=%d copy=%.2fms snapshot=%.4fms lookup=%.4fms first_edit=%.2fms edit=%.2fms %s\n",
+    count,
+    count / edit_step,
+    t_copy,
+    t_snap,
+    t_lookup,
+    t_first,
+    t_edit,
+    ok ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Apply the edit number 'i' of a series mixing all the edit kinds
+*/
+static void apply_mixed_edit(groupman_t *gm, int i)
+{
+  int nid = (i * 37) % 2990;
+  switch (i % 7)
+  {
+    case 0:
+    {
+      nodegroup_list_t ngl;
+      ngl.push_back(gm->find_nodeid_loc(nid)->ng);
+      ngl.push_back(gm->find_nodeid_loc(nid + 5)->ng);
+      ngl.push_back(gm->find_nodeid_loc(nid + 9)->ng);
+      gm->combine_ngl(&ngl);
+      break;
+    }
+    case 1:
+    {
+      nodegroup_t ng;
+      ng.add_node(gm->find_nodeid_loc(nid + 3)->nd);
+      ng.add_node(gm->find_nodeid_loc(nid)->nd);
+      ng.add_node(gm->find_nodeid_loc(nid + 7)->nd);
+      gm->move_nodes_to_ng(&ng);
+      break;
+    }
+    case 2:
+    {
+      nodeloc_t *loc = gm->find_nodeid_loc(nid);
+      gm->promote_nodegroup(loc->sg, loc->ng);
+      break;
+    }
+    case 3:
+      gm->move_node_to_own_ng(gm->find_nodeid_loc(nid + 1)->nd);
+      break;
+    case 4:
+      gm->split_nodegroup(gm->find_nodeid_loc(nid)->ng);
+      break;
+    case 5:
+    {
+      // Several changes undone as one
+      gm->begin_edit("Combine and rename");
+      nodegroup_list_t ngl;
+      ngl.push_back(gm->find_nodeid_loc(nid)->ng);
+      ngl.push_back(gm->find_nodeid_loc(nid + 2)->ng);
+      pnodegroup_t ng = gm->combine_ngl(&ngl);
+      qstring name;
+      name.sprnt("renamed_%d", i);
+      gm->set_sg_name(gm->find_nodeid_loc(ng->get_first_node()->nid)->sg, name.c_str());
+      gm->end_edit();
+      break;
+    }
+    case 6:
+      if (i % 3 == 0)
+        gm->reset_groupping();
+      break;
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that undoing and redoing the edits goes through the same states
+*/
+static bool test_journal()
+{
+  const int edit_count = 60;
+
+  groupman_t gm;
+  build_synthetic_gm(&gm, 3000, 3);
+  gm.set_journal(true);
+
+  // Remember the state before each edit and after the last one
+  std::vector<qstring> states(edit_count + 1);
+  bool ok = true;
+  for (int i=0; i < edit_count; i++)
+  {
+    emit_to_string(&gm, &states[i]);
+    apply_mixed_edit(&gm, i);
+  }
+  emit_to_string(&gm, &states[edit_count]);
+
+  gm_journal_stats_t st;
+  gm.get_journal_stats(&st);
+
+  // Edits that changed nothing are not recorded
+  int recorded = int(st.undo_count);
+  ok &= recorded > edit_count / 2 && st.redo_count == 0;
+
+  qstring out;
+  for (int pass=0; pass < 2; pass++)
+  {
+    // Each undo goes back to the state before one of the edits
+    int undone = 0;
+    int j = edit_count;
+    while (gm.undo())
+    {
+      ++undone;
+      emit_to_string(&gm, &out);
+      while (j > 0 && states[--j] != out)
+        ;
+      ok &= states[j] == out && gm.verify_lookups();
+    }
+    ok &= undone == recorded && j == 0;
+
+    while (gm.redo())
+      ok &= gm.verify_lookups();
+
+    emit_to_string(&gm, &out);
+    ok &= out == states[edit_count];
+  }
+
+  // A new edit drops what could be redone
+  gm.undo();
+  apply_mixed_edit(&gm, 0);
+  gm.get_journal_stats(&st);
+  ok &= st.redo_count == 0 && gm.verify_lookups();
+
+  // Moving nodes skips the ones that are not in the grouping and records no
+  // edit if none of them is
+  size_t undo_count = st.undo_count;
+  nodedef_t stray;
+  stray.nid = 100000;
+  nodegroup_t sel;
+  sel.add_node(&stray);
+  ok &= gm.move_nodes_to_ng(&sel) == NULL;
+  gm.get_journal_stats(&st);
+  ok &= st.undo_count == undo_count;
+
+  sel.add_node(gm.find_nodeid_loc(7)->nd);
+  pnodegroup_t moved = gm.move_nodes_to_ng(&sel);
+  gm.get_journal_stats(&st);
+  ok &=    moved != NULL
+        && moved->size() == 1
+        && st.undo_count == undo_count + 1
+        && gm.verify_lookups();
+
+  // A small limit drops the oldest edits
+  gm.set_journal_limit(4096);
+  gm.get_journal_stats(&st);
+  ok &= st.bytes <= st.limit && st.dropped > 0;
+
+  int undone = 0;
+  while (gm.undo())
+    ++undone;
+  ok &= undone == int(st.undo_count) && gm.verify_lookups();
+
+  // Snapshots start with an empty journal and are undone independently
+  groupman_t *snap = gm.snapshot();
+  snap->set_journal_limit(64 * 1024 * 1024);
+  qstring src_state, snap_state;
+  emit_to_string(&gm, &src_state);
+  for (int i=0; i < 10; i++)
+    apply_mixed_edit(snap, i);
+  while (snap->undo())
+    ;
+  emit_to_string(snap, &snap_state);
+  emit_to_string(&gm, &out);
+  ok &= !gm.undo() && out == src_state && snap_state == src_state && snap->verify_lookups();
+  delete snap;
+
+  printf("test_journal: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the cached SG and NG statistics follow the edits
+*/
+static bool test_stats()
+{
+  const int edit_count = 60;
+
+  bool ok = true;
+  for (int lazy=0; lazy < 2; lazy++)
+  {
+    groupman_t gm;
+    build_synthetic_gm(&gm, 3000, 3);
+    gm.set_lazy_merges(lazy != 0);
+    gm.set_journal(true);
+
+    // Each check queries the stats so the next edit updates them in place
+    ok &= gm.verify_stats();
+    for (int i=0; i < edit_count; i++)
+    {
+      apply_mixed_edit(&gm, i);
+      ok &= gm.verify_stats();
+    }
+
+    while (gm.undo())
+      ok &= gm.verify_stats();
+    while (gm.redo())
+      ok &= gm.verify_stats();
+
+    // Editing a snapshot leaves the stats of its source alone
+    groupman_t *snap = gm.snapshot();
+    ok &= snap->verify_stats();
+    for (int i=0; i < 20; i++)
+    {
+      apply_mixed_edit(snap, i * 3 + 1);
+      ok &= snap->verify_stats() && gm.verify_stats();
+    }
+    delete snap;
+  }
+
+  printf("test_stats: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the flat view follows the edits and writes the same text
+*/
+static bool test_flat()
+{
+  const int edit_count = 60;
+
+  bool ok = true;
+  for (int lazy=0; lazy < 2; lazy++)
+  {
+    groupman_t gm;
+    build_synthetic_gm(&gm, 3000, 3);
+    gm.set_lazy_merges(lazy != 0);
+    gm.set_journal(lazy == 0);
+
+    // Each check uses the view so the next edit has to invalidate it
+    ok &= gm.verify_flat();
+    for (int i=0; i < edit_count; i++)
+    {
+      apply_mixed_edit(&gm, i);
+      ok &= gm.verify_flat();
+    }
+
+    while (gm.undo())
+      ok &= gm.verify_flat();
+    while (gm.redo())
+      ok &= gm.verify_flat();
+
+    const gm_flat_t *flat = gm.get_flat();
+    ok &= flat->nd_count() == gm.get_nds()->size()
+       && flat->sg_count() == gm.get_path_sgl()->size();
+
+    // Editing a snapshot leaves the view of its source alone
+    groupman_t *snap = gm.snapshot();
+    for (int i=0; i < 20; i++)
+    {
+      apply_mixed_edit(snap, i * 3 + 1);
+      ok &= snap->verify_flat() && gm.verify_flat();
+    }
+    delete snap;
+
+    // The writer walking the view agrees with the one walking the lists
+    static const char ref_file[] = "test_flat_ref.bbgroup";
+    qstring ref, out;
+    ok &= gm.emit_stdio(ref_file) && read_file(ref_file, &ref);
+    ok &= emit_to_string(&gm, &out) && out == ref;
+    qunlink(ref_file);
+  }
+
+  printf("test_flat: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Describe the NG and SG of each node as displayed by the views
+*/
+static void get_group_sigs(groupman_t *gm, std::vector<qstring> *sigs)
+{
+  sigs->assign(gm->get_nds()->size(), qstring());
+
+  psupergroup_listp_t sgl = gm->get_path_sgl();
+  for (supergroup_listp_t::iterator it=sgl->begin(); it != sgl->end(); ++it)
+  {
+    psupergroup_t sg = *it;
+    for (nodegroup_list_t::iterator it_ng=sg->groups.begin();
+         it_ng != sg->groups.end();
+         ++it_ng)
+    {
+      pnodegroup_t ng = *it_ng;
+      int sum = 0;
+      for (nodegroup_t::iterator it_nd=ng->begin(); it_nd != ng->end(); ++it_nd)
+        sum += (*it_nd)->nid;
+
+      qstring sig;
+      sig.sprnt("%d/%d/%s", sum, int(ng->size()), sg->get_display_name());
+      for (nodegroup_t::iterator it_nd=ng->begin(); it_nd != ng->end(); ++it_nd)
+        (*sigs)[(*it_nd)->nid] = sig;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the changes taken cover every node whose NG or SG changed
+*        since the signatures were taken, then take new signatures. A node is
+*        covered if it is listed or was or is in the NG of a listed node
+*/
+static bool check_changes(
+    groupman_t *gm,
+    std::vector<qstring> *sigs,
+    bool expect_all)
+{
+  std::vector<int> nids;
+  bool listed = gm->take_changes(&nids);
+
+  std::vector<qstring> after;
+  get_group_sigs(gm, &after);
+
+  bool ok = listed != expect_all;
+  if (ok && listed)
+  {
+    std::vector<bool> hit(after.size(), false);
+    std::set<qstring> old_ngs, new_ngs;
+    for (size_t i=0; i < nids.size(); i++)
+    {
+      hit[nids[i]] = true;
+      old_ngs.insert((*sigs)[nids[i]]);
+      new_ngs.insert(after[nids[i]]);
+    }
+
+    for (size_t nid=0; nid < after.size(); nid++)
+    {
+      ok &=    hit[nid] 
+            || after[nid] == (*sigs)[nid]
+            || old_ngs.count((*sigs)[nid]) != 0
+            || new_ngs.count(after[nid]) != 0;
+    }
+  }
+  sigs->swap(after);
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check the nodes the edits report as changed
+*/
+static bool test_changes()
+{
+  const int edit_count = 60;
+
+  bool ok = true;
+  for (int journal=0; journal < 2; journal++)
+  {
+    groupman_t gm;
+    build_synthetic_gm(&gm, 3000, 3);
+    gm.set_journal(journal != 0);
+
+    // Loading changes the whole grouping
+    std::vector<qstring> sigs;
+    ok &= check_changes(&gm, &sigs, true);
+    ok &= check_changes(&gm, &sigs, false);
+
+    for (int i=0; i < edit_count; i++)
+    {
+      apply_mixed_edit(&gm, i);
+      ok &= check_changes(&gm, &sigs, i % 7 == 6 && i % 3 == 0);
+    }
+
+    // Replaying a reset moves every node too
+    for (int redo=0; redo < 2; redo++)
+    {
+      const char *desc;
+      while ((desc = redo ? gm.get_redo_desc() : gm.get_undo_desc()) != NULL)
+      {
+        bool all = strcmp(desc, "Reset groupping") == 0;
+        ok &= (redo ? gm.redo() : gm.undo()) && check_changes(&gm, &sigs, all);
+      }
+    }
+  }
+
+  // Lazy merges are only applied when the groups are walked
+  groupman_t gm;
+  build_synthetic_gm(&gm, 300, 3);
+  gm.set_lazy_merges(true);
+  std::vector<qstring> sigs;
+  ok &= check_changes(&gm, &sigs, true);
+  apply_mixed_edit(&gm, 0);
+  ok &= check_changes(&gm, &sigs, true);
+
+  printf("test_changes: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the SGs and NGs holding the given nodes are the expanded
+*        ones and count them
+*/
+static bool check_hier_expand(
+    groupman_t *gm,
+    const hier_expand_t &expand,
+    const std::set<int> &sg_nids,
+    const std::set<int> &ng_nids,
+    int *expanded)
+{
+  const gm_flat_t *flat = gm->get_flat();
+
+  bool ok = true;
+  *expanded = 0;
+  for (size_t i=0; i < flat->sg_count(); i++)
+  {
+    bool sg_expanded = false;
+    for (uint32 j=flat->ng_begin(i); j < flat->ng_end(i); j++)
+    {
+      bool ng_expanded = false;
+      for (uint32 k=flat->nd_begin(j); k < flat->nd_end(j); k++)
+      {
+        sg_expanded |= sg_nids.count(flat->nids[k]) != 0;
+        ng_expanded |= ng_nids.count(flat->nids[k]) != 0;
+      }
+      ok &= expand.is_ng_expanded(flat, j) == ng_expanded;
+      *expanded += ng_expanded ? 1 : 0;
+    }
+    ok &= expand.is_sg_expanded(flat, i) == sg_expanded;
+    *expanded += sg_expanded ? 1 : 0;
+  }
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check the expanded groups of the hierarchical view through
+*        expansions, collapses and grouping edits
+*/
+static bool test_hier_expand()
+{
+  groupman_t gm;
+  build_synthetic_gm(&gm, 3000, 3);
+
+  // Make SGs of several NGs
+  for (int i=0; i < 40; i++)
+    apply_mixed_edit(&gm, i);
+
+  hier_expand_t expand;
+  std::set<int> sg_nids, ng_nids;
+  int expanded;
+  bool ok = check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+         && expanded == 0;
+
+  // SG and NG nodes are expanded, block nodes cannot be
+  hier_node_t hn;
+  hn.level = hlvl_sg;
+  hn.nid = 37;
+  ok &= expand.expand(hn);
+  sg_nids.insert(hn.nid);
+
+  hn.level = hlvl_ng;
+  hn.nid = 1500;
+  ok &= expand.expand(hn);
+  ng_nids.insert(hn.nid);
+
+  hn.level = hlvl_block;
+  ok &= !expand.expand(hn);
+  ok &= check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+     && expanded == 2;
+
+  // The state follows the nodes through the edits
+  for (int i=40; i < 80; i++)
+  {
+    apply_mixed_edit(&gm, i);
+    ok &= check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+       && expanded == 2;
+  }
+
+  // Collapsing a block node collapses its NG
+  nodeloc_t *loc = gm.find_nodeid_loc(1500);
+  hn.level = hlvl_block;
+  hn.nid = loc->ng->back()->nid;
+  ok &= expand.collapse(&gm, hn);
+  ng_nids.clear();
+  ok &= check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+     && expanded == 1;
+
+  // Collapsing an NG node collapses its SG, its NGs stay expanded
+  hn.level = hlvl_ng;
+  hn.nid = 37;
+  ok &= expand.expand(hn);
+  ng_nids.insert(hn.nid);
+  ok &= expand.collapse(&gm, hn);
+  sg_nids.clear();
+  ok &= check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+     && expanded == 1;
+
+  hn.level = hlvl_sg;
+  ok &= expand.expand(hn);
+  sg_nids.insert(hn.nid);
+  ok &= check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+     && expanded == 2;
+
+  // SG nodes and unknown nodes cannot be collapsed
+  ok &= !expand.collapse(&gm, hn);
+  hn.level = hlvl_ng;
+  hn.nid = 100000;
+  ok &= !expand.collapse(&gm, hn);
+
+  expand.clear();
+  sg_nids.clear();
+  ng_nids.clear();
+  ok &= check_hier_expand(&gm, expand, sg_nids, ng_nids, &expanded)
+     && expanded == 0;
+
+  printf("test_hier_expand: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark undo/redo against reloading the grouping from a file
+*/
+static void bench_journal(int count, int edit_step)
+{
+  static const char src_file[] = "bench_journal.bbgroup";
+
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 3);
+  gm.emit(src_file);
+  gm.set_journal(true);
+
+  double t0 = get_time_ms();
+  edit_synthetic_gm(&gm, count, edit_step);
+  double t_edit = get_time_ms() - t0;
+
+  qstring edited, out;
+  emit_to_string(&gm, &edited);
+
+  gm_journal_stats_t st;
+  gm.get_journal_stats(&st);
+
+  t0 = get_time_ms();
+  gm.undo();
+  double t_undo1 = get_time_ms() - t0;
+
+  t0 = get_time_ms();
+  while (gm.undo())
+    ;
+  double t_undo = get_time_ms() - t0 + t_undo1;
+
+  qstring src;
+  emit_to_string(&gm, &out);
+  read_file(src_file, &src);
+  bool ok = out == src;
+
+  t0 = get_time_ms();
+  while (gm.redo())
+    ;
+  double t_redo = get_time_ms() - t0;
+
+  emit_to_string(&gm, &out);
+  ok = ok && out == edited;
+
+  // The only way back without the journal
+  t0 = get_time_ms();
+  groupman_t reloaded;
+  reloaded.parse(src_file);
+  double t_reload = get_time_ms() - t0;
+
+  qunlink(src_file);
+
+  printf("journal: nodes=%d edits=%d edit=%.2fms undo1=%.4fms undo_all=%.2fms redo_all=%.2fms reload=%.2fms bytes=%u %s\n",
+    count,
+    int(st.undo_count),
+    t_edit,
+    t_undo1,
+    t_undo,
+    t_redo,
+    t_reload,
+    uint32(st.bytes),
+    ok ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that a groupman and its snapshots can be edited independently
+*/
+static bool test_snapshot()
+{
+  bool ok = true;
+  for (int lazy=0; lazy < 2; lazy++)
+  {
+    groupman_t gm;
+    build_synthetic_gm(&gm, 3000, 3);
+    gm.set_lazy_merges(lazy != 0);
+
+    qstring ref, out;
+    emit_to_string(&gm, &ref);
+
+    // Edit the snapshot
+    groupman_t *snap1 = gm.snapshot();
+    edit_synthetic_gm(snap1, 3000, 16);
+
+    groupman_t expected1;
+    build_synthetic_gm(&expected1, 3000, 3);
+    edit_synthetic_gm(&expected1, 3000, 16);
+
+    // Take a snapshot of the snapshot then edit the source
+    groupman_t *snap2 = snap1->snapshot();
+    edit_synthetic_gm(&gm, 3000, 40);
+
+    groupman_t expected0;
+    build_synthetic_gm(&expected0, 3000, 3);
+    edit_synthetic_gm(&expected0, 3000, 40);
+
+    qstring exp0, exp1, out1, out2;
+    emit_to_string(&expected0, &exp0);
+    emit_to_string(&expected1, &exp1);
+    emit_to_string(&gm, &out);
+    emit_to_string(snap1, &out1);
+    emit_to_string(snap2, &out2);
+    ok &= out == exp0 && out1 == exp1 && out2 == exp1;
+
+    // Clearing a snapshot must not affect the others
+    snap1->clear();
+    emit_to_string(snap2, &out2);
+    ok &= out2 == exp1 && snap2->verify_lookups() && gm.verify_lookups();
+
+    delete snap1;
+    delete snap2;
+  }
+
+  printf("test_snapshot: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that ids stored sparse are found after the dense table
+*        grows over them
+*/
+static bool test_nodeloc_table()
+{
+  static nodedef_t nds[2];
+  nodeloc_t loc1(NULL, NULL, &nds[0]), loc2(NULL, NULL, &nds[1]);
+
+  nodeloc_table_t tbl;
+  tbl.reset();
+
+  // With few nodes, a high id does not fit the dense table yet
+  for (int nid=0; nid < 10; nid++)
+    tbl.set(nid, loc1);
+  tbl.set(1100, loc2);
+  bool ok = tbl.sparse_size() == 1;
+
+  // Grow the dense table past it
+  for (int nid=10; nid < 1100; nid++)
+    tbl.set(nid, loc1);
+
+  nodeloc_t *loc = tbl.find(1100);
+  ok &= loc != NULL && loc->nd == &nds[1] && tbl.sparse_size() == 0;
+
+  // Setting it again must not count it twice
+  tbl.set(1100, loc1);
+  ok &= tbl.size() == 1101 && tbl.find(1100)->nd == &nds[0];
+
+  printf("test_nodeloc_table: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the buffered emitter writes what the stdio one does and
+*        that the output parses back to the same groups
+*/
+static bool test_emit_roundtrip()
+{
+  static const char ref_file[] = "test_emit_ref.bbgroup";
+  static const char new_file[] = "test_emit_new.bbgroup";
+  static const char rt_file[]  = "test_emit_rt.bbgroup";
+  static const char input[] = 
+    "--PATHINFO\n"
+    "ID:1;GROUPNAME:first group;NODESET:(0 : 401000 : 401010, 1 : 401010 : 401020), (2 : 401020 : 401030)\n"
+    "ID:2;NODESET:(-1 : 0 : 0, -2147483648 : FFFFFFFF : 1)\n"
+    "GROUPNAME:no nodes\n"
+    "ID:3;NODESET:(), (2147483647 : ABCDEF : 10000000)\n"
+    "--SIMILARINFO\n"
+    "ID:s1;NODESET:(0 : 401000 : 401010)\n"
+    "--CUSTOM\n"
+    "some custom text\n";
+
+  groupman_t gm;
+  gm.parse_buffer(input, qnumber(input) - 1);
+
+  bool ok = true;
+  for (int pass=0; ok && pass < 2; pass++)
+  {
+    const char *additional = pass == 0 ? NULL : "--MORE\nmore text";
+
+    gm.emit_stdio(ref_file, additional);
+    ok &= gm.emit(new_file, additional, pass == 1);
+
+    qstring ref, out;
+    ok &= read_file(ref_file, &ref) && read_file(new_file, &out) && ref == out;
+
+    // Parse the output and write it again
+    groupman_t gm2;
+    ok &= gm2.parse(new_file) && gm2.emit(rt_file);
+    qstring rt;
+    ok &= read_file(rt_file, &rt) && rt == out;
+  }
+
+  // A big synthetic grouping makes the buffer flush several times
+  build_synthetic_gm(&gm, 50000, 3);
+  gm.emit_stdio(ref_file);
+  ok &= gm.emit(new_file, NULL, true);
+
+  qstring ref, out;
+  ok &= read_file(ref_file, &ref) && read_file(new_file, &out) && ref == out;
+
+  qunlink(ref_file);
+  qunlink(new_file);
+  qunlink(rt_file);
+
+  printf("test_emit_roundtrip: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Add 'copies' similar SGs per path SG, as found by a similarity analysis
+*/
+static void add_synthetic_similar(
+    groupman_t *gm,
+    int copies)
+{
+  psupergroup_listp_t path_sgl = gm->get_path_sgl();
+  psupergroup_listp_t similar_sgl = gm->get_similar_sgl();
+  for (supergroup_listp_t::iterator it=path_sgl->begin();
+       it != path_sgl->end();
+       ++it)
+  {
+    psupergroup_t path_sg = *it;
+    for (int i=0; i < copies; i++)
+    {
+      psupergroup_t sg = gm->add_supergroup(similar_sgl);
+      sg->id.sprnt("%s_S%d", path_sg->id.c_str(), i);
+      path_sg->copy_to(sg);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark opening a file with a big SIMILARINFO section:
+*        eager parsing vs. lazy loading of the similar SGs
+*/
+static void bench_lazy_similar(int count, int copies)
+{
+  static const char src_file[] = "bench_lazy.bbgroup";
+  static const char ref_file[] = "bench_lazy_ref.bbgroup";
+  static const char new_file[] = "bench_lazy_new.bbgroup";
+
+  {
+    groupman_t gm;
+    build_synthetic_gm(&gm, count, 4);
+    add_synthetic_similar(&gm, copies);
+    gm.emit(src_file);
+  }
+
+  groupman_t gm;
+  const int rounds = 5;
+
+  gm.set_lazy_similar(false);
+  double t0 = get_time_ms();
+  for (int i=0; i < rounds; i++)
+    gm.parse(src_file);
+  double t_eager = get_time_ms() - t0;
+  gm.emit(ref_file);
+
+  gm.set_lazy_similar(true);
+  t0 = get_time_ms();
+  for (int i=0; i < rounds; i++)
+    gm.parse(src_file);
+  double t_lazy = get_time_ms() - t0;
+
+  // First access to the similar SGs
+  t0 = get_time_ms();
+  bool loaded = gm.load_similar();
+  double t_load = get_time_ms() - t0;
+  gm.emit(new_file);
+
+  qstring ref, out;
+  bool ok = loaded && read_file(ref_file, &ref) && read_file(new_file, &out) && ref == out;
+
+  printf("lazy_similar: nodes=%d similar=%d eager=%.2fms lazy=%.2fms (%.1fx) first_access=%.2fms %s\n",
+    count,
+    count * copies,
+    t_eager / rounds,
+    t_lazy / rounds,
+    t_lazy > 0 ? t_eager / t_lazy : 0.0,
+    t_load,
+    ok ? "OK" : "MISMATCH");
+
+  qunlink(src_file);
+  qunlink(ref_file);
+  qunlink(new_file);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check the lazy loading of the similar SGs, including a source
+*        file changed before they are needed
+*/
+static bool test_lazy_similar()
+{
+  static const char src_file[] = "test_lazy.bbgroup";
+  static const char input[] = 
+    "--PATHINFO\n"
+    "ID:1;NODESET:(0 : 401000 : 401010, 1 : 401010 : 401020)\n"
+    "--SIMILARINFO\n"
+    "ID:s1;NODESET:(0 : 401000 : 401010)\n"
+    "--CUSTOM\n"
+    "some custom text\n"
+    "  --SIMILARINFO\n"
+    "ID:s2;NODESET:(1 : 401010 : 401020)\n";
+
+  FILE *fp = qfopen(src_file, "wb");
+  if (fp == NULL)
+    return false;
+  qfwrite(fp, input, qnumber(input) - 1);
+  qfclose(fp);
+
+  groupman_t gm;
+  bool ok = gm.parse(src_file);
+
+  // Only the sections are known so far
+  const gm_sections_t &sects = gm.get_sections();
+  size_t similar1 = strstr(input, "--SIMILARINFO") - input;
+  size_t custom = strstr(input, "--CUSTOM") - input;
+  size_t similar2 = strstr(input + custom, "--SIMILARINFO") - input;
+  ok &= gm.is_similar_pending()
+     && sects.size() == 4
+     && sects[1].offset == similar1 && sects[1].size == custom - similar1
+     && sects[3].offset == similar2 && sects[3].size == qnumber(input) - 1 - similar2;
+
+  // The similar nodes are not looked up
+  ok &= gm.get_nds()->size() == 2 && gm.get_nds()->find(0)->second->start == 0x401000;
+
+  psupergroup_listp_t sgl = gm.get_similar_sgl();
+  ok &= !gm.is_similar_pending()
+     && sgl->size() == 2
+     && sgl->front()->id == "s1"
+     && sgl->back()->id == "s2";
+
+  // The source file changes before the similar SGs are needed
+  ok &= gm.parse(src_file) && gm.is_similar_pending();
+  fp = qfopen(src_file, "ab");
+  if (fp != NULL)
+  {
+    qfwrite(fp, "\n", 1);
+    qfclose(fp);
+  }
+  ok &= !gm.load_similar() && gm.get_similar_sgl()->empty();
+
+  // The source file is rewritten with the same size between parse and
+  // emit: saving must keep failing rather than drop the similar SGs
+  static const char out_file[] = "test_lazy_out.bbgroup";
+  fp = qfopen(src_file, "wb");
+  if (fp != NULL)
+  {
+    qfwrite(fp, input, qnumber(input) - 1);
+    qfclose(fp);
+  }
+  ok &= gm.parse(src_file) && gm.is_similar_pending();
+
+  qstring changed(input, qnumber(input) - 1);
+  changed[similar1 + 2] = 'X';
+  fp = qfopen(src_file, "wb");
+  if (fp != NULL)
+  {
+    qfwrite(fp, changed.c_str(), changed.length());
+    qfclose(fp);
+  }
+
+  std::vector<char> bin;
+  ok &=    !gm.emit(out_file)
+        && !gm.emit(out_file, NULL, true)
+        && !gm.emit_stdio(out_file)
+        && !gm.emit_bin_buffer(&bin)
+        && !qfileexist(out_file)
+        && gm.is_similar_pending();
+
+  qunlink(src_file);
+
+  printf("test_lazy_similar: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Print a diff or the conflicts of a merge
+*/
+static void print_diff(gm_diff_t &diff)
+{
+  for (size_t i=0; i < diff.ops.size(); i++)
+  {
+    gm_diff_op_t &op = diff.ops[i];
+    pnodegroup_t ng = op.ng_a != NULL ? op.ng_a : op.ng_b;
+    pnodedef_t nd = ng == NULL ? NULL : ng->get_first_node();
+    printf("%-9s %-20s -> %-20s",
+      gm_diff_t::get_kind_name(op.kind),
+      op.sg_a == NULL ? "-" : op.sg_a->get_display_name("?"),
+      op.sg_b == NULL ? "-" : op.sg_b->get_display_name("?"));
+    if (nd != NULL)
+      printf(" ng@%llX (%u nodes)", uint64(nd->start), uint32(ng->size()));
+    printf("\n");
+  }
+}
+
+static void print_merge_report(gm_merge_report_t &report)
+{
+  for (size_t i=0; i < report.conflicts.size(); i++)
+  {
+    gm_conflict_t &c = report.conflicts[i];
+    printf("conflict %-9s ours=%s theirs=%s",
+      gm_merge_report_t::get_kind_name(c.kind),
+      c.sg_ours == NULL ? "-" : c.sg_ours->get_display_name("?"),
+      c.sg_theirs == NULL ? "-" : c.sg_theirs->get_display_name("?"));
+    for (size_t j=0; j < c.nodes.size(); j++)
+      printf(" %llX-%llX", uint64(c.nodes[j]->start), uint64(c.nodes[j]->end));
+    printf("\n");
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check the diff and the three-way merge on small edits
+*/
+static bool test_merge3()
+{
+  groupman_t base;
+  build_synthetic_gm(&base, 64, 2);
+
+  groupman_t *ours = base.snapshot();
+  groupman_t *theirs = base.snapshot();
+  groupman_t *both = base.snapshot();
+
+  // Each side edits its own nodes: both sets of edits are merged
+  for (int pass=0; pass < 2; pass++)
+  {
+    groupman_t *gm = pass == 0 ? ours : theirs;
+    int nid = pass == 0 ? 0 : 32;
+
+    nodegroup_list_t ngl;
+    ngl.push_back(gm->find_nodeid_loc(nid)->ng);
+    ngl.push_back(gm->find_nodeid_loc(nid + 4)->ng);
+    gm->combine_ngl(&ngl);
+    gm->move_node_to_own_ng(gm->find_nodeid_loc(nid + 9)->nd);
+    gm->set_sg_name(gm->find_nodeid_loc(nid + 12)->sg, pass == 0 ? "ours" : "theirs");
+
+    ngl.clear();
+    ngl.push_back(both->find_nodeid_loc(nid)->ng);
+    ngl.push_back(both->find_nodeid_loc(nid + 4)->ng);
+    both->combine_ngl(&ngl);
+    both->move_node_to_own_ng(both->find_nodeid_loc(nid + 9)->nd);
+    both->set_sg_name(both->find_nodeid_loc(nid + 12)->sg, pass == 0 ? "ours" : "theirs");
+  }
+
+  gm_diff_t diff;
+  gm_diff(&base, &base, &diff);
+  bool ok = diff.empty();
+
+  gm_diff(&base, ours, &diff);
+  ok &=    diff.counts[gm_diff_ng_add] == 3
+        && diff.counts[gm_diff_ng_remove] == 3
+        && diff.counts[gm_diff_sg_remove] == 1
+        && diff.counts[gm_diff_sg_attr] == 1;
+
+  groupman_t merged;
+  gm_merge_report_t report;
+  ok &= gm_merge3(&base, ours, theirs, &merged, &report) && report.empty();
+
+  // The merge does what applying both edits does
+  gm_diff(both, &merged, &diff);
+  ok &= diff.empty() && merged.verify_lookups();
+
+  // Both sides group the same nodes differently
+  nodegroup_list_t ngl;
+  ngl.push_back(theirs->find_nodeid_loc(0)->ng);
+  ngl.push_back(theirs->find_nodeid_loc(6)->ng);
+  theirs->combine_ngl(&ngl);
+  theirs->set_sg_name(theirs->find_nodeid_loc(12)->sg, "renamed");
+
+  ok &=    gm_merge3(&base, ours, theirs, &merged, &report)
+        && report.counts[gm_conflict_grouping] == 1
+        && report.counts[gm_conflict_attr] == 1
+        && report.conflicts[0].nodes.size() == 6;
+
+  // Our side wins the conflicts
+  nodeloc_t *loc = merged.find_nodeid_loc(0);
+  ok &=    loc != NULL 
+        && loc->ng->size() == 4
+        && merged.find_nodeid_loc(6)->ng != loc->ng
+        && merged.find_nodeid_loc(12)->sg->name == "ours";
+
+  delete ours;
+  delete theirs;
+  delete both;
+
+  printf("test_merge3: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark the diff and the three-way merge of two edited copies
+*/
+static void bench_merge3(int count)
+{
+  groupman_t base;
+  build_synthetic_gm(&base, count, 3);
+
+  // The edits of both sides overlap every few hundred nodes
+  groupman_t *ours = base.snapshot();
+  groupman_t *theirs = base.snapshot();
+  edit_synthetic_gm(ours, count, 100);
+  edit_synthetic_gm(theirs, count, 97);
+
+  double t0 = get_time_ms();
+  gm_diff_t diff;
+  gm_diff(&base, ours, &diff);
+  double t_diff = get_time_ms() - t0;
+
+  t0 = get_time_ms();
+  groupman_t merged;
+  gm_merge_report_t report;
+  gm_merge3(&base, ours, theirs, &merged, &report);
+  double t_merge = get_time_ms() - t0;
+
+  printf("merge3: nodes=%d diff=%.2fms (%u ops) merge=%.2fms (%u conflicts) %s\n",
+    count,
+    t_diff,
+    uint32(diff.ops.size()),
+    t_merge,
+    uint32(report.conflicts.size()),
+    merged.verify_lookups() && merged.get_nds()->size() == size_t(count) ? "OK" : "MISMATCH");
+
+  delete ours;
+  delete theirs;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Return the blocks of a new analysis of a synthetic groupman.
+*        One node in ten is split in two, one pair in ten is merged, one
+*        node in ten is gone and one block is new. The blocks are numbered
+*        in address order, as IDA would
+* @param old_nids - receives the node each block comes from or -1 for the
+*                   merged and new blocks
+*/
+static void reanalyze_synthetic_gm(
+    groupman_t *gm,
+    gm_blocks_t *blocks,
+    std::vector<int> *old_nids)
+{
+  blocks->clear();
+  old_nids->clear();
+
+  nid2ndef_t *nds = gm->get_nds();
+  ea_t last_end = 0;
+  for (nid2ndef_t::iterator it=nds->begin(); it != nds->end(); ++it)
+  {
+    pnodedef_t nd = it->second;
+    nodedef_t blk = *nd;
+    last_end = nd->end;
+    switch (nd->nid % 10)
+    {
+      case 0:
+      {
+        blk.end = nd->start + (nd->end - nd->start) / 2;
+        blocks->push_back(blk);
+        old_nids->push_back(nd->nid);
+        blk.start = blk.end;
+        blk.end = nd->end;
+        break;
+      }
+      case 5:
+      {
+        nid2ndef_t::iterator next = it;
+        if (++next != nds->end())
+        {
+          blk.end = next->second->end;
+          blocks->push_back(blk);
+          old_nids->push_back(-1);
+          it = next;
+          continue;
+        }
+        break;
+      }
+      case 7:
+        continue;
+    }
+    blocks->push_back(blk);
+    old_nids->push_back(nd->nid);
+  }
+
+  nodedef_t blk;
+  blk.start = last_end + 0x100;
+  blk.end = blk.start + 0x10;
+  blocks->push_back(blk);
+  old_nids->push_back(-1);
+
+  for (size_t i=0; i < blocks->size(); i++)
+    (*blocks)[i].nid = int(i);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the blocks kept the NGs and the SGs of their nodes
+*/
+static bool check_remapped(
+    groupman_t *gm,
+    groupman_t *out,
+    const std::vector<int> &old_nids)
+{
+  typedef std::map<pnodegroup_t, pnodegroup_t> ng2ng_t;
+  ng2ng_t to_new, to_old;
+  for (size_t i=0; i < old_nids.size(); i++)
+  {
+    if (old_nids[i] == -1)
+      continue;
+
+    nodeloc_t *old_loc = gm->find_nodeid_loc(old_nids[i]);
+    nodeloc_t *new_loc = out->find_nodeid_loc(int(i));
+    if (old_loc == NULL || new_loc == NULL || old_loc->sg->id != new_loc->sg->id)
+      return false;
+
+    // The same NGs on both sides
+    ng2ng_t::iterator it = to_new.find(old_loc->ng);
+    if (it == to_new.end())
+      it = to_new.insert(ng2ng_t::value_type(old_loc->ng, new_loc->ng)).first;
+    ng2ng_t::iterator it_old = to_old.find(new_loc->ng);
+    if (it_old == to_old.end())
+      it_old = to_old.insert(ng2ng_t::value_type(new_loc->ng, old_loc->ng)).first;
+    if (it->second != new_loc->ng || it_old->second != old_loc->ng)
+      return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that a grouping follows the blocks of a new analysis
+*/
+static bool test_remap()
+{
+  const int count = 3000;
+
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 3);
+  for (int i=0; i < 40; i++)
+    apply_mixed_edit(&gm, i);
+  add_synthetic_similar(&gm, 1);
+
+  // The same blocks: nothing to do
+  gm_blocks_t blocks;
+  nid2ndef_t *nds = gm.get_nds();
+  for (nid2ndef_t::iterator it=nds->begin(); it != nds->end(); ++it)
+    blocks.push_back(*it->second);
+
+  groupman_t out;
+  gm_remap_report_t report;
+  bool ok = !gm_remap(&gm, blocks, &out, &report) && report.kept == size_t(count);
+
+  // Renumbered blocks
+  std::vector<int> old_nids;
+  for (int i=0; i < count; i++)
+  {
+    old_nids.push_back(blocks[i].nid);
+    blocks[i].nid = count - 1 - i;
+  }
+  std::reverse(old_nids.begin(), old_nids.end());
+  ok &= gm_remap(&gm, blocks, &out, &report)
+     && report.renumbered == size_t(count)
+     && out.get_nds()->size() == size_t(count)
+     && out.get_path_sgl()->size() == gm.get_path_sgl()->size()
+     && out.get_similar_sgl()->size() == gm.get_similar_sgl()->size()
+     && check_remapped(&gm, &out, old_nids);
+
+  // Split, merged, gone and new blocks
+  reanalyze_synthetic_gm(&gm, &blocks, &old_nids);
+  ok &= gm_remap(&gm, blocks, &out, &report)
+     && report.split == count / 10
+     && report.merged == count / 10
+     && report.dropped == 2 * count / 10
+     && report.added == 1
+     && out.get_nds()->size() == blocks.size() - 1
+     && check_remapped(&gm, &out, old_nids)
+     && out.verify_lookups()
+     && out.verify_stats()
+     && out.verify_flat();
+
+  // The halves of the split nodes are in the same NG
+  for (size_t i=1; i < old_nids.size(); i++)
+  {
+    if (old_nids[i] != -1 && old_nids[i] == old_nids[i - 1])
+      ok &= out.find_nodeid_loc(int(i))->ng == out.find_nodeid_loc(int(i - 1))->ng;
+  }
+
+  // The remapped grouping matches the blocks from now on
+  groupman_t again;
+  ok &= !gm_remap(&out, blocks, &again, &report) && report.added == 1;
+
+  printf("test_remap: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark carrying a grouping over to a new analysis
+*/
+static void bench_remap(int count)
+{
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 3);
+  edit_synthetic_gm(&gm, count, 100);
+
+  gm_blocks_t blocks;
+  std::vector<int> old_nids;
+  reanalyze_synthetic_gm(&gm, &blocks, &old_nids);
+
+  double t0 = get_time_ms();
+  groupman_t out;
+  gm_remap_report_t report;
+  bool ok = gm_remap(&gm, blocks, &out, &report);
+  double t_remap = get_time_ms() - t0;
+
+  ok &= check_remapped(&gm, &out, old_nids);
+
+  printf("remap: nodes=%d blocks=%d remap=%.2fms split=%u merged=%u dropped=%u %s\n",
+    count,
+    int(blocks.size()),
+    t_remap,
+    uint32(report.split),
+    uint32(report.merged),
+    uint32(report.dropped),
+    ok ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+//--  HARNESS  -------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------
+/**
+* @brief Shape of a generated grouping
+*/
+struct gen_params_t
+{
+  int sg_count;
+  int ng_per_sg;
+  int nd_per_ng;
+
+  /**
+  * @brief Similar SGs generated per path SG
+  */
+  int similar_copies;
+
+  /**
+  * @brief 0 for uniform shapes. Otherwise the seed used to vary the counts
+  *        around their average and to interleave the nodes of the NGs
+  */
+  uint32 seed;
+
+  gen_params_t(
+      int sg_count = 1000,
+      int ng_per_sg = 1,
+      int nd_per_ng = 4,
+      int similar_copies = 0,
+      uint32 seed = 0)
+      : sg_count(sg_count), ng_per_sg(ng_per_sg), nd_per_ng(nd_per_ng),
+        similar_copies(similar_copies), seed(seed)
+  {
+  }
+};
+
+//--------------------------------------------------------------------------
+static uint32 gen_rand(uint32 *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 1;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Pick a count averaging 'avg'
+*/
+static int gen_count(
+    int avg,
+    bool vary,
+    uint32 *seed)
+{
+  if (!vary || avg <= 1)
+    return avg;
+  return 1 + int(gen_rand(seed) % uint32(2 * avg - 1));
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Build a grouping of the given shape. Node ids follow the addresses
+*/
+static void build_generated_gm(
+    groupman_t *gm,
+    const gen_params_t &p)
+{
+  gm->clear();
+
+  bool vary = p.seed != 0;
+  uint32 seed = p.seed;
+
+  // Lay out the shape first
+  std::vector<int> ng_sizes;
+  std::vector<int> sg_ngs(p.sg_count);
+  int node_count = 0;
+  for (int i=0; i < p.sg_count; i++)
+  {
+    sg_ngs[i] = gen_count(p.ng_per_sg, vary, &seed);
+    for (int j=0; j < sg_ngs[i]; j++)
+    {
+      ng_sizes.push_back(gen_count(p.nd_per_ng, vary, &seed));
+      node_count += ng_sizes.back();
+    }
+  }
+
+  // Varied shapes group nodes that are close but not always adjacent
+  std::vector<int> order(node_count);
+  for (int i=0; i < node_count; i++)
+    order[i] = i;
+  if (vary)
+  {
+    for (int i=0; i < node_count; i++)
+      std::swap(order[i], order[qmin(node_count - 1, i + int(gen_rand(&seed) % 16))]);
+  }
+
+  std::vector<ea_t> starts(node_count + 1);
+  ea_t ea = 0x401000;
+  for (int i=0; i <= node_count; i++)
+  {
+    starts[i] = ea;
+    ea += 0x10 + (vary ? gen_rand(&seed) % 8 : i % 7) * 4;
+  }
+
+  size_t k = 0, i_ng = 0;
+  for (int i=0; i < p.sg_count; i++)
+  {
+    psupergroup_t sg = gm->add_supergroup();
+    sg->id.sprnt("ID_%d", i);
+    if (vary && gen_rand(&seed) % 4 == 0)
+      sg->name.sprnt("group %d", i);
+
+    for (int j=0; j < sg_ngs[i]; j++)
+    {
+      pnodegroup_t ng = sg->add_nodegroup();
+      for (int n=ng_sizes[i_ng++]; n > 0; n--)
+      {
+        int nid = order[k++];
+        pnodedef_t nd = ng->add_node();
+        nd->nid = nid;
+        nd->start = starts[nid];
+        nd->end = starts[nid + 1];
+        gm->map_nodedef(nid, nd);
+      }
+    }
+  }
+
+  add_synthetic_similar(gm, p.similar_copies);
+  gm->initialize_lookups();
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Print the memory used by a group manager
+*/
+static void print_mem_stats(groupman_t *gm)
+{
+  gm_mem_stats_t st;
+  gm->get_mem_stats(&st);
+
+  printf("memory: sgs=%d ngs=%d nds=%d%s\n",
+    int(st.sg_count),
+    int(st.ng_count),
+    int(st.nd_count),
+    st.shared ? " (arena shared with snapshots)" : "");
+
+  for (int i=0; i < gm_mem_count; i++)
+  {
+    printf("  %-14s %12.1fKB  peak %12.1fKB\n",
+      gm_mem_stats_t::get_category_name(gm_mem_category_e(i)),
+      st.bytes[i] / 1024.0,
+      st.peak[i] / 1024.0);
+  }
+  printf("  %-14s %12.1fKB  peak %12.1fKB\n",
+    "total",
+    st.total / 1024.0,
+    st.peak_total / 1024.0);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that the memory accounting follows the loads and the clears
+*/
+static bool test_mem_stats()
+{
+  groupman_t gm;
+  build_generated_gm(&gm, gen_params_t(2000, 2, 3, 1, 0x77));
+  gm.find_node_loc(0x401000);
+
+  gm_mem_stats_t st;
+  gm.get_mem_stats(&st);
+
+  bool ok = st.nd_count == gm.get_nds()->size() && !st.shared;
+  for (int i=0; i < gm_mem_count; i++)
+  {
+    // Nothing was recorded in the journal
+    if (i != gm_mem_journal)
+      ok &= st.bytes[i] != 0;
+    ok &= st.peak[i] >= st.bytes[i];
+  }
+
+  // The NGs of the similar SGs share the nodes of the path SGs
+  ok &= st.bytes[gm_mem_list_nodes] >= 2 * st.nd_count * sizeof(pnodedef_t);
+
+  // A snapshot shares the arena
+  groupman_t *snap = gm.snapshot();
+  gm_mem_stats_t snap_st;
+  snap->get_mem_stats(&snap_st);
+  ok &= snap_st.shared && snap_st.bytes[gm_mem_list_nodes] == st.bytes[gm_mem_list_nodes];
+  delete snap;
+
+  // Clearing keeps the peaks
+  size_t peak_total = st.peak_total;
+  gm.clear();
+  gm.get_mem_stats(&st);
+  ok &= st.bytes[gm_mem_list_nodes] == 0 && st.bytes[gm_mem_nd_objects] == 0;
+  ok &= st.peak_total >= peak_total && st.total < peak_total;
+
+  printf("test_mem_stats: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Time the rounds of a benchmark
+*/
+class bench_timer_t
+{
+  std::vector<double> times;
+  double t0;
+
+public:
+  inline void start() { t0 = get_time_ms(); }
+  inline void stop()  { times.push_back(get_time_ms() - t0); }
+  inline int rounds() { return int(times.size()); }
+
+  double min_ms()
+  {
+    return times.empty() ? 0.0 : *std::min_element(times.begin(), times.end());
+  }
+
+  double median_ms()
+  {
+    if (times.empty())
+      return 0.0;
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[sorted.size() / 2];
+  }
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Print a benchmark result and add it to the results file.
+*        The rate is 'work' units per second for the fastest round
+*/
+static void report_bench(
+    FILE *fp,
+    const char *shape,
+    int node_count,
+    uint64 bytes,
+    const char *bench,
+    bench_timer_t &t,
+    double work,
+    const char *unit,
+    bool ok)
+{
+  double min_ms = t.min_ms();
+  double rate = min_ms > 0 ? work * 1000.0 / min_ms : 0.0;
+
+  printf("  %-13s min=%9.3fms median=%9.3fms %10.2f %s %s\n",
+    bench,
+    min_ms,
+    t.median_ms(),
+    rate,
+    unit,
+    ok ? "OK" : "MISMATCH");
+
+  if (fp != NULL)
+  {
+    qfprintf(fp, "%s,%d,%" FMT_64 "u,%s,%d,%.3f,%.3f,%.2f,%s,%d\n",
+      shape,
+      node_count,
+      bytes,
+      bench,
+      t.rounds(),
+      min_ms,
+      t.median_ms(),
+      rate,
+      unit,
+      ok ? 1 : 0);
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Run the parse, emit and lookup benchmarks on one shape
+* @return False if a result did not match the generated grouping
+*/
+static bool bench_shape(
+    FILE *fp,
+    const char *shape,
+    const gen_params_t &p)
+{
+  static const char src_file[] = "suite_src.bbgroup";
+  static const char bin_file[] = "suite_src.bbgbin";
+  static const char out_file[] = "suite_out.bbgroup";
+  const int rounds = 5;
+
+  groupman_t gm;
+  build_generated_gm(&gm, p);
+  gm.emit(src_file);
+  gm.emit(bin_file);
+
+  qstring src, bin, out;
+  read_file(src_file, &src);
+  read_file(bin_file, &bin);
+
+  int node_count = int(gm.get_nds()->size());
+  uint64 bytes = src.length();
+  double mb = src.length() / (1024.0 * 1024.0);
+  double bin_mb = bin.length() / (1024.0 * 1024.0);
+
+  printf("%s: sgs=%d ngs/sg=%d nds/ng=%d similar=%d seed=%u nodes=%d size=%.2fMB\n",
+    shape,
+    p.sg_count,
+    p.ng_per_sg,
+    p.nd_per_ng,
+    p.similar_copies,
+    p.seed,
+    node_count,
+    mb);
+
+  bool all_ok = true;
+  bench_timer_t t;
+
+  // Mapped file: the similar SGs are deferred
+  bool ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    ok &= gm.parse(src_file);
+    t.stop();
+  }
+  ok &= gm.emit(out_file) && read_file(out_file, &out) && out == src;
+  report_bench(fp, shape, node_count, bytes, "parse_text", t, mb, "MB/s", ok);
+  all_ok &= ok;
+
+  // In memory buffer: no file I/O and no deferral
+  t = bench_timer_t();
+  ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    ok &= gm.parse_buffer(src.c_str(), src.length());
+    t.stop();
+  }
+  ok &= gm.emit(out_file) && read_file(out_file, &out) && out == src;
+  report_bench(fp, shape, node_count, bytes, "parse_buffer", t, mb, "MB/s", ok);
+  all_ok &= ok;
+
+  t = bench_timer_t();
+  ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    ok &= gm.parse(bin_file);
+    t.stop();
+  }
+  ok &= gm.emit(out_file) && read_file(out_file, &out) && out == src;
+  report_bench(fp, shape, node_count, bin.length(), "parse_bin", t, bin_mb, "MB/s", ok);
+  all_ok &= ok;
+
+  t = bench_timer_t();
+  ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    ok &= gm.emit(out_file);
+    t.stop();
+  }
+  ok &= read_file(out_file, &out) && out == src;
+  report_bench(fp, shape, node_count, bytes, "emit_text", t, mb, "MB/s", ok);
+  all_ok &= ok;
+
+  t = bench_timer_t();
+  ok = true;
+  std::vector<char> bin_out;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    ok &= gm.emit_bin_buffer(&bin_out);
+    t.stop();
+  }
+  ok &= bin_out.size() == bin.length() && memcmp(&bin_out[0], bin.c_str(), bin.length()) == 0;
+  report_bench(fp, shape, node_count, bin.length(), "emit_bin", t, bin_mb, "MB/s", ok);
+  all_ok &= ok;
+
+  // Node id lookups, in a scattered order
+  std::vector<int> nids;
+  nid2ndef_t *nds = gm.get_nds();
+  for (nid2ndef_t::iterator it=nds->begin(); it != nds->end(); ++it)
+    nids.push_back(it->first);
+  for (size_t i=0; i < nids.size(); i++)
+    std::swap(nids[i], nids[bench_rand() % nids.size()]);
+
+  t = bench_timer_t();
+  ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    for (size_t j=0; j < nids.size(); j++)
+    {
+      nodeloc_t *loc = gm.find_nodeid_loc(nids[j]);
+      ok &= loc != NULL && loc->nd->nid == nids[j];
+    }
+    t.stop();
+  }
+  report_bench(fp, shape, node_count, bytes, "lookup_nid", t, nids.size() / 1e6, "Mlookups/s", ok);
+  all_ok &= ok;
+
+  // Address lookups inside the function
+  ea_t lo = nds->begin()->second->start;
+  ea_t hi = nds->rbegin()->second->end;
+  std::vector<ea_t> eas;
+  for (size_t i=0; i < nids.size(); i++)
+    eas.push_back(lo + bench_rand() % (hi - lo));
+
+  t = bench_timer_t();
+  ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t.start();
+    for (size_t j=0; j < eas.size(); j++)
+    {
+      nodeloc_t *loc = gm.find_node_loc(eas[j]);
+      ok &= loc != NULL && eas[j] >= loc->nd->start && eas[j] < loc->nd->end;
+    }
+    t.stop();
+  }
+  report_bench(fp, shape, node_count, bytes, "lookup_addr", t, eas.size() / 1e6, "Mlookups/s", ok);
+  all_ok &= ok;
+
+  print_mem_stats(&gm);
+
+  qunlink(src_file);
+  qunlink(bin_file);
+  qunlink(out_file);
+
+  return all_ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Run the benchmark suite of the groupman subsystem
+* @param results_file - if not NULL, receives the results as CSV
+*/
+static bool run_suite(const char *results_file)
+{
+  FILE *fp = NULL;
+  if (results_file != NULL)
+  {
+    fp = qfopen(results_file, "w");
+    if (fp == NULL)
+    {
+      printf("failed to create '%s'\n", results_file);
+      return false;
+    }
+    qfprintf(fp, "shape,nodes,bytes,bench,rounds,min_ms,median_ms,rate,unit,ok\n");
+  }
+
+  bool ok = true;
+  ok &= bench_shape(fp, "flat",    gen_params_t(200000, 1, 1));
+  ok &= bench_shape(fp, "default", gen_params_t(50000, 1, 4));
+  ok &= bench_shape(fp, "wide",    gen_params_t(2000, 25, 4));
+  ok &= bench_shape(fp, "varied",  gen_params_t(20000, 3, 3, 0, 0x5EED));
+  ok &= bench_shape(fp, "similar", gen_params_t(50000, 1, 4, 2));
+
+  if (fp != NULL)
+    qfclose(fp);
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Parse one input and check the invariants of the result.
+*        Failures abort so that fuzzers record them as crashes
+*/
+static int fuzz_parse_one(
+    const uint8 *data,
+    size_t size)
+{
+  const char *buf = (const char *)data;
+
+  groupman_t gm;
+  if (!gm.parse_bin_buffer(buf, size))
+    gm.parse_buffer(buf, size);
+
+  if (!gm.verify_lookups() || !gm.verify_stats())
+    abort();
+
+  // Whatever was parsed must survive a binary round trip
+  std::vector<char> bin1, bin2;
+  groupman_t gm2;
+  if (   !gm.emit_bin_buffer(&bin1)
+      || !gm2.parse_bin_buffer(bin1.empty() ? NULL : &bin1[0], bin1.size())
+      || !gm2.emit_bin_buffer(&bin2)
+      || bin1 != bin2)
+  {
+    abort();
+  }
+
+  // Look up every parsed node
+  nid2ndef_t *nds = gm.get_nds();
+  for (nid2ndef_t::iterator it=nds->begin(); it != nds->end(); ++it)
+  {
+    nodeloc_t *loc = gm.find_nodeid_loc(it->first);
+    if (loc == NULL || loc->nd != it->second)
+      abort();
+    gm.find_node_loc(it->second->start);
+  }
+  return 0;
+}
+
+#ifdef GM_FUZZER
+//--------------------------------------------------------------------------
+// libFuzzer entry point, built without main():
+//   clang++ -DGM_FUZZER -fsanitize=fuzzer,address <stdalone sources>
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+  return fuzz_parse_one(data, size);
+}
+#endif
+
+//--------------------------------------------------------------------------
+/**
+* @brief Derive an input from a seed: flip, insert, drop or duplicate bytes
+*/
+static void fuzz_mutate(std::vector<uint8> *buf)
+{
+  static const char *const tokens[] =
+  {
+    "ID:", "GROUPNAME:", "NODESET:", "(", ")", ", ", " : ", ";", "\n",
+    "--SIMILARINFO\n", "--", "-", "FFFFFFFF", "2147483648", "0"
+  };
+
+  int count = 1 + bench_rand() % 8;
+  for (int i=0; i < count; i++)
+  {
+    size_t size = buf->size();
+    size_t pos = size == 0 ? 0 : bench_rand() % size;
+    switch (bench_rand() % 6)
+    {
+      case 0:
+        if (size != 0)
+          (*buf)[pos] ^= uint8(1 << (bench_rand() % 8));
+        break;
+      case 1:
+        if (size != 0)
+          (*buf)[pos] = uint8(bench_rand());
+        break;
+      case 2:
+      {
+        const char *tok = tokens[bench_rand() % qnumber(tokens)];
+        buf->insert(buf->begin() + pos, tok, tok + strlen(tok));
+        break;
+      }
+      case 3:
+      {
+        size_t n = qmin(size - pos, size_t(1 + bench_rand() % 32));
+        buf->erase(buf->begin() + pos, buf->begin() + pos + n);
+        break;
+      }
+      case 4:
+      {
+        size_t n = qmin(size - pos, size_t(1 + bench_rand() % 64));
+        std::vector<uint8> chunk(buf->begin() + pos, buf->begin() + pos + n);
+        size_t at = size == 0 ? 0 : bench_rand() % size;
+        buf->insert(buf->begin() + at, chunk.begin(), chunk.end());
+        break;
+      }
+      case 5:
+        buf->resize(pos);
+        break;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Run the parse fuzzer without libFuzzer: replay the given files
+*        then feed mutations of them and of generated groupings
+*/
+static bool run_fuzz(
+    int iterations,
+    int file_count,
+    char *files[])
+{
+  std::vector< std::vector<uint8> > seeds;
+  for (int i=0; i < file_count; i++)
+  {
+    qstring data;
+    if (!read_file(files[i], &data))
+    {
+      printf("failed to read '%s'\n", files[i]);
+      return false;
+    }
+    seeds.push_back(std::vector<uint8>(data.begin(), data.end()));
+
+    // An exact size buffer lets the sanitizers catch overreads
+    std::vector<uint8> &s = seeds.back();
+    fuzz_parse_one(s.empty() ? NULL : &s[0], s.size());
+  }
+
+  // Small generated groupings in both formats
+  static const char gen_file[] = "fuzz_seed.bbgroup";
+  static const char gen_bin_file[] = "fuzz_seed.bbgbin";
+  for (int i=0; i < 4; i++)
+  {
+    groupman_t gm;
+    build_generated_gm(&gm, gen_params_t(3 + i, 2, 2, i % 2, i + 1));
+    gm.emit(gen_file);
+    gm.emit(gen_bin_file);
+
+    qstring data;
+    read_file(gen_file, &data);
+    seeds.push_back(std::vector<uint8>(data.begin(), data.end()));
+    read_file(gen_bin_file, &data);
+    seeds.push_back(std::vector<uint8>(data.begin(), data.end()));
+  }
+  qunlink(gen_file);
+  qunlink(gen_bin_file);
+
+  double t0 = get_time_ms();
+  for (int i=0; i < iterations; i++)
+  {
+    std::vector<uint8> input(seeds[bench_rand() % seeds.size()]);
+    fuzz_mutate(&input);
+    std::vector<uint8>(input).swap(input);
+    fuzz_parse_one(input.empty() ? NULL : &input[0], input.size());
+  }
+
+  printf("fuzz: seeds=%d iterations=%d time=%.2fms\n",
+    int(seeds.size()),
+    iterations,
+    get_time_ms() - t0);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Build the version 'v' of a published grouping: all its SGs have
+*        the same name so readers can tell if they see a mix of versions
+*/
+static groupman_t *build_pub_version(int v)
+{
+  groupman_t *gm = new groupman_t();
+  build_generated_gm(gm, gen_params_t(200 + v % 50, 2, 3, v % 2, v + 1));
+
+  qstring name;
+  name.sprnt("v%d", v);
+  psupergroup_listp_t sgl = gm->get_path_sgl();
+  for (supergroup_listp_t::iterator it=sgl->begin(); it != sgl->end(); ++it)
+    (*it)->name = name;
+
+  return gm;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Check that a version read by a reader is whole and unchanged
+*/
+static bool check_pub_version(groupman_t *gm)
+{
+  psupergroup_listp_t sgl = gm->get_path_sgl();
+  if (sgl->empty())
+    return false;
+
+  const qstring &name = sgl->front()->name;
+  size_t node_count = 0;
+  for (supergroup_listp_t::iterator it=sgl->begin(); it != sgl->end(); ++it)
+  {
+    psupergroup_t sg = *it;
+    if (sg->name != name)
+      return false;
+    node_count += sg->get_stats().node_count;
+  }
+
+  pnodedef_t nd = gm->get_first_nd();
+  nodeloc_t *loc = nd == NULL ? NULL : gm->find_node_loc(nd->start);
+  return node_count == gm->get_nds()->size() && loc != NULL && loc->nd == nd;
+}
+
+//--------------------------------------------------------------------------
+struct pub_reader_ctx_t
+{
+  gm_publisher_t *pub;
+  std::atomic<bool> *stop;
+  size_t reads;
+  bool ok;
+};
+
+static void pub_reader_thread(pub_reader_ctx_t *ctx)
+{
+  int slot = ctx->pub->register_reader();
+  ctx->ok = slot != -1;
+  ctx->reads = 0;
+  while (ctx->ok && !ctx->stop->load())
+  {
+    gm_read_guard_t guard(ctx->pub, slot);
+    groupman_t *gm = guard.get();
+    if (gm == NULL)
+      continue;
+
+    // Hold the version a while so that writers retire it under us
+    for (int i=0; i < 3; i++)
+      ctx->ok &= check_pub_version(gm);
+    ++ctx->reads;
+  }
+  ctx->pub->unregister_reader(slot);
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Use a publisher owned by another thread
+*/
+static void pub_other_thread(gm_publisher_t *pub, bool *ok)
+{
+  groupman_t *gm = build_pub_version(1);
+  *ok =    !pub->publish(gm)
+        && pub->register_reader() == -1
+        && !pub->can_edit(pub->peek());
+  delete gm;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Readers check the versions while a writer publishes new ones
+*/
+static bool test_publish()
+{
+  const int reader_count = 4;
+  const int version_count = 200;
+
+  gm_publisher_t pub;
+  std::atomic<bool> stop(false);
+
+  bool ok = true;
+
+  // Versions sharing their groups cannot be published
+  groupman_t *gm = build_pub_version(0);
+  groupman_t *snap = gm->snapshot();
+  ok &= !pub.publish(snap);
+  delete snap;
+  ok &= pub.publish(gm);
+
+  std::vector<pub_reader_ctx_t> ctx(reader_count);
+  std::vector<std::thread> threads;
+  for (int i=0; i < reader_count; i++)
+  {
+    ctx[i].pub = &pub;
+    ctx[i].stop = &stop;
+    threads.push_back(std::thread(pub_reader_thread, &ctx[i]));
+  }
+
+  for (int v=1; v < version_count; v++)
+    ok &= pub.publish(build_pub_version(v));
+
+  stop = true;
+  for (int i=0; i < reader_count; i++)
+  {
+    threads[i].join();
+    ok &= ctx[i].ok && ctx[i].reads > 0;
+  }
+
+  // Without readers everything retired can go
+  ok &= pub.reclaim() == 0;
+
+  // A pinned version outlives the versions published after it
+  int slot = pub.register_reader();
+  groupman_t *pinned = pub.read_lock(slot);
+  pub.publish(build_pub_version(version_count));
+  pub.publish(build_pub_version(version_count + 1));
+  ok &= pub.get_retired_count() == 2 && check_pub_version(pinned);
+  ok &= pub.read_lock(slot) == pinned;
+  pub.read_unlock(slot);
+  pub.read_unlock(slot);
+  ok &= pub.reclaim() == 0;
+  pub.unregister_reader(slot);
+
+  // Versions are only changed in place by the thread owning the publisher
+  ok &= !pub.can_edit(pub.peek());
+  gm_publisher_t owned_pub;
+  owned_pub.set_owner_thread();
+  slot = owned_pub.register_reader();
+  owned_pub.publish(build_pub_version(0));
+  pinned = owned_pub.read_lock(slot);
+  ok &= owned_pub.can_edit(pinned);
+
+  bool other_ok = false;
+  std::thread other(pub_other_thread, &owned_pub, &other_ok);
+  other.join();
+  ok &= other_ok;
+
+  // A replaced version cannot be changed anymore
+  owned_pub.publish(build_pub_version(1));
+  ok &= !owned_pub.can_edit(pinned) && owned_pub.can_edit(owned_pub.peek());
+  owned_pub.read_unlock(slot);
+  owned_pub.unregister_reader(slot);
+
+  printf("test_publish: %s\n", ok ? "OK" : "FAILED");
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark a read section against taking a mutex
+*/
+static void bench_publish(int count)
+{
+  gm_publisher_t pub;
+  pub.publish(build_pub_version(0));
+  int slot = pub.register_reader();
+
+  size_t sum = 0;
+  double t0 = get_time_ms();
+  for (int i=0; i < count; i++)
+  {
+    gm_read_guard_t guard(&pub, slot);
+    sum += guard.get()->get_nds()->size();
+  }
+  double t_read = get_time_ms() - t0;
+
+  std::mutex mtx;
+  groupman_t *gm = pub.peek();
+  t0 = get_time_ms();
+  for (int i=0; i < count; i++)
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    sum -= gm->get_nds()->size();
+  }
+  double t_mutex = get_time_ms() - t0;
+
+  // Publishing settles the version: part of the cost is building lookups
+  const int versions = 100;
+  std::vector<groupman_t *> gms;
+  for (int v=1; v <= versions; v++)
+    gms.push_back(build_pub_version(v));
+  t0 = get_time_ms();
+  for (int v=0; v < versions; v++)
+    pub.publish(gms[v]);
+  double t_publish = get_time_ms() - t0;
+
+  pub.unregister_reader(slot);
+
+  printf("publish: reads=%d read_section=%.1fns mutex=%.1fns publish=%.3fms %s\n",
+    count,
+    t_read * 1e6 / count,
+    t_mutex * 1e6 / count,
+    t_publish / versions,
+    sum == 0 ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Sum the node ids and addresses by walking the lists
+*/
+static uint64 walk_lists(psupergroup_listp_t sgl)
+{
+  uint64 sum = 0;
+  for (supergroup_listp_t::iterator it=sgl->begin();
+       it != sgl->end();
+       ++it)
+  {
+    psupergroup_t sg = *it;
+    for (nodegroup_list_t::iterator it=sg->groups.begin();
+         it != sg->groups.end();
+         ++it)
+    {
+      pnodegroup_t ng = *it;
+      for (nodegroup_t::iterator it=ng->begin(); it != ng->end(); ++it)
+      {
+        pnodedef_t nd = *it;
+        sum += nd->nid + nd->start + nd->end;
+      }
+    }
+  }
+  return sum;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Sum the node ids and addresses by walking the flat view
+*/
+static uint64 walk_flat(const gm_flat_t *flat)
+{
+  uint64 sum = 0;
+  for (size_t i=0; i < flat->sg_count(); i++)
+  {
+    for (uint32 j=flat->ng_begin(i); j < flat->ng_end(i); j++)
+    {
+      for (uint32 k=flat->nd_begin(j); k < flat->nd_end(j); k++)
+        sum += flat->nids[k] + flat->starts[k] + flat->ends[k];
+    }
+  }
+  return sum;
+}
+
+//--------------------------------------------------------------------------
+/**
+* @brief Benchmark the full walks of an edited grouping: lists vs. flat view
+*/
+static void bench_flat(int count, int edit_step)
+{
+  const int rounds = 5;
+
+  // Edits scatter the list nodes over the heap
+  groupman_t gm;
+  build_synthetic_gm(&gm, count, 4);
+  edit_synthetic_gm(&gm, count, edit_step);
+
+  psupergroup_listp_t sgl = gm.get_path_sgl();
+  bench_timer_t t_lists, t_build, t_flat, t_cold, t_warm, t_lookups;
+  uint64 sum_lists = 0, sum_flat = 0;
+  bool ok = true;
+  for (int i=0; i < rounds; i++)
+  {
+    t_lists.start();
+    sum_lists = walk_lists(sgl);
+    t_lists.stop();
+
+    gm.invalidate_flat();
+    t_build.start();
+    const gm_flat_t *flat = gm.get_flat();
+    t_build.stop();
+
+    t_flat.start();
+    sum_flat = walk_flat(flat);
+    t_flat.stop();
+
+    // Writing the text once the view is out of date then up to date
+    qstring cold, warm;
+    gm.invalidate_flat();
+    t_cold.start();
+    ok &= emit_to_string(&gm, &cold);
+    t_cold.stop();
+
+    t_warm.start();
+    ok &= emit_to_string(&gm, &warm) && warm == cold;
+    t_warm.stop();
+
+    t_lookups.start();
+    gm.initialize_lookups();
+    t_lookups.stop();
+  }
+
+  ok &= sum_lists == sum_flat && gm.verify_lookups() && gm.verify_flat();
+
+  gm_mem_stats_t st;
+  gm.get_mem_stats(&st);
+
+  printf("flat: nodes=%d sgs=%d walk_lists=%.2fms build=%.2fms walk_flat=%.2fms emit_cold=%.2fms emit_warm=%.2fms lookups=%.2fms flat_bytes=%u %s\n",
+    count,
+    int(gm.get_flat()->sg_count()),
+    t_lists.min_ms(),
+    t_build.min_ms(),
+    t_flat.min_ms(),
+    t_cold.min_ms(),
+    t_warm.min_ms(),
+    t_lookups.min_ms(),
+    uint32(st.bytes[gm_mem_flat]),
+    ok ? "OK" : "MISMATCH");
+}
+
+//--------------------------------------------------------------------------
+static bool run_tests()
+{
+  bool ok = true;
+  ok &= test_addr_index();
+  ok &= test_nodeloc_table();
+  ok &= test_emit_roundtrip();
+  ok &= test_snapshot();
+  ok &= test_journal();
+  ok &= test_stats();
+  ok &= test_flat();
+  ok &= test_changes();
+  ok &= test_hier_expand();
+  ok &= test_lazy_similar();
+  ok &= test_merge3();
+  ok &= test_remap();
+  ok &= test_publish();
+  ok &= test_mem_stats();
+  return ok;
+}
+
+//--------------------------------------------------------------------------
+static void run_benchmarks()
+{
+  static const int sizes[] = {1000, 5000, 20000};
+  for (size_t i=0; i < qnumber(sizes); i++)
+    bench_addr_lookup(sizes[i]);
+
+  static const int nodeloc_sizes[] = {10000, 100000, 1000000};
+  for (size_t i=0; i < qnumber(nodeloc_sizes); i++)
+    bench_nodeloc_lookup(nodeloc_sizes[i]);
+
+  for (size_t i=0; i < qnumber(nodeloc_sizes); i++)
+    bench_arena(nodeloc_sizes[i]);
+
+  for (size_t i=0; i < qnumber(nodeloc_sizes); i++)
+    bench_parse(nodeloc_sizes[i]);
+
+  bench_bbgdb(5000);
+
+  for (size_t i=0; i < qnumber(nodeloc_sizes); i++)
+    bench_emit(nodeloc_sizes[i]);
+
+  bench_merges(20000, 2);
+  bench_merges(20000, 200);
+
+  bench_snapshot(1000000, 1000);
+
+  bench_journal(1000000, 1000);
+
+  bench_lazy_similar(1000000, 2);
+
+  bench_merge3(100000);
+  bench_merge3(1000000);
+
+  bench_remap(1000000);
+
+  bench_publish(10000000);
+
+  bench_flat(1000000, 100);
+}
+
+#ifndef GM_FUZZER
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && stricmp(argv[1], "bench") == 0)
+  {
+    run_benchmarks();
+    return 0;
+  }
+
+  if (argc > 1 && stricmp(argv[1], "test") == 0)
+    return run_tests() ? 0 : 1;
+
+  if (argc > 1 && stricmp(argv[1], "suite") == 0)
+    return run_suite(argc > 2 ? argv[2] : NULL) ? 0 : 1;
+
+  if (argc > 1 && stricmp(argv[1], "fuzz") == 0)
+  {
+    int iterations = argc > 2 ? atoi(argv[2]) : 100000;
+    return run_fuzz(iterations, qmax(argc - 3, 0), argv + 3) ? 0 : 1;
+  }
+
+  if (argc > 5 && stricmp(argv[1], "gen") == 0)
+  {
+    gen_params_t p(
+      atoi(argv[3]),
+      atoi(argv[4]),
+      atoi(argv[5]),
+      argc > 6 ? atoi(argv[6]) : 0,
+      argc > 7 ? uint32(strtoul(argv[7], NULL, 0)) : 0);
+
+    groupman_t gm;
+    build_generated_gm(&gm, p);
+    if (!gm.emit(argv[2]))
+    {
+      printf("failed to write '%s'\n", argv[2]);
+      return 1;
+    }
+    printf("%s: %d nodes\n", argv[2], int(gm.get_nds()->size()));
+    return 0;
+  }
+
+  if (argc > 3 && stricmp(argv[1], "diff") == 0)
+  {
+    groupman_t a, b;
+    if (!a.parse(argv[2]) || !b.parse(argv[3]))
+    {
+      printf("failed to parse the groupings\n");
+      return 1;
+    }
+
+    gm_diff_t diff;
+    gm_diff(&a, &b, &diff);
+    print_diff(diff);
+    return diff.empty() ? 0 : 1;
+  }
+
+  if (argc > 5 && stricmp(argv[1], "merge") == 0)
+  {
+    groupman_t base, ours, theirs, merged;
+    if (!base.parse(argv[2]) || !ours.parse(argv[3]) || !theirs.parse(argv[4]))
+    {
+      printf("failed to parse the groupings\n");
+      return 1;
+    }
+
+    gm_merge_report_t report;
+    if (!gm_merge3(&base, &ours, &theirs, &merged, &report) || !merged.emit(argv[5]))
+    {
+      printf("failed to merge into '%s'\n", argv[5]);
+      return 1;
+    }
+    print_merge_report(report);
+    return report.empty() ? 0 : 1;
+  }
+
+  if (argc > 2 && stricmp(argv[1], "mem") == 0)
+  {
+    groupman_t gm;
+    if (!gm.parse(argv[2]))
+    {
+      printf("failed to parse '%s'\n", argv[2]);
+      return 1;
+    }
+    print_mem_stats(&gm);
+    return 0;
+  }
+
+  if (argc > 3 && stricmp(argv[1], "convert") == 0)
+  {
+    if (!groupman_t::convert(argv[2], argv[3]))
+    {
+      printf("failed to convert '%s' to '%s'\n", argv[2], argv[3]);
+      return 1;
+    }
+    return 0;
+  }
+
   groupman_t gm;
 
   gm.parse("f1.txt");
@@ -15,4 +3096,5 @@ int main()
   }
 
   return 0;
-}
\ No newline at end of file
+}
+#endif
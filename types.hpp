@@ -22,6 +22,30 @@ struct gnode_t
   int id;
   qstring text;
   qstring hint;
+
+  /**
+  * @brief Start and end addresses of the blocks of the node, one after the
+  *        other. Their disassembly is generated on the first request for
+  *        the text or the hint: it is appended to the text if 'text_pending'
+  *        and makes the hint if 'hint_pending'
+  */
+  eavec_t blocks;
+  bool text_pending;
+  bool hint_pending;
+
+  /**
+  * @brief Database change generation of the generated disassembly, 0 if
+  *        none, and length of the text that precedes it. The disassembly
+  *        is generated again once the database changed
+  */
+  uint32 text_gen;
+  uint32 hint_gen;
+  size_t text_base;
+
+  gnode_t(): id(0), text_pending(false), hint_pending(false),
+             text_gen(0), hint_gen(0), text_base(0)
+  {
+  }
 };
 
 //--------------------------------------------------------------------------
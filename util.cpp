@@ -1,6 +1,8 @@
 #include "util.h"
 #include <kernwin.hpp>
 #include <prodir.h>
+#include <loader.hpp>
+#include <idp.hpp>
 
 /*--------------------------------------------------------------------------
 
@@ -77,6 +79,141 @@ void get_disasm_text(
   }
 }
 
+//--------------------------------------------------------------------------
+// Starts at 1 so that new caches are emptied on first use
+static uint32 idb_change_gen = 1;
+
+//--------------------------------------------------------------------------
+static int idaapi idb_changes_cb(
+    void * /*user_data*/, 
+    int /*notification_code*/, 
+    va_list /*va*/)
+{
+  // Any database event may alter the disassembly text: comments, types,
+  // operand types, patches...
+  ++idb_change_gen;
+  return 0;
+}
+
+//--------------------------------------------------------------------------
+static int idaapi idp_changes_cb(
+    void * /*user_data*/, 
+    int notification_code, 
+    va_list /*va*/)
+{
+  // Renames and code/data (un)definitions are only reported to the
+  // processor module
+  switch (notification_code)
+  {
+    case processor_t::renamed:
+    case processor_t::make_code:
+    case processor_t::make_data:
+    case processor_t::undefine:
+      ++idb_change_gen;
+      break;
+  }
+
+  // Let the processor module handle the event
+  return 0;
+}
+
+//--------------------------------------------------------------------------
+void hook_idb_changes()
+{
+  hook_to_notification_point(HT_IDB, idb_changes_cb, NULL);
+  hook_to_notification_point(HT_IDP, idp_changes_cb, NULL);
+}
+
+//--------------------------------------------------------------------------
+void unhook_idb_changes()
+{
+  unhook_from_notification_point(HT_IDP, idp_changes_cb, NULL);
+  unhook_from_notification_point(HT_IDB, idb_changes_cb, NULL);
+}
+
+//--------------------------------------------------------------------------
+uint32 get_idb_change_gen()
+{
+  return idb_change_gen;
+}
+
+//--------------------------------------------------------------------------
+void disasm_cache_t::append(ea_t start, ea_t end, qstring *out)
+{
+  if (gen != idb_change_gen)
+  {
+    clear();
+    gen = idb_change_gen;
+  }
+
+  std::pair<iterator, bool> ins = insert(
+    std::make_pair(std::make_pair(start, end), qstring()));
+
+  if (ins.second)
+    get_disasm_text(start, end, &ins.first->second);
+
+  out->append(ins.first->second);
+}
+
+//--------------------------------------------------------------------------
+static void get_gnode_disasm(
+    gnode_t *node, 
+    disasm_cache_t *cache, 
+    qstring *out)
+{
+  for (size_t i=0; i + 1 < node->blocks.size(); i += 2)
+  {
+    if (cache != NULL)
+      cache->append(node->blocks[i], node->blocks[i + 1], out);
+    else
+      get_disasm_text(node->blocks[i], node->blocks[i + 1], out);
+  }
+}
+
+//--------------------------------------------------------------------------
+const qstring &get_gnode_text(
+    gnode_t *node, 
+    disasm_cache_t *cache)
+{
+  // Regenerate the disassembly once the database changed
+  if (node->text_gen != 0 && node->text_gen != idb_change_gen)
+  {
+    node->text.resize(node->text_base);
+    node->text_gen = 0;
+    node->text_pending = true;
+  }
+
+  if (node->text_pending)
+  {
+    node->text_pending = false;
+    node->text_base = node->text.length();
+    node->text_gen = idb_change_gen;
+    get_gnode_disasm(node, cache, &node->text);
+  }
+  return node->text;
+}
+
+//--------------------------------------------------------------------------
+const qstring &get_gnode_hint(
+    gnode_t *node, 
+    disasm_cache_t *cache)
+{
+  if (node->hint_gen != 0 && node->hint_gen != idb_change_gen)
+  {
+    node->hint.qclear();
+    node->hint_gen = 0;
+    node->hint_pending = true;
+  }
+
+  if (node->hint_pending)
+  {
+    node->hint_pending = false;
+    node->hint_gen = idb_change_gen;
+    get_gnode_disasm(node, cache, &node->hint);
+  }
+  return node->hint;
+}
+
 //--------------------------------------------------------------------------
 /**
 * @brief Build a function flowchart
@@ -124,3 +261,16 @@ bool is_ida_gui()
 {
   return callui(ui_get_hwnd).vptr != NULL || is_idaq();
 }
+
+//--------------------------------------------------------------------------
+int gedgemap_t::get_width(int weight)
+{
+  // One more pixel each time the weight doubles
+  int width = 1;
+  while (weight > 1 && width < 6)
+  {
+    weight >>= 1;
+    ++width;
+  }
+  return width;
+}
@@ -47,12 +47,104 @@ public:
   }
 };
 
+//--------------------------------------------------------------------------
+/**
+* @brief Maps the (source, destination) nodes of a graph edge to the count
+*        of flowchart edges it stands for
+*/
+class gedgemap_t: public std::map<std::pair<int, int>, int>
+{
+public:
+  /**
+  * @brief Count of the flowchart edges joining different nodes
+  */
+  size_t fc_edge_count;
+
+  gedgemap_t(): fc_edge_count(0)
+  {
+  }
+
+  void clear()
+  {
+    std::map<std::pair<int, int>, int>::clear();
+    fc_edge_count = 0;
+  }
+
+  /**
+  * @brief Return the weight of an edge (0 if there is no such edge)
+  */
+  int get_weight(int src, int dst)
+  {
+    iterator it = find(std::make_pair(src, dst));
+    return it == end() ? 0 : it->second;
+  }
+
+  /**
+  * @brief Count of the parallel flowchart edges that were merged
+  */
+  inline size_t get_merged_count() { return fc_edge_count - size(); }
+
+  /**
+  * @brief Return the line width showing an edge weight
+  */
+  static int get_width(int weight);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Caches the disassembly text of the blocks of a function by
+*        (start, end) address. The cache empties itself when the database
+*        changed since the text was generated (see get_idb_change_gen())
+*/
+class disasm_cache_t: public std::map<std::pair<ea_t, ea_t>, qstring>
+{
+  uint32 gen;
+
+public:
+  disasm_cache_t(): gen(0)
+  {
+  }
+
+  /**
+  * @brief Append the disassembly text of a block
+  */
+  void append(ea_t start, ea_t end, qstring *out);
+};
+
+//--------------------------------------------------------------------------
+/**
+* @brief Count the database changes: install the hooks (database and
+*        processor module events) while the cached disassembly text is in use
+*/
+void hook_idb_changes();
+void unhook_idb_changes();
+
+/**
+* @brief Return the database change generation, incremented by each change
+*/
+uint32 get_idb_change_gen();
+
 //--------------------------------------------------------------------------
 void get_disasm_text(
     ea_t start, 
     ea_t end, 
     qstring *out);
 
+//--------------------------------------------------------------------------
+/**
+* @brief Return the text and the hint of a graph node, generating the
+*        disassembly of its blocks the first time they are needed and
+*        again after each database change
+* @param cache The disassembly text cache to use, if any
+*/
+const qstring &get_gnode_text(
+    gnode_t *node, 
+    disasm_cache_t *cache = NULL);
+
+const qstring &get_gnode_hint(
+    gnode_t *node, 
+    disasm_cache_t *cache = NULL);
+
 bool get_func_flowchart(
     ea_t ea, 
     qflow_chart_t &qf);